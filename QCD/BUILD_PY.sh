@@ -0,0 +1,6 @@
+#! /bin/bash
+
+cd source
+make -f Makefile_PY all
+cd ..
+exit
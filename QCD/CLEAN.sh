@@ -3,5 +3,6 @@
 cd  source
 make -f Makefile_EXP clean
 make -f Makefile_POST clean
+make -f Makefile_PY clean
 cd ..
 exit
@@ -13,51 +13,84 @@
 // Write here the function of the link variables whose expectation value should be computed
 // Please, go through all the comments here, as you may find them helpful
 
-void Metropolis::ComputeCustom() const
-{
-  //############## IMPORTANT #################
-  // Set the multiplicity parameter, which indicates how many equivalent terms are summed over in
-  // each space-time point: if just one, set to 1.
-  double multiplicity = 1.;
-  //##########################################
+//############## IMPORTANT #################
+// Set the multiplicity parameter, which indicates how many equivalent terms are summed over in
+// each space-time point: if just one, set to 1.
+const double custom_multiplicity = 1.;
+// Set the name of the function, printed in the progress messages. The values of the function are
+// never stored in the measurement cache (see measurement_cache in SETTINGS_POST.h), since a name
+// cannot tell whether the function has been modified since the previous analysis.
+const std::string custom_name = "custom";
+//##########################################
 
-  // Just some output and preliminary initializations
-  std::cout << "Computing custom function expectation value..\nProgress %: " << std::flush;
-  std::vector<int> n = fPath.GetNCells();  // n is now the vector containing the lattice dimensions
-                                           // in the 4 directions
+Measurement Metropolis::CustomMeasurement() const
+{
+  // The measurement is the name of the function, the number of values summed on each
+  // configuration (here 1), the maximum length of the Wilson lines used in each direction (none
+  // here: with a length N > 0 in the direction mu, lines(x, mu, n) is the product of the links
+  // U(x,mu) U(x+mu,mu) .. for n = 1, .., N, computed once per configuration), whether the
+  // function uses the plaquette field (false here: if true, plaquettes(x, mu, nu) is the plaquette
+  // U(x,mu) U(x+mu,nu) U(x+nu,mu)^dagger U(x,nu)^dagger and plaquettes.RealTrace(x, mu, nu) its real
+  // trace, computed once per configuration and shared with the other analyses), the function and
+  // the directions of the links used by the function, and false, so that its values are never
+  // cached
+  return {custom_name, 1, {0, 0, 0, 0}, false,
+          [this](int i, const Path& U, const WilsonLines& lines, const PlaquetteField& plaquettes,
+                 std::vector<double>& sum) {
+            // U is the whole lattice configuration in the i-th configuration (already smeared, if
+            // required), and the sum of the function over the lattice goes into sum[0]
+            std::vector<int> n = fPath.GetNCells();  // n is now the vector containing the lattice
+                                                     // dimensions in the 4 directions
+            // Here below, sum over the lattice sites x: modify from here, as you may or may not
+            // need a sum over the lattice. The sites are shared among the threads of the analysis
+            // (see Nthreads in SETTINGS_POST.h), so only read U here, and add the function to
+            // value[0]
+            SumOverSites(
+                [&](const my4Vector& x, std::vector<double>& value) {
+                  for (int mu = 0; mu < 4; mu++) {  // this loop is over the polarizations mu of U_mu
+                    // x is the space-time point: to access to U_mu(x), just use U(x,mu)
+                    value[0] += 0.;  // Modify this function
+                  }
+                },
+                sum);
+            // Alternatively, write the function as a field expression (see LatticeField.h), which
+            // is summed over the lattice sites in a single loop shared among the threads, e.g. for
+            // the plaquettes in the planes 0-1 and 2-3:
+            //   using namespace LatticeField;
+            //   Links V(U);
+            //   sum[0] += SumField(real(trace(V[0] * shift(V[1], 0) * adj(shift(V[0], 1)) * adj(V[1]) +
+            //                                 V[2] * shift(V[3], 2) * adj(shift(V[2], 3)) * adj(V[3]))));
+          },
+          {0, 1, 2, 3}, false};
+}
 
+void Metropolis::PrintCustom(const std::vector<std::vector<double>>& sums) const
+{
+  std::vector<int> n = fPath.GetNCells();
   double estimator = 0.;  // Estimator for the expectation value of the function
   double error = 0.;      // Estimator for the error, computed here as a standard deviation
   double square_estimator =
       0.;  // Estimator for the expectation value of the square of the function
-  double old_estimator = 0.;
 
-  for (int i = 0; i < fNcf; i++) {  // Loop over the lattice configurations: there are fNcf of them
-    PrintStatus(i, fNcf);
-    old_estimator = estimator;
-    Path U = fResult[i];  // U is the whole lattice configuration in the i-th configuration
-    // Here below, sweep over the lattice: modify from here, as you may or may not need a swipe over
-    // the lattice
-    for (int i0 = 0; i0 < n[0]; i0++) {
-      for (int i1 = 0; i1 < n[1]; i1++) {
-        for (int i2 = 0; i2 < n[2]; i2++) {
-          for (int i3 = 0; i3 < n[3]; i3++) {
-            for (int mu = 0; mu < 4; mu++) {     // this loop is over the polarizations mu of U_mu
-              my4Vector x({i0, i1, i2, i3}, n);  // This defines the space-time point x
-                                                 // To access to U_mu(x), just use U(x,mu)
-              estimator += 0.;  // Modify this function
-            }
-          }
-        }
-      }
-    }
-    square_estimator += std::pow(
-        (estimator - old_estimator) / (double)(n[0] * n[1] * n[2] * n[3] * multiplicity), 2.0);
+  // Loop over the sums of the function on the fNcf configurations
+  for (const std::vector<double>& sum : sums) {
+    estimator += sum[0];
+    square_estimator +=
+        std::pow(sum[0] / (double)(n[0] * n[1] * n[2] * n[3] * custom_multiplicity), 2.0);
   }
   cout << "\nEnd of statistics computation\n";
-  estimator /= (double)(n[0] * n[1] * n[2] * n[3] * multiplicity * fNcf);
+  estimator /= (double)(n[0] * n[1] * n[2] * n[3] * custom_multiplicity * fNcf);
   square_estimator /= (double)fNcf;
   error = std::sqrt((square_estimator - std::pow(estimator, 2.0)) / fNcf);
+  // With a resampling (see resampling in SETTINGS_POST.h), the error is computed from the bins of
+  // the configurations: any function of the mean values of sum, such as a ratio of two of them or
+  // the parameters of a fit, may be returned by the lambda to get its error in the same way
+  if (fResampling != Resampling::None) {
+    const double norm = (double)(n[0] * n[1] * n[2] * n[3] * custom_multiplicity);
+    error = Resample(sums, [norm](const std::vector<double>& mean) {
+              return std::vector<double>({mean[0] / norm});
+            })[0].error;
+  }
 
   std::cout << "Results:\n<F[U_x_mu]> =   " << estimator << "  +/-  " << error << std::endl;
 }
@@ -10,9 +10,15 @@
 /// the number of SU3 matrices to be generated NofSU3,
 /// the number of correlated path configurations to skip Ncorr,
 /// the number of internal updates on each link inner,
-/// the number of path configurations to be sampled Ncf,
-/// the boolean option improved to select the action to use
-/// and the name of the output file filename.
+/// the sizes of the 4D tiles in which the lattice is swept tiles,
+/// the number of path configurations to be sampled Ncf (at most, if a stopping rule is set),
+/// the stopping rule target_error, target_loops, min_Ncf and time_budget,
+/// the boolean option improved to select the action to use,
+/// the number of parallel tempering replicas Nreplicas and their beta spacing beta_step,
+/// the memory options huge_pages, pin_threads and memory_report
+/// the name of the output file filename, its format output_mode and layout output_layout,
+/// the option resume to continue the ensemble of an existing output file, and the options
+/// use_store and store_directory to keep the ensemble in a store addressed by the settings.
 ///
 ////////////////////////////////////////////////////////////////////////
 
@@ -21,6 +27,8 @@
 
 #include <vector>
 #include <string>
+#include "source/EnsembleFile.h"
+#include "source/LatticeMemory.h"
 
 //*************** PARAMETERS **********************//
 std::vector<int> NCells = {8, 8, 8, 8};  ///< Number of cells in each space-time direction
@@ -33,10 +41,43 @@ double epsilon = 0.24;      ///< Typical magnitude of a link update
 int NofSU3 = 100;           ///< Number of SU3 matrices to be generated and used to update the links
 int Ncorr = 50;             ///< Number of correlated configurations to skip before next sampling
 int inner = 10;             ///< Number of link updates before moving to the next site
-int Ncf = 10;               ///< Number of total configurations to be sampled
+std::vector<int> tiles = {8, 8, 8, 8};  ///< Sizes of the 4D tiles visited one after the other in a
+                                        ///< sweep: for lattices above ~12^4, choose tiles which,
+                                        ///< with a 2-site halo, fit in cache (NCells = plain sweep)
+int Ncf = 10;               ///< Number of total configurations to be sampled (with a target_error,
+                            ///< maximum number of configurations)
+double target_error = 0.;   ///< Stop the generation when the relative error of every target loop is
+                            ///< below this value (0 = always sample Ncf configurations)
+std::vector<std::vector<int>> target_loops = {{1, 1}, {2, 1}};  ///< Target Wilson loops {N_mu,
+                            ///< N_nu} measured inline and averaged over the planes: {1, 1} is the
+                            ///< plaquette, {2, 1} the rectangle
+int min_Ncf = 20;           ///< Minimum number of configurations before testing the target error
+double time_budget = 0.;    ///< Time budget of the generation in minutes (0 = unlimited)
 bool improved = true;       ///< Do you wish to use the improved wilson action?
+int Nreplicas = 1;          ///< Number of parallel tempering replicas, one thread each (1 = single
+                            ///< Metropolis chain, no replica exchange)
+double beta_step = 0.1;     ///< Beta spacing of the replicas: the k-th one runs at beta-k*beta_step
+HugePages huge_pages = HugePages::None;  ///< Page size for the link variables and the ensemble:
+                                         ///< None, Transparent, Huge2MB or Huge1GB \see HugePages
+bool pin_threads = false;   ///< Pin each thread (one per replica) to its own CPU, so that the
+                            ///< memory it touches first stays on its NUMA node
+bool memory_report = false; ///< Print where the memory of the lattice actually landed
 std::string filename =
     "DataOutput_8x8x8x8_100NofSU3_10Ncf_improved.dat";  ///< Filename of the output data file
+char output_mode = 'B';  ///< Format of the output file: 'B' binary (raw doubles with an index of the
+                         ///< configurations), 'C' compressed binary (smaller, slower to write),
+                         ///< 'S' text, 'V' verbose text (not readable by QCD_POST)
+EnsembleLayout output_layout = EnsembleLayout::Sites;  ///< Order of the links in the 'B' and 'C'
+                         ///< formats: Sites, Directions or TimeSlices (one block per direction, or
+                         ///< per direction and time slice, read selectively) \see EnsembleLayout
+bool resume = false;     ///< Append the new configurations to the output file, if it exists,
+                         ///< continuing its Markov chain from the stored checkpoint or from its
+                         ///< last configuration ('B' and 'C' formats only)
+bool use_store = false;  ///< Write the ensemble in the store instead of filename: the generation is
+                         ///< skipped if the store holds Ncf configurations with the same settings,
+                         ///< and continued up to Ncf otherwise \see EnsembleStore
+std::string store_directory = "EnsembleStore";  ///< Directory of the ensemble store: use the same
+                         ///< one for all the experiments to share their ensembles
 //************** END PARAMETERS *******************//
 
 #endif
@@ -4,34 +4,90 @@
 ///        the postprocessing code.
 ///
 /// Set here the parameters of the system, namely: the name of the input file
-/// filename, the boolean option to perform a smearing smeared,
+/// filename (or, with from_store, the ensemble with the settings store_settings in the ensemble
+/// store store_directory), the boolean option to read it one configuration at a time streaming,
+/// the boolean option to reuse the per-configuration results of previous analyses
+/// measurement_cache, the boolean option to perform a smearing smeared,
 /// the number of smearings to apply Nsmearings,
-/// the value of the smearing parameter smear_par and
-/// the type of analysis my_type.
+/// the value of the smearing parameter smear_par,
+/// the page size for the ensemble huge_pages,
+/// the number of threads of the analysis Nthreads,
+/// the average of the observables over the equivalent frames of each configuration symmetrization,
+/// the method for the errors resampling, with its bin_size, Nresamples and resampling_seed,
+/// and the types of analysis my_types, with the direction strings loop_shapes of Type::LoopShapes.
 ///
 ////////////////////////////////////////////////////////////////////////
 
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <cstdint>
 #include <string>
 #include "source/Metropolis.h"
 
 //*************** PARAMETERS **********************//
 std::string filename =
     "DataOutput_8x8x8x8_100NofSU3_10Ncf_improved.dat";  ///< Name of the input file
+bool from_store = false;  ///< Read the ensemble with the settings store_settings from the ensemble
+                          ///< store, instead of filename \see EnsembleStore
+std::string store_directory = "EnsembleStore";  ///< Directory of the ensemble store
+EnsembleSettings store_settings = {{8, 8, 8, 8},
+                                   {100, 50, 10, 0},
+                                   {0.25, 5.5, 1.719, 0.797, 0.24},
+                                   true};  ///< Settings of the requested ensemble: NCells, {NofSU3,
+                                           ///< Ncorr, inner, (any Ncf)}, {a, beta, beta_tilde,
+                                           ///< u0, epsilon}, improved
+bool streaming = false;                                 ///< Read and analyse one configuration at
+                                                        ///< a time (bounded memory): set to true
+                                                        ///< for ensembles larger than the memory
+bool measurement_cache = false;                         ///< Store the results on each configuration
+                                                        ///< in filename.cache, and reuse those of
+                                                        ///< previous analyses: set to true when the
+                                                        ///< same ensemble is analysed repeatedly
+                                                        ///< \see MeasurementCache
 bool smeared = true;                                    ///< Option to perform smearings
 int Nsmearings = 4;                                     ///< Number of smearings
 double smear_par = 1. / 12.;                            ///< Smearing parameter
+HugePages huge_pages = HugePages::None;  ///< Page size for the ensemble: None, Transparent, Huge2MB
+                                         ///< or Huge1GB \see HugePages
+int Nthreads = 0;  ///< Number of threads of the smearings and of the analysis (0 = the available
+                   ///< hardware threads, 1 = serial): the results do not depend on it
+Symmetrization symmetrization =
+    Symmetrization::None;  ///< Average the observables over the choices of the time direction
+                           ///< among the directions of equal extent (TimeAxes), or over the whole
+                           ///< hypercubic group of the lattice (Hypercubic) \see Symmetrization
+Resampling resampling = Resampling::None;  ///< Errors of the results and of the ratios and
+                                           ///< potentials derived from them: None (uncorrelated
+                                           ///< propagation), or Jackknife and Bootstrap to
+                                           ///< resample the bins of configurations \see Resampling
+int bin_size = 1;                    ///< Number of consecutive configurations in each bin of the
+                                     ///< resampling: longer than their autocorrelation time
+int Nresamples = 1000;               ///< Number of resamples of the bootstrap
+std::uint64_t resampling_seed = 1;   ///< Seed of the resamples of the bootstrap
 
-/// Type of analysis
+/// Types of analysis
 ///
-/// Type of analysis to perform on the input data. The possible choices are the following:
+/// Types of analysis to perform on the input data, all of them in a single pass over the
+/// configurations, which are read and smeared once. The possible choices are the following:
 /// Type::PlaquetteRectangle -> Compute 1x1 and 1x2 Wilson loops expectation values
 /// Type::QuarkPotential -> Compute quark-quark potential, draw plot and fit using ROOT
 /// Type::Custom -> Define in CUSTOM_POST.h a function of the link variables whose expectation value
-/// is to be computed \see Type
-Type my_type = Type::QuarkPotential;
+/// is to be computed
+/// Type::LoopShapes -> Compute the expectation values of the loops in loop_shapes
+/// Type::PolyakovLoops -> Compute the Polyakov loop and its correlators at all the spatial
+/// separations, with fast Fourier transforms
+/// Type::OffAxisWilsonLoops -> Compute the RxT Wilson loops with spatial sides along the vectors
+/// equivalent to off_axis_vectors, for many more distances r than Type::QuarkPotential \see Type
+std::vector<Type> my_types = {Type::QuarkPotential};
+std::vector<std::string> loop_shapes = {
+    "+0+1-0-1", "+0+0+1-0-0-1", "+0+1-0+2-1-2",
+    "+0+1+2-0-1-2"};  ///< Loops of Type::LoopShapes, as sequences of steps +mu (forward) and -mu
+                      ///< (backward) in the direction mu: here the plaquette, the 2x1 rectangle,
+                      ///< a chair and a parallelogram \see LoopShapes
+std::vector<std::vector<int>> off_axis_vectors = {
+    {1, 0, 0}, {1, 1, 0}, {1, 1, 1}};  ///< Base vectors of the spatial sides of the loops of
+                                       ///< Type::OffAxisWilsonLoops: here on-axis, planar diagonal
+                                       ///< and space diagonal \see Metropolis::SetOffAxisVectors
 
 //************** END PARAMETERS *******************//
 
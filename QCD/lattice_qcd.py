@@ -0,0 +1,263 @@
+## @file lattice_qcd.py
+#
+#  @brief Python module to reach the Montecarlo ensembles and the analysis
+#         kernels of the C++ code.
+#
+#  Python module built on the shared library libqcd.so (source/QCD_PY.cpp), which is
+#  compiled with the script BUILD_PY.sh. The configurations of an ensemble file are
+#  NumPy arrays on the memory of the library: a binary file is mapped, and no link
+#  is copied. The Wilson loops and the smearing of the C++ code run on those arrays,
+#  or on any array in the same layout, and the measurement cache written by QCD_POST
+#  (see measurement_cache in SETTINGS_POST.h) is read as NumPy arrays on the mapped
+#  side-car. Example:\n
+#  >>> import lattice_qcd\n
+#  >>> ensemble = lattice_qcd.Ensemble("DataOutput_8x8x8x8_100NofSU3_10Ncf_improved.dat")\n
+#  >>> U = ensemble[0]\n
+#  >>> U[0, 0, 0, 0, 3]  # 3x3 link matrix U_3(0)\n
+#  >>> ensemble.loop_sum(U, 1, 1, 0, 3) / ensemble.volume\n
+#  >>> lattice_qcd.MeasurementCache(ensemble).values("plaquette_rectangle")
+import ctypes
+import mmap
+import os
+import struct
+import zlib
+import numpy as np
+
+## Name of the shared library, next to this module
+library_name = os.path.join(os.path.dirname(os.path.abspath(__file__)), "libqcd.so")
+
+_library = None
+
+## Load the shared library and declare the signatures of its functions
+#
+#   @return ctypes handle of libqcd.so
+def load_library():
+    global _library
+    if _library is None:
+        lib = ctypes.CDLL(library_name)
+        handle = ctypes.c_void_p
+        links = ctypes.c_void_p
+        lib.qcd_open.argtypes = [ctypes.c_char_p]
+        lib.qcd_open.restype = handle
+        lib.qcd_close.argtypes = [handle]
+        lib.qcd_close.restype = None
+        lib.qcd_settings.argtypes = [handle, ctypes.POINTER(ctypes.c_int),
+                                     ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_double)]
+        lib.qcd_settings.restype = ctypes.c_int
+        lib.qcd_configuration.argtypes = [handle, ctypes.c_int]
+        lib.qcd_configuration.restype = ctypes.c_void_p
+        lib.qcd_digests.argtypes = [handle, ctypes.c_char_p]
+        lib.qcd_digests.restype = ctypes.c_void_p
+        lib.qcd_wilson_loop.argtypes = [handle, links, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+                                        ctypes.c_int, ctypes.POINTER(ctypes.c_int)]
+        lib.qcd_wilson_loop.restype = ctypes.c_double
+        lib.qcd_loop_sum.argtypes = [handle, links, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+                                     ctypes.c_int]
+        lib.qcd_loop_sum.restype = ctypes.c_double
+        lib.qcd_smear.argtypes = [handle, links, ctypes.c_int, ctypes.c_double]
+        lib.qcd_smear.restype = ctypes.c_int
+        _library = lib
+    return _library
+
+## Ensemble class
+#
+#  Ensemble file opened with the library. The i-th configuration ensemble[i] is an array of
+#  shape (n0, n1, n2, n3, 4, 3, 3), where U[x0, x1, x2, x3, mu] is the link matrix U_mu(x): it is
+#  a view on the memory of the library (on the mapped file, for a raw binary file), valid as long
+#  as the array or the ensemble is referenced. The memory of a mapped file is private:
+#  modifications are not written back.
+class Ensemble:
+    ## Constructor
+    #
+    #   @param filename name of the ensemble file, in the binary or in the text format
+    def __init__(self, filename):
+        self._lib = load_library()
+        self.filename = filename
+        self._handle = self._lib.qcd_open(filename.encode())
+        if not self._handle:
+            raise IOError("cannot open the ensemble file " + filename)
+        ncells = (ctypes.c_int * 4)()
+        integer_params = (ctypes.c_int * 4)()
+        floating_params = (ctypes.c_double * 5)()
+        improved = self._lib.qcd_settings(self._handle, ncells, integer_params, floating_params)
+        ## Lattice dimensions
+        self.ncells = tuple(ncells)
+        ## Settings of the experiment, as in SETTINGS_EXP.h
+        self.settings = dict(zip(["NofSU3", "Ncorr", "inner", "Ncf"], integer_params))
+        self.settings.update(zip(["a", "beta", "beta_tilde", "u0", "epsilon"], floating_params))
+        self.settings["improved"] = bool(improved)
+        ## Number of lattice sites
+        self.volume = int(np.prod(self.ncells))
+        ## Shape of a configuration
+        self.shape = self.ncells + (4, 3, 3)
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            self._lib.qcd_close(self._handle)
+            self._handle = None
+
+    def __len__(self):
+        return self.settings["Ncf"]
+
+    ## i-th configuration, without copy
+    def __getitem__(self, i):
+        if i < 0:
+            i += len(self)
+        address = self._lib.qcd_configuration(self._handle, i) if 0 <= i < len(self) else None
+        if not address:
+            raise IndexError("configuration index out of range")
+        buffer = (ctypes.c_double * (2 * 9 * 4 * self.volume)).from_address(address)
+        buffer._ensemble = self  # the ensemble stays open as long as the array is referenced
+        return self._view(np.frombuffer(buffer, dtype=np.complex128).reshape(self.shape))
+
+    def __iter__(self):
+        for i in range(len(self)):
+            yield self[i]
+
+    ## New configuration owned by NumPy, in the layout of the kernels
+    #
+    #   @param U configuration to be copied (default: all the links equal to the identity)
+    #   @return array of shape self.shape
+    def new_configuration(self, U=None):
+        links = np.zeros(self.shape, dtype=np.complex128)
+        result = self._view(links)
+        if U is None:
+            result[...] = np.eye(3)
+        else:
+            result[...] = U
+        return result
+
+    ## Wilson loop on a configuration
+    #
+    #   @param U configuration, from this ensemble or from new_configuration
+    #   @param N_mu length of the loop in the mu direction
+    #   @param N_nu length of the loop in the nu direction
+    #   @param mu direction of one of the sides of the loop
+    #   @param nu direction of the other side of the loop
+    #   @param x position (x0, x1, x2, x3) of one of the corners of the loop
+    #   @return value of the loop
+    def wilson_loop(self, U, N_mu, N_nu, mu, nu, x):
+        self._check_loop(N_mu, N_nu, mu, nu)
+        if len(x) != 4:
+            raise ValueError("the position must have 4 coordinates")
+        position = (ctypes.c_int * 4)(*x)
+        value = self._lib.qcd_wilson_loop(self._handle, self._address(U), N_mu, N_nu, mu, nu,
+                                          position)
+        if np.isnan(value):
+            raise RuntimeError("Wilson loop failed")
+        return value
+
+    ## Sum of the Wilson loops of a configuration over all the lattice sites
+    #
+    #   @param U configuration, from this ensemble or from new_configuration
+    #   @param N_mu length of the loops in the mu direction
+    #   @param N_nu length of the loops in the nu direction
+    #   @param mu direction of one of the sides of the loops
+    #   @param nu direction of the other side of the loops
+    #   @return sum of the loops
+    def loop_sum(self, U, N_mu, N_nu, mu, nu):
+        self._check_loop(N_mu, N_nu, mu, nu)
+        value = self._lib.qcd_loop_sum(self._handle, self._address(U), N_mu, N_nu, mu, nu)
+        if np.isnan(value):
+            raise RuntimeError("sum of the Wilson loops failed")
+        return value
+
+    ## Spatial smearing of a configuration, in place
+    #
+    #   @param U configuration, from this ensemble or from new_configuration
+    #   @param Ntimes number of consecutive smearings
+    #   @param smearing_par value of the smearing parameter
+    def smear(self, U, Ntimes, smearing_par):
+        if not U.flags.writeable:
+            raise ValueError("the configuration is read-only")
+        if self._lib.qcd_smear(self._handle, self._address(U), Ntimes, smearing_par) != 0:
+            raise RuntimeError("smearing failed")
+
+    # The kernels assume non-negative lengths and two different directions among 0, 1, 2 and 3
+    def _check_loop(self, N_mu, N_nu, mu, nu):
+        if N_mu < 0 or N_nu < 0:
+            raise ValueError("the lengths of the loop must be non-negative")
+        if mu not in range(4) or nu not in range(4) or mu == nu:
+            raise ValueError("the directions of the loop must be two different ones among "
+                             "0, 1, 2 and 3")
+
+    # The links are stored column by column (the memory order of Path): the matrix view swaps
+    # the last two axes of the memory
+    def _view(self, links):
+        return links.swapaxes(-1, -2)
+
+    # Address of the memory of a configuration, which must be in the layout of the kernels
+    def _address(self, U):
+        links = U.swapaxes(-1, -2)
+        if links.shape != self.shape or links.dtype != np.complex128 or \
+           not links.flags.c_contiguous:
+            raise ValueError("the configuration is not in the layout of the ensemble: "
+                             "use Ensemble.new_configuration")
+        return links.ctypes.data
+
+## MeasurementCache class
+#
+#  Reader of the measurement cache of an ensemble, i.e. the side-car filename.cache written by
+#  QCD_POST. The values of each entry are NumPy arrays on the mapped side-car.
+class MeasurementCache:
+    ## Constructor
+    #
+    #   @param ensemble Ensemble whose cache is read
+    def __init__(self, ensemble):
+        lib = ensemble._lib
+        address = lib.qcd_digests(ensemble._handle, ensemble.filename.encode())
+        if not address:
+            raise IOError("cannot compute the digests of " + ensemble.filename)
+        digests = (ctypes.c_uint64 * len(ensemble)).from_address(address)
+        ## Digest of each configuration
+        self.digests = list(digests)
+        ## Values of each entry, by (configuration digest, tag)
+        self.entries = {}
+        with open(ensemble.filename + ".cache", "rb") as file:
+            self._map = mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ)
+        if self._map[:16] != b"LQCDMEAS" + struct.pack("=II", 1, 0x01020304):
+            raise IOError("unknown format of the measurement cache")
+        offset = 16
+        while offset + 24 <= len(self._map):
+            digest, tag, nvalues, checksum = struct.unpack_from("=QQII", self._map, offset)
+            end = offset + 24 + 8 * nvalues
+            if end > len(self._map):
+                break
+            crc = zlib.crc32(self._map[offset + 24:end], zlib.crc32(self._map[offset:offset + 20]))
+            if crc != checksum:
+                break
+            self.entries[(digest, tag)] = np.frombuffer(self._map, dtype=np.float64,
+                                                        count=nvalues, offset=offset + 24)
+            offset = end
+
+    ## Tag of a measurement, as computed by MeasurementCache::Tag
+    #
+    #   @param observable name of the observable, e.g. "plaquette_rectangle" or
+    #   "rxt_wilson_loops_4x4"
+    #   @param smearings list of the smearings (Ntimes, smearing_par) applied, in order
+    #   @return tag of the entries of the measurement
+    @staticmethod
+    def tag(observable, smearings=()):
+        data = observable.encode()
+        for ntimes, smearing_par in smearings:
+            data += struct.pack("=i", ntimes) + struct.pack("=d", smearing_par)
+        tag = 0xcbf29ce484222325
+        for byte in data:
+            tag = ((tag ^ byte) * 0x100000001b3) & 0xffffffffffffffff
+        return tag
+
+    ## Values of a measurement on every configuration
+    #
+    #   @param observable name of the observable
+    #   @param smearings list of the smearings (Ntimes, smearing_par) applied, in order
+    #   @return array with one row per configuration (NaN for the configurations not in the cache)
+    #   and one column per value: the sums over the lattice, as in the C++ analyses
+    def values(self, observable, smearings=()):
+        tag = self.tag(observable, smearings)
+        rows = [self.entries.get((digest, tag)) for digest in self.digests]
+        nvalues = max([len(row) for row in rows if row is not None], default=0)
+        result = np.full((len(rows), nvalues), np.nan)
+        for i, row in enumerate(rows):
+            if row is not None:
+                result[i] = row
+        return result
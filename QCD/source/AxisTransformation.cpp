@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <armadillo>
+#include <iostream>
+#include <vector>
+#include "AxisTransformation.h"
+#include "my4Vector.h"
+#include "Path.h"
+using namespace arma;
+
+/************************ Constructor ***************************/
+
+// Constructor: a transformation which would change the lattice dimensions is an error
+AxisTransformation::AxisTransformation(std::vector<int> ncells,
+                                       std::vector<int> axes,
+                                       std::vector<int> signs)
+    : fNCells(ncells), fAxes(axes), fSigns(signs)
+{
+  if (ncells.size() != 4 || axes.size() != 4 || signs.size() != 4) throw 1;
+  std::vector<int> sorted = axes;
+  std::sort(sorted.begin(), sorted.end());
+  if (sorted != std::vector<int>({0, 1, 2, 3})) throw 1;
+  for (int mu = 0; mu < 4; mu++) {
+    if (signs[mu] != 1 && signs[mu] != -1) throw 1;
+    if (ncells[axes[mu]] != ncells[mu]) {
+      std::cout << "ERROR: the axis transformation does not preserve the lattice dimensions.\n";
+      throw 1;
+    }
+  }
+}
+
+/************************ Public Methods ***************************/
+
+std::vector<AxisTransformation> AxisTransformation::TimeAxes(const std::vector<int>& ncells)
+{
+  std::vector<AxisTransformation> transformations = {AxisTransformation(ncells)};
+  for (int tau = 0; tau < 3; tau++) {
+    if (ncells[tau] != ncells[3]) continue;
+    std::vector<int> axes = {0, 1, 2, 3};
+    std::swap(axes[tau], axes[3]);
+    transformations.push_back(AxisTransformation(ncells, axes));
+  }
+  return transformations;
+}
+
+// Permutations of the spatial directions in lexicographic order, each with the 16 reflections
+std::vector<AxisTransformation> AxisTransformation::SpatialGroup(const std::vector<int>& ncells)
+{
+  std::vector<AxisTransformation> transformations;
+  std::vector<int> axes = {0, 1, 2, 3};
+  do {
+    if (ncells[axes[0]] != ncells[0] || ncells[axes[1]] != ncells[1] ||
+        ncells[axes[2]] != ncells[2])
+      continue;
+    for (int reflections = 0; reflections < 16; reflections++) {
+      std::vector<int> signs(4, 1);
+      for (int mu = 0; mu < 4; mu++)
+        if (reflections & (1 << mu)) signs[mu] = -1;
+      transformations.push_back(AxisTransformation(ncells, axes, signs));
+    }
+  } while (std::next_permutation(axes.begin(), axes.begin() + 3));
+  return transformations;
+}
+
+// The link U(x, mu) joins x to x + mu: its image joins the image y of x to y + e, with e the unit
+// vector of the direction GetAxes()[mu] in the orientation GetSigns()[mu], so that a reversed link
+// is stored, as the hermitian conjugate, at y - e
+void AxisTransformation::Apply(const Path& U, Path& V, int i0, int i1) const
+{
+  if (U.GetNCells() != fNCells || V.GetNCells() != fNCells) {
+    std::cout << "ERROR: the axis transformation and the configuration have different "
+                 "dimensions.\n";
+    throw 1;
+  }
+  for (int i2 = 0; i2 < fNCells[2]; i2++) {
+    for (int i3 = 0; i3 < fNCells[3]; i3++) {
+      my4Vector x({i0, i1, i2, i3}, fNCells);
+      const my4Vector y = (*this)(x);
+      for (int mu = 0; mu < 4; mu++) {
+        if (fSigns[mu] > 0)
+          V.Set(y, fAxes[mu]) = U(x, mu);
+        else
+          V.Set(y.Offset(-1, fAxes[mu]), fAxes[mu]) = U(x, mu).t();
+      }
+    }
+  }
+}
+
+my4Vector AxisTransformation::operator()(const my4Vector& x) const
+{
+  std::vector<int> y(4);
+  for (int mu = 0; mu < 4; mu++)
+    y[fAxes[mu]] = fSigns[mu] > 0 ? x[mu] : (fNCells[mu] - x[mu]) % fNCells[mu];
+  return my4Vector(y, fNCells);
+}
+
+bool AxisTransformation::IsIdentity() const
+{
+  return fAxes == std::vector<int>({0, 1, 2, 3}) && fSigns == std::vector<int>({1, 1, 1, 1});
+}
+
+std::vector<int> AxisTransformation::GetAxes() const
+{
+  return fAxes;
+}
+
+std::vector<int> AxisTransformation::GetSigns() const
+{
+  return fSigns;
+}
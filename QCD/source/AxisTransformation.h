@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////
+/// \file AxisTransformation.h
+/// \brief Header file for the definition of the class AxisTransformation
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class AxisTransformation. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef AXISTRANSFORMATION_H
+#define AXISTRANSFORMATION_H
+
+#include <vector>
+#include "my4Vector.h"
+#include "Path.h"
+
+/// Symmetrization enum class
+///
+/// Enum class which collects the available averages of the observables over the equivalent
+/// frames of each configuration, i.e. its images under the elements of the hypercubic group
+/// (permutations of the axes and reflections) which preserve the lattice dimensions.
+/// \see Metropolis::SetSymmetrization
+enum class Symmetrization {
+  None,       ///< Direction 3 is the time direction
+  TimeAxes,   ///< Each direction with the extent of direction 3 is the time direction in turn
+  Hypercubic  ///< All the elements of the hypercubic group which preserve the lattice dimensions
+};
+
+/// AxisTransformation class
+///
+/// This class represents an element of the hypercubic group, as a permutation of the 4 axes of the
+/// lattice followed by the reflection of some of them, which preserves the lattice dimensions:
+/// the direction mu of a configuration becomes the direction GetAxes()[mu] of its image, reversed
+/// if GetSigns()[mu] is -1. The image of a configuration is again a configuration of the same
+/// lattice, on which all the analyses can be run unchanged: for example, the transposition of the
+/// axes 0 and 3 turns the direction 0 into the time direction of the RxT Wilson loops.
+class AxisTransformation
+{
+ private:
+  std::vector<int> fNCells;  ///< Lattice dimensions in the 4 dimensions
+  std::vector<int> fAxes;    ///< Direction of the image of each direction
+  std::vector<int> fSigns;   ///< Orientation of the image of each direction, +1 or -1
+
+ public:
+  AxisTransformation() = delete;
+
+  /// Constructor
+  ///
+  /// \param ncells vector containing the lattice dimensions in the 4 dimensions
+  /// \param axes direction of the image of each direction, a permutation of 0, 1, 2, 3 such that
+  /// ncells[axes[mu]] = ncells[mu] (default: the identity)
+  /// \param signs orientation of the image of each direction, +1 or -1 (default: all +1)
+  AxisTransformation(std::vector<int> ncells,
+                     std::vector<int> axes = {0, 1, 2, 3},
+                     std::vector<int> signs = {1, 1, 1, 1});
+
+  /// Time axes
+  ///
+  /// \param ncells vector containing the lattice dimensions in the 4 dimensions
+  /// \return the transpositions of the direction 3 with each direction of the same extent, i.e.
+  /// one transformation for each choice of the time direction, the identity first
+  static std::vector<AxisTransformation> TimeAxes(const std::vector<int>& ncells);
+
+  /// Spatial group
+  ///
+  /// \param ncells vector containing the lattice dimensions in the 4 dimensions
+  /// \return the transformations which map the direction 3 onto itself: the permutations of the
+  /// spatial directions of equal extent and the reflections of all the directions, up to 96, the
+  /// identity first. Composed with the time axes, they give the whole hypercubic group of the
+  /// lattice.
+  static std::vector<AxisTransformation> SpatialGroup(const std::vector<int>& ncells);
+
+  /// Apply the transformation on a slab
+  ///
+  /// Copy the links of U at the sites with given x_0 and x_1 to their images in V, so that V is
+  /// the image of U once every slab is done. The slabs may be applied concurrently, since each
+  /// link of U has its own image.
+  /// \param U path configuration, with the lattice dimensions of the instance
+  /// \param V image configuration, with the lattice dimensions of the instance
+  /// \param i0 coordinate x_0 of the slab of U
+  /// \param i1 coordinate x_1 of the slab of U
+  void Apply(const Path& U, Path& V, int i0, int i1) const;
+
+  /// () overloading
+  ///
+  /// \param x position 4-vector
+  /// \return position 4-vector of the image of the site x
+  my4Vector operator()(const my4Vector& x) const;
+
+  /// \return true if the transformation is the identity
+  bool IsIdentity() const;
+
+  /// \return fAxes
+  std::vector<int> GetAxes() const;
+
+  /// \return fSigns
+  std::vector<int> GetSigns() const;
+};
+
+#endif
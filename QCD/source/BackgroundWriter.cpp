@@ -0,0 +1,126 @@
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Ensemble.h"
+#include "EnsembleFile.h"
+#include "Path.h"
+#include "BackgroundWriter.h"
+
+/************************ Private Methods ***************************/
+
+// Write the queued slots in order until the writer is closed; the slot being written stays
+// reserved, so the caller never overwrites it
+void BackgroundWriter::Loop()
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  while (true) {
+    fReady.wait(lock, [this]() { return fPending > 0 || fClosing; });
+    if (fPending == 0) break;  // closing and nothing left
+    const Path& slot = fQueue[fHead];
+    lock.unlock();
+    bool failed = false;
+    try {
+      if (fBinary) {
+        fBinary->Append(slot);
+        fBinary->Sync();
+      } else {
+        fText->Append(slot);
+      }
+    } catch (...) {
+      failed = true;
+    }
+    lock.lock();
+    if (failed) {
+      fFailed = true;
+      fFree.notify_all();
+      break;
+    }
+    fHead = (fHead + 1) % fQueue.GetNSlots();
+    fPending--;
+    fFree.notify_all();
+  }
+}
+
+/************************ Public Methods ***************************/
+
+// Constructor
+BackgroundWriter::BackgroundWriter(const std::string& filename,
+                                   char mode,
+                                   const EnsembleSettings& settings,
+                                   EnsembleLayout layout,
+                                   bool append,
+                                   int depth)
+    : fMode(mode)
+    , fQueue(settings.ncells, depth)
+    , fHead(0)
+    , fPending(0)
+    , fClosing(false)
+    , fFailed(false)
+{
+  if (depth < 1) throw 1;
+  if (fMode == 'B' || fMode == 'C') {
+    fBinary = std::make_unique<EnsembleWriter>(filename, settings, fMode == 'C', layout, append);
+  } else if (fMode == 'S' && !append && layout == EnsembleLayout::Sites) {
+    fText = std::make_unique<TextEnsembleWriter>(filename, settings);
+  } else {
+    std::cout << "ERROR: the configurations can be streamed only in the 'B', 'C' and 'S' formats, "
+                 "and appended or reordered only in the 'B' and 'C' formats.\n";
+    throw 1;
+  }
+  fThread = std::thread(&BackgroundWriter::Loop, this);
+}
+
+// Destructor
+BackgroundWriter::~BackgroundWriter()
+{
+  try {
+    Close();
+  } catch (...) {
+  }
+}
+
+// Copy the configuration into the slot after the queued ones
+void BackgroundWriter::Push(const Path& path)
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  fFree.wait(lock, [this]() { return fPending < fQueue.GetNSlots() || fFailed; });
+  if (fFailed || fClosing) {
+    std::cout << "ERROR: the ensemble file cannot be written.\n";
+    throw 1;
+  }
+  const int tail = (fHead + fPending) % fQueue.GetNSlots();
+  lock.unlock();
+  fQueue.Snapshot(tail, path);  // the slot is free: no other thread touches it
+  lock.lock();
+  fPending++;
+  fReady.notify_one();
+}
+
+// Copy the state of the chain: it is written by Close, from the calling thread
+void BackgroundWriter::Checkpoint(const Path& path)
+{
+  fCheckpoint = std::make_unique<Path>(path);
+}
+
+// Drain the ring, then close the file from the calling thread
+void BackgroundWriter::Close()
+{
+  if (!fThread.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fClosing = true;
+  }
+  fReady.notify_one();
+  fThread.join();
+  if (fFailed) {
+    std::cout << "ERROR while writing the ensemble file.\n";
+    throw 1;
+  }
+  if (fBinary) {
+    if (fCheckpoint) fBinary->SetCheckpoint(*fCheckpoint);
+    fBinary->Close();
+  }
+  if (fText) fText->Close();
+}
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////
+/// \file BackgroundWriter.h
+/// \brief Header file for the definition of the class BackgroundWriter
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class BackgroundWriter. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef BACKGROUNDWRITER_H
+#define BACKGROUNDWRITER_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Ensemble.h"
+#include "EnsembleFile.h"
+#include "Path.h"
+
+/// BackgroundWriter class
+///
+/// Writer of an ensemble file running in its own thread. Each configuration handed to
+/// BackgroundWriter::Push is copied into a small ring of preallocated slots and returned to the
+/// caller immediately: formatting and writing (and flushing to the storage device) happen in the
+/// background, overlapping with the generation of the next configuration. The caller waits only
+/// when all the slots are still waiting to be written, so the memory in use is bounded by the
+/// number of slots, whatever the number of configurations.
+class BackgroundWriter
+{
+ private:
+  char fMode;                                 ///< Output format: 'B', 'C' or 'S'
+  std::unique_ptr<EnsembleWriter> fBinary;    ///< Writer of the binary format
+  std::unique_ptr<TextEnsembleWriter> fText;  ///< Writer of the text format
+  Ensemble fQueue;                            ///< Ring of slots waiting to be written
+  std::unique_ptr<Path> fCheckpoint;          ///< State of the chain to be stored at closing time
+  int fHead;                                  ///< Next slot to be written
+  int fPending;                               ///< Number of slots waiting to be written
+  bool fClosing;                              ///< True when no more configurations will come
+  bool fFailed;                               ///< True if the writing thread met an error
+  std::mutex fMutex;                          ///< Protects the state of the ring
+  std::condition_variable fReady;             ///< Signals new slots to the writing thread
+  std::condition_variable fFree;              ///< Signals free slots to the caller
+  std::thread fThread;                        ///< Writing thread
+
+  /// Body of the writing thread
+  void Loop();
+
+ public:
+  BackgroundWriter() = delete;
+  BackgroundWriter(const BackgroundWriter&) = delete;
+  BackgroundWriter& operator=(const BackgroundWriter&) = delete;
+
+  /// Constructor
+  ///
+  /// Create the output file and start the writing thread.
+  /// \param filename name of the output file
+  /// \param mode output format: 'B' binary and 'C' compressed binary (see EnsembleWriter), 'S' text
+  /// (see TextEnsembleWriter)
+  /// \param settings settings of the experiment: integer_params[3] is the maximum number of
+  /// configurations
+  /// \param layout order of the links in the 'B' and 'C' formats \see EnsembleLayout
+  /// \param append if true, the configurations are appended to an existing file, in the 'B' or
+  /// 'C' format \see EnsembleWriter
+  /// \param depth number of slots in the ring
+  BackgroundWriter(const std::string& filename,
+                   char mode,
+                   const EnsembleSettings& settings,
+                   EnsembleLayout layout = EnsembleLayout::Sites,
+                   bool append = false,
+                   int depth = 2);
+
+  /// Destructor: the file is closed, if it was not already
+  ~BackgroundWriter();
+
+  /// Push
+  ///
+  /// Copy a configuration into a free slot and queue it for writing.
+  /// \param path configuration to be written
+  void Push(const Path& path);
+
+  /// Checkpoint
+  ///
+  /// Keep a copy of the state of the chain, stored in the file when it is closed (binary formats
+  /// only). \see EnsembleWriter::SetCheckpoint
+  /// \param path state of the chain after the last pushed configuration
+  void Checkpoint(const Path& path);
+
+  /// Close
+  ///
+  /// Wait until all the queued configurations are written, stop the writing thread and close the
+  /// file.
+  void Close();
+};
+
+#endif
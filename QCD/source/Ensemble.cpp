@@ -0,0 +1,105 @@
+#include <cstddef>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "LatticeMemory.h"
+#include "Path.h"
+#include "Ensemble.h"
+
+// Build the slots as views on the blocks of the buffer
+void Ensemble::BuildSlots()
+{
+  fSlots.clear();
+  fSlots.reserve(fOffsets.size());
+  for (std::size_t offset : fOffsets)
+    fSlots.push_back(Path(fNCells, fBuffer.GetData() + offset));
+}
+
+// Default constructor
+Ensemble::Ensemble() : fNCells({1, 1, 1, 1})
+{
+}
+
+// Constructor: a single allocation for all the slots
+Ensemble::Ensemble(std::vector<int> ncells, int nslots) : fNCells(ncells)
+{
+  if (ncells.size() != 4 || nslots < 0) throw 1;
+  const std::size_t block = (std::size_t)ncells[0] * ncells[1] * ncells[2] * ncells[3] * 4 * 9;
+  fBuffer = LinkBuffer(nslots * block);
+  for (int i = 0; i < nslots; i++) fOffsets.push_back(i * block);
+  BuildSlots();
+  for (auto& slot : fSlots) slot.FillIdentity();
+}
+
+// Constructor on an existing buffer: the slots must lie inside it
+Ensemble::Ensemble(std::vector<int> ncells, LinkBuffer&& buffer, std::vector<std::size_t> offsets)
+    : fNCells(ncells), fBuffer(std::move(buffer)), fOffsets(offsets)
+{
+  if (ncells.size() != 4) throw 1;
+  const std::size_t block = (std::size_t)ncells[0] * ncells[1] * ncells[2] * ncells[3] * 4 * 9;
+  for (std::size_t offset : fOffsets) {
+    if (offset + block > fBuffer.GetSize()) {
+      std::cout << "ERROR: ensemble slot outside of its buffer.\n";
+      throw 1;
+    }
+  }
+  BuildSlots();
+}
+
+// Copy constructor: deep copy of the buffer, the views are rebuilt on the new one
+Ensemble::Ensemble(const Ensemble& other)
+    : fNCells(other.fNCells), fBuffer(other.fBuffer), fOffsets(other.fOffsets)
+{
+  BuildSlots();
+}
+
+// Copy assignment: equal shapes reuse the buffer, so the slots stay valid
+Ensemble& Ensemble::operator=(const Ensemble& other)
+{
+  if (this == &other) return *this;
+  bool same_shape = (fNCells == other.fNCells) && (fBuffer.GetSize() == other.fBuffer.GetSize()) &&
+                    (fOffsets == other.fOffsets);
+  fNCells = other.fNCells;
+  fBuffer = other.fBuffer;
+  fOffsets = other.fOffsets;
+  if (!same_shape) BuildSlots();
+  return *this;
+}
+
+// Destructor
+Ensemble::~Ensemble()
+{
+}
+
+// Getters
+int Ensemble::GetNSlots() const
+{
+  return fSlots.size();
+}
+std::vector<int> Ensemble::GetNCells() const
+{
+  return fNCells;
+}
+const LinkBuffer& Ensemble::GetBuffer() const
+{
+  return fBuffer;
+}
+
+// Access to the slots
+Path& Ensemble::operator[](int i)
+{
+  if (i < 0 || i >= (int)fSlots.size()) throw 1;
+  return fSlots[i];
+}
+const Path& Ensemble::operator[](int i) const
+{
+  if (i < 0 || i >= (int)fSlots.size()) throw 1;
+  return fSlots[i];
+}
+
+// Store a configuration in a slot: a plain copy of the link variables into the preallocated block
+void Ensemble::Snapshot(int i, const Path& path)
+{
+  if (path.GetNCells() != fNCells) throw 1;
+  (*this)[i] = path;
+}
@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////
+/// \file Ensemble.h
+/// \brief Header file for the definition of the class Ensemble
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class Ensemble. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <cstddef>
+#include <vector>
+#include "LatticeMemory.h"
+#include "Path.h"
+
+/// Ensemble class
+///
+/// This class represents a pool of lattice configurations with a fixed number of slots, all
+/// preallocated in a single LinkBuffer when the instance is built. Each slot is a Path view on
+/// its block of the buffer, so that storing a configuration in a slot (Ensemble::Snapshot) is a
+/// plain copy of the link variables, without any allocation. An ensemble may also be built on a
+/// buffer which maps an ensemble file, with the slots placed at the offsets given by the file
+/// index. \see EnsembleReader
+class Ensemble
+{
+ private:
+  std::vector<int> fNCells;  ///< Vector containing the lattice dimensions in the 4 dimensions
+  LinkBuffer fBuffer;        ///< Single buffer holding the link variables of all the slots
+  std::vector<std::size_t> fOffsets;  ///< Offset in fBuffer of the first element of each slot
+  std::vector<Path> fSlots;           ///< Path views on the blocks of fBuffer
+
+  /// Build the Path views on fBuffer
+  void BuildSlots();
+
+ public:
+  /// Default constructor: ensemble without slots
+  Ensemble();
+
+  /// Constructor
+  ///
+  /// Allocate nslots configurations of dimensions specified in ncells, initialized with 3x3
+  /// identity matrices.
+  /// \param ncells vector containing the lattice dimensions in the 4 dimensions
+  /// \param nslots number of configurations in the pool
+  Ensemble(std::vector<int> ncells, int nslots);
+
+  /// Constructor on an existing buffer
+  ///
+  /// Build the slots as views on the blocks of buffer starting at the given offsets, without
+  /// copying nor initializing the link variables.
+  /// \param ncells vector containing the lattice dimensions in the 4 dimensions
+  /// \param buffer buffer holding the link variables, e.g. the mapping of an ensemble file
+  /// \param offsets offset in buffer (in complex elements) of the first element of each slot
+  Ensemble(std::vector<int> ncells, LinkBuffer&& buffer, std::vector<std::size_t> offsets);
+
+  /// Copy and move constructors
+  Ensemble(const Ensemble& other);
+  Ensemble(Ensemble&& other) = default;
+
+  /// Copy and move assignments
+  Ensemble& operator=(const Ensemble& other);
+  Ensemble& operator=(Ensemble&& other) = default;
+
+  /// Destructor
+  ~Ensemble();
+
+  /// \return number of slots
+  int GetNSlots() const;
+
+  /// \return fNCells
+  std::vector<int> GetNCells() const;
+
+  /// [] overloading
+  ///
+  /// \param i index of the slot
+  /// \return the configuration stored in the i-th slot
+  Path& operator[](int i);
+
+  /// [] overloading
+  ///
+  /// \param i index of the slot
+  /// \return the configuration stored in the i-th slot
+  const Path& operator[](int i) const;
+
+  /// Snapshot
+  ///
+  /// Copy a configuration into a slot.
+  /// \param i index of the slot
+  /// \param path configuration to be stored: its dimensions must match fNCells
+  void Snapshot(int i, const Path& path);
+
+  /// \return the buffer storing the link variables of all the slots
+  const LinkBuffer& GetBuffer() const;
+};
+
+#endif
@@ -0,0 +1,1045 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "Ensemble.h"
+#include "LatticeMemory.h"
+#include "Path.h"
+#include "ThreadPool.h"
+#include "EnsembleFile.h"
+
+namespace
+{
+const char kMagic[8] = {'L', 'Q', 'C', 'D', 'E', 'N', 'S', '\0'};
+const std::uint32_t kVersion = 1;
+const std::uint32_t kEndian = 0x01020304;  // read back as 0x04030201 on the opposite byte order
+const std::uint32_t kCodecRaw = 0;         // configuration blocks of raw doubles
+const std::uint32_t kCodecZlib = 1;        // byte planes of the doubles, compressed with zlib
+const int kPlanes = sizeof(double);        // number of byte planes in a compressed block
+const std::uint64_t kDigestSeed = 1;       // digest of no bytes: initial CRC-32 0, Adler-32 1
+const std::uint64_t kCompaction = 8;       // a file is compacted when 1/kCompaction is unused
+
+// Header of the binary format: 256 bytes, all the fields have a fixed size
+struct FileHeader {
+  char magic[8];                    // kMagic
+  std::uint32_t version;            // kVersion
+  std::uint32_t endian;             // kEndian
+  std::uint32_t codec;              // kCodecRaw or kCodecZlib
+  std::uint32_t layout;             // EnsembleLayout: Sites, Directions or TimeSlices
+  std::int32_t ncells[4];           // lattice dimensions
+  std::int32_t int_params[4];       // NofSU3, Ncorr, inner, Ncf
+  double float_params[5];           // a, beta, beta_tilde, u0, epsilon
+  std::int32_t improved;            // improved action?
+  std::int32_t reserved;            // unused, zero
+  std::uint64_t nconfigs;           // number of configurations in the index
+  std::uint64_t index_offset;       // position of the index, 0 while the file is being written
+  std::uint64_t config_bytes;       // size of a configuration as raw doubles
+  std::uint64_t checkpoint_offset;  // position of the chain state block, 0 if there is none
+  std::uint64_t checkpoint_bytes;   // size of the chain state block
+  char padding[112];                // room for future fields, zero
+};
+static_assert(sizeof(FileHeader) == 256, "unexpected padding in the ensemble file header");
+
+// Entry of the index: one per configuration
+struct IndexEntry {
+  std::uint64_t offset;  // position of the block
+  std::uint64_t bytes;   // size of the block
+};
+
+// Header of a compressed configuration block, followed by the compressed byte planes
+struct BlockHeader {
+  std::uint64_t plane_bytes[kPlanes];  // compressed size of each byte plane
+  std::uint32_t checksum;              // CRC-32 of the plane sizes and of the compressed planes
+  std::uint32_t reserved;              // unused, zero
+};
+static_assert(sizeof(BlockHeader) == 72, "unexpected padding in the compressed block header");
+
+// Size in bytes of a configuration as raw doubles
+std::uint64_t ConfigBytes(const std::vector<int>& n)
+{
+  return (std::uint64_t)n[0] * n[1] * n[2] * n[3] * 4 * 9 * sizeof(std::complex<double>);
+}
+
+// Write the whole buffer at the given position
+void WriteAt(int file, const void* data, std::uint64_t bytes, std::uint64_t offset)
+{
+  const char* begin = (const char*)data;
+  while (bytes > 0) {
+    ssize_t written = pwrite(file, begin, bytes, offset);
+    if (written <= 0) {
+      std::cout << "ERROR while writing the ensemble file.\n";
+      throw 1;
+    }
+    begin += written;
+    bytes -= written;
+    offset += written;
+  }
+}
+
+FileHeader BuildHeader(const EnsembleSettings& settings,
+                       std::uint32_t codec,
+                       EnsembleLayout layout,
+                       std::uint64_t nconfigs,
+                       std::uint64_t index_offset)
+{
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.endian = kEndian;
+  header.codec = codec;
+  header.layout = (std::uint32_t)layout;
+  for (int k = 0; k < 4; k++) header.ncells[k] = settings.ncells[k];
+  for (int k = 0; k < 4; k++) header.int_params[k] = settings.integer_params[k];
+  for (int k = 0; k < 5; k++) header.float_params[k] = settings.floating_params[k];
+  header.int_params[3] = nconfigs;
+  header.improved = settings.improved;
+  header.nconfigs = nconfigs;
+  header.index_offset = index_offset;
+  header.config_bytes = ConfigBytes(settings.ncells);
+  return header;
+}
+
+// Longest number of the text format: sign, 16 significant digits, point, exponent and a space
+const int kTextNumberWidth = 24;
+
+// Format a configuration as a line of the text format. std::to_chars with the scientific format
+// and 15 digits after the point writes exactly what the stream writes with std::scientific and
+// std::setprecision(15), without the locale and the stream state in the way
+void FormatConfiguration(const Path& path, std::string& line)
+{
+  const std::complex<double>* data = path.GetData();
+  line.resize(path.GetSize() * 2 * kTextNumberWidth + 1);
+  char* out = &line[0];
+  char* const last = out + line.size();
+  const int digits = std::numeric_limits<double>::digits10;
+  for (std::size_t link = 0; link < path.GetSize() / 9; link++) {
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        const std::complex<double>& element = data[9 * link + 3 * j + i];
+        out = std::to_chars(out, last, element.real(), std::chars_format::scientific, digits).ptr;
+        *out++ = ' ';
+        out = std::to_chars(out, last, element.imag(), std::chars_format::scientific, digits).ptr;
+        *out++ = ' ';
+      }
+    }
+  }
+  *out++ = '\n';
+  line.resize(out - &line[0]);
+}
+
+// Parse a line of the text format into a configuration. std::from_chars rounds correctly, as the
+// stream does, so the values are the same bit by bit
+// \return false if the line does not hold exactly the numbers of one configuration
+bool ParseConfiguration(const char* begin, const char* end, Path& path)
+{
+  std::complex<double>* data = path.GetData();
+  double real = 0., imag = 0.;
+  for (std::size_t link = 0; link < path.GetSize() / 9; link++) {
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        for (double* value : {&real, &imag}) {
+          while (begin < end && std::isspace((unsigned char)*begin)) begin++;
+          std::from_chars_result result = std::from_chars(begin, end, *value);
+          if (result.ec != std::errc()) return false;
+          begin = result.ptr;
+        }
+        data[9 * link + 3 * j + i] = std::complex<double>(real, imag);
+      }
+    }
+  }
+  while (begin < end && std::isspace((unsigned char)*begin)) begin++;
+  return begin == end;
+}
+
+// Threads of the parallel loops over configurations and byte planes, started by the first loop
+// and kept for the following ones: a loop run by a task of another loop, of this pool or of the
+// pool of the analyses, runs serially on the thread of that task
+ThreadPool& FilePool()
+{
+  static ThreadPool pool(0);
+  return pool;
+}
+
+// Checksum of a compressed block, from the plane sizes to the end of the block
+std::uint32_t BlockChecksum(const BlockHeader& header, const char* planes, std::uint64_t bytes)
+{
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, (const Bytef*)header.plane_bytes, sizeof(header.plane_bytes));
+  while (bytes > 0) {  // crc32 takes the length as a 32 bit integer
+    const uInt chunk = (uInt)std::min<std::uint64_t>(bytes, 1u << 30);
+    crc = crc32(crc, (const Bytef*)planes, chunk);
+    planes += chunk;
+    bytes -= chunk;
+  }
+  return crc;
+}
+
+// Digest of bytes, continuing a previous digest (kDigestSeed for the first bytes): CRC-32 in the
+// high half and Adler-32 in the low half
+std::uint64_t Digest(const void* data, std::uint64_t bytes, std::uint64_t digest)
+{
+  uLong crc = digest >> 32;
+  uLong adler = digest & 0xffffffff;
+  const Bytef* begin = (const Bytef*)data;
+  while (bytes > 0) {  // as in BlockChecksum, the length is a 32 bit integer
+    const uInt chunk = (uInt)std::min<std::uint64_t>(bytes, 1u << 30);
+    crc = crc32(crc, begin, chunk);
+    adler = adler32(adler, begin, chunk);
+    begin += chunk;
+    bytes -= chunk;
+  }
+  return ((std::uint64_t)crc << 32) | adler;
+}
+
+// Compress size complex numbers into a block. The k-th byte of all the doubles goes into the k-th
+// plane: sign and exponent bytes, which vary little across a configuration, end up next to each
+// other and compress well. The planes are compressed independently, in parallel
+void EncodeBlock(const std::complex<double>* values,
+                 std::size_t size,
+                 std::vector<char>& block,
+                 std::vector<char>& planes)
+{
+  const std::size_t ndoubles = size * 2;
+  const char* data = (const char*)values;
+  planes.resize(ndoubles * kPlanes);
+  for (std::size_t k = 0; k < ndoubles; k++)
+    for (int b = 0; b < kPlanes; b++) planes[b * ndoubles + k] = data[k * kPlanes + b];
+
+  const uLong bound = compressBound(ndoubles);
+  block.resize(sizeof(BlockHeader) + kPlanes * bound);
+  BlockHeader header;
+  std::memset(&header, 0, sizeof(header));
+  int status[kPlanes];
+  FilePool().Run(kPlanes, [&](int b) {
+    uLongf bytes = bound;
+    status[b] = compress2((Bytef*)&block[sizeof(BlockHeader) + b * bound], &bytes,
+                          (const Bytef*)&planes[b * ndoubles], ndoubles, Z_BEST_SPEED);
+    header.plane_bytes[b] = bytes;
+  });
+  if (std::count(status, status + kPlanes, Z_OK) != kPlanes) {
+    std::cout << "ERROR while compressing a lattice configuration.\n";
+    throw 1;
+  }
+  std::uint64_t end = sizeof(BlockHeader);  // pack the planes one after the other
+  for (int b = 0; b < kPlanes; b++) {
+    std::memmove(&block[end], &block[sizeof(BlockHeader) + b * bound], header.plane_bytes[b]);
+    end += header.plane_bytes[b];
+  }
+  block.resize(end);
+  header.checksum = BlockChecksum(header, &block[sizeof(BlockHeader)], end - sizeof(BlockHeader));
+  std::memcpy(&block[0], &header, sizeof(header));
+}
+
+// Check the checksum of a block, then decompress its planes in parallel into size complex numbers
+// \return false if the block is corrupted
+bool DecodeBlock(const char* block,
+                 std::uint64_t bytes,
+                 std::complex<double>* values,
+                 std::size_t size,
+                 std::vector<char>& planes)
+{
+  BlockHeader header;
+  if (bytes < sizeof(header)) return false;
+  std::memcpy(&header, block, sizeof(header));
+  std::uint64_t offsets[kPlanes];
+  std::uint64_t end = sizeof(header);
+  for (int b = 0; b < kPlanes; b++) {
+    if (header.plane_bytes[b] > bytes - end) return false;
+    offsets[b] = end;
+    end += header.plane_bytes[b];
+  }
+  if (end != bytes || BlockChecksum(header, block + sizeof(header), bytes - sizeof(header)) !=
+                          header.checksum)
+    return false;
+
+  const std::size_t ndoubles = size * 2;
+  planes.resize(ndoubles * kPlanes);
+  bool decoded[kPlanes];
+  FilePool().Run(kPlanes, [&](int b) {
+    uLongf size = ndoubles;
+    decoded[b] = uncompress((Bytef*)&planes[b * ndoubles], &size, (const Bytef*)block + offsets[b],
+                            header.plane_bytes[b]) == Z_OK &&
+                 size == ndoubles;
+  });
+  if (std::count(decoded, decoded + kPlanes, true) != kPlanes) return false;
+  char* data = (char*)values;
+  for (std::size_t k = 0; k < ndoubles; k++)
+    for (int b = 0; b < kPlanes; b++) data[k * kPlanes + b] = planes[b * ndoubles + k];
+  return true;
+}
+
+// Number of blocks (segments) in which a configuration is stored: 1 in the memory order of Path,
+// one per direction, or one per direction and time slice
+int SegmentCount(EnsembleLayout layout, const std::vector<int>& n)
+{
+  if (layout == EnsembleLayout::Directions) return 4;
+  if (layout == EnsembleLayout::TimeSlices) return 4 * n[3];
+  return 1;
+}
+
+// Number of complex numbers in a segment
+std::size_t SegmentSize(EnsembleLayout layout, const std::vector<int>& n)
+{
+  return (std::size_t)n[0] * n[1] * n[2] * n[3] * 4 * 9 / SegmentCount(layout, n);
+}
+
+// Direction and time slice of the links in the s-th segment (-1 = all)
+void SegmentContent(EnsembleLayout layout, const std::vector<int>& n, int s, int& mu, int& t)
+{
+  const int slices = layout == EnsembleLayout::TimeSlices ? n[3] : 1;
+  mu = layout == EnsembleLayout::Sites ? -1 : s / slices;
+  t = layout == EnsembleLayout::TimeSlices ? s % slices : -1;
+}
+
+// Copy the links of the s-th segment between a path and a contiguous array, in the order of the
+// sites of Path, in one direction or the other
+void CopySegment(EnsembleLayout layout, int s, const Path& path, std::complex<double>* segment)
+{
+  const std::vector<int> n = path.GetNCells();
+  int mu, t;
+  SegmentContent(layout, n, s, mu, t);
+  const std::complex<double>* data = path.GetData();
+  if (mu < 0) {
+    std::copy(data, data + path.GetSize(), segment);
+    return;
+  }
+  const std::size_t nsites = path.GetSize() / 36;
+  const std::size_t first = t < 0 ? 0 : t, stride = t < 0 ? 1 : n[3];
+  for (std::size_t site = first; site < nsites; site += stride, segment += 9)
+    std::copy(data + (site * 4 + mu) * 9, data + (site * 4 + mu + 1) * 9, segment);
+}
+void CopySegment(EnsembleLayout layout, int s, const std::complex<double>* segment, Path& path)
+{
+  const std::vector<int> n = path.GetNCells();
+  int mu, t;
+  SegmentContent(layout, n, s, mu, t);
+  std::complex<double>* data = path.GetData();
+  if (mu < 0) {
+    std::copy(segment, segment + path.GetSize(), data);
+    return;
+  }
+  const std::size_t nsites = path.GetSize() / 36;
+  const std::size_t first = t < 0 ? 0 : t, stride = t < 0 ? 1 : n[3];
+  for (std::size_t site = first; site < nsites; site += stride, segment += 9)
+    std::copy(segment, segment + 9, data + (site * 4 + mu) * 9);
+}
+}  // namespace
+
+/************************ EnsembleSettings ***************************/
+
+// Compare everything but the number of configurations
+bool SameExperiment(const EnsembleSettings& first, const EnsembleSettings& second)
+{
+  return first.ncells == second.ncells && first.floating_params == second.floating_params &&
+         first.improved == second.improved && first.integer_params.size() == 4 &&
+         second.integer_params.size() == 4 &&
+         std::equal(first.integer_params.begin(), first.integer_params.begin() + 3,
+                    second.integer_params.begin());
+}
+
+/************************ EnsembleWriter ***************************/
+
+// Constructor: a new file gets a provisional header with no index; an existing file keeps its
+// header, index, checkpoint and blocks untouched until EnsembleWriter::Close, and the new blocks
+// go after its end, so that the file stays valid if the writing is interrupted. The space given up
+// by the previous runs is first reclaimed, if it has grown too large
+EnsembleWriter::EnsembleWriter(const std::string& filename,
+                               const EnsembleSettings& settings,
+                               bool compressed,
+                               EnsembleLayout layout,
+                               bool append)
+    : fSettings(settings)
+    , fCodec(compressed ? kCodecZlib : kCodecRaw)
+    , fLayout(layout)
+    , fEnd(sizeof(FileHeader))
+    , fCheckpointOffset(0)
+    , fCheckpointBytes(0)
+{
+  if (settings.ncells.size() != 4 || settings.integer_params.size() != 4 ||
+      settings.floating_params.size() != 5)
+    throw 1;
+  if (append) {
+    Compact(filename);
+    EnsembleReader existing(filename);  // header and index are checked here
+    if (!SameExperiment(existing.fSettings, fSettings)) {
+      std::cout << "ERROR: the settings differ from those of the ensemble file to append to.\n";
+      throw 1;
+    }
+    fCodec = existing.fCodec;
+    fLayout = existing.fLayout;
+    fOffsets = existing.fOffsets;
+    fBlockBytes = existing.fBlockBytes;
+    fCheckpointOffset = existing.fCheckpointOffset;
+    fCheckpointBytes = existing.fCheckpointBytes;
+    fFile = open(filename.c_str(), O_WRONLY);
+    const off_t end = fFile < 0 ? -1 : lseek(fFile, 0, SEEK_END);
+    if (end < 0) {
+      std::cout << "ERROR while opening the output file.\n";
+      throw 1;
+    }
+    fEnd = end;
+    return;
+  }
+  fFile = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fFile < 0) {
+    std::cout << "ERROR while opening the output file.\n";
+    throw 1;
+  }
+  FileHeader header = BuildHeader(fSettings, fCodec, fLayout, 0, 0);
+  WriteAt(fFile, &header, sizeof(header), 0);
+}
+
+// Destructor
+EnsembleWriter::~EnsembleWriter()
+{
+  if (fFile >= 0) {
+    try {
+      Close();
+    } catch (...) {
+      close(fFile);
+    }
+  }
+}
+
+// Append the segments of a configuration after the previous blocks, one block each
+void EnsembleWriter::Append(const Path& path)
+{
+  if (path.GetNCells() != fSettings.ncells) throw 1;
+  const int nsegments = SegmentCount(fLayout, fSettings.ncells);
+  const std::size_t size = SegmentSize(fLayout, fSettings.ncells);
+  for (int s = 0; s < nsegments; s++) {
+    const std::complex<double>* values = path.GetData();
+    if (fLayout != EnsembleLayout::Sites) {
+      fSegment.resize(size);
+      CopySegment(fLayout, s, path, fSegment.data());
+      values = fSegment.data();
+    }
+    std::uint64_t bytes = 0;
+    const void* block = Encode(values, size, bytes);
+    WriteBlock(block, bytes);
+  }
+}
+
+// Write the chain state after the blocks, in the memory order of Path: it is not part of the index
+void EnsembleWriter::SetCheckpoint(const Path& path)
+{
+  if (path.GetNCells() != fSettings.ncells) throw 1;
+  std::uint64_t bytes = 0;
+  const void* block = Encode(path.GetData(), path.GetSize(), bytes);
+  WriteCheckpoint(block, bytes);
+}
+
+// Block of size complex numbers as it is written: the raw doubles, or the compressed block in
+// fBlock
+const void* EnsembleWriter::Encode(const std::complex<double>* values,
+                                   std::size_t size,
+                                   std::uint64_t& bytes)
+{
+  if (fCodec == kCodecRaw) {
+    bytes = size * sizeof(std::complex<double>);
+    return values;
+  }
+  EncodeBlock(values, size, fBlock, fPlanes);
+  bytes = fBlock.size();
+  return fBlock.data();
+}
+
+// Compress batches of configurations in parallel, one configuration per thread, and write each
+// batch in order
+void EnsembleWriter::AppendAll(const Ensemble& ensemble, int nconfigs)
+{
+  if (nconfigs < 0 || nconfigs > ensemble.GetNSlots()) throw 1;
+  for (int k = 0; k < nconfigs; k++)
+    if (ensemble[k].GetNCells() != fSettings.ncells) throw 1;
+  if (fCodec == kCodecRaw) {
+    for (int k = 0; k < nconfigs; k++) Append(ensemble[k]);
+    return;
+  }
+  const int nsegments = SegmentCount(fLayout, fSettings.ncells);
+  const std::size_t size = SegmentSize(fLayout, fSettings.ncells);
+  const int batch = FilePool().GetNThreads();
+  std::vector<std::vector<std::vector<char>>> blocks(std::min(batch, nconfigs));
+  for (int first = 0; first < nconfigs; first += batch) {
+    const int count = std::min(batch, nconfigs - first);
+    FilePool().Run(count, [&](int k) {
+      std::vector<std::complex<double>> segment(fLayout == EnsembleLayout::Sites ? 0 : size);
+      std::vector<char> planes;
+      blocks[k].resize(nsegments);
+      for (int s = 0; s < nsegments; s++) {
+        const std::complex<double>* values = ensemble[first + k].GetData();
+        if (fLayout != EnsembleLayout::Sites) {
+          CopySegment(fLayout, s, ensemble[first + k], segment.data());
+          values = segment.data();
+        }
+        EncodeBlock(values, size, blocks[k][s], planes);
+      }
+    });
+    for (int k = 0; k < count; k++)
+      for (const std::vector<char>& block : blocks[k]) WriteBlock(block.data(), block.size());
+  }
+}
+
+// Write a block after the previous ones and record it in the index. A checkpoint written before,
+// e.g. the one of the file appended to, is the state of the chain before this configuration: it
+// is dropped, so that a run stopped before SetCheckpoint is resumed from its last configuration
+void EnsembleWriter::WriteBlock(const void* data, std::uint64_t bytes)
+{
+  WriteAt(fFile, data, bytes, fEnd);
+  fOffsets.push_back(fEnd);
+  fBlockBytes.push_back(bytes);
+  fEnd += bytes;
+  fCheckpointOffset = 0;
+  fCheckpointBytes = 0;
+}
+
+// Write the checkpoint block after the previous blocks, in place of the previous checkpoint
+void EnsembleWriter::WriteCheckpoint(const void* data, std::uint64_t bytes)
+{
+  WriteAt(fFile, data, bytes, fEnd);
+  fCheckpointOffset = fEnd;
+  fCheckpointBytes = bytes;
+  fEnd += bytes;
+}
+
+// Copy the blocks of the index and the checkpoint, as they are stored, into a new file which then
+// replaces the ensemble file: the unused bytes are the indices and the checkpoints replaced by the
+// previous runs, and an interrupted compaction only leaves the new file behind
+void EnsembleWriter::Compact(const std::string& filename)
+{
+  const std::string temporary = filename + ".compact";
+  {
+    EnsembleReader existing(filename);
+    struct stat status;
+    if (fstat(existing.fFile, &status) != 0) {
+      std::cout << "ERROR while opening the input file.\n";
+      throw 1;
+    }
+    std::uint64_t used = sizeof(FileHeader) + existing.fCheckpointBytes +
+                         existing.fOffsets.size() * sizeof(IndexEntry);
+    for (std::uint64_t bytes : existing.fBlockBytes) used += bytes;
+    if (((std::uint64_t)status.st_size - used) * kCompaction <= (std::uint64_t)status.st_size)
+      return;
+    EnsembleWriter compacted(temporary, existing.fSettings, existing.fCodec == kCodecZlib,
+                             existing.fLayout);
+    std::vector<char> block;
+    for (unsigned int k = 0; k < existing.fOffsets.size(); k++) {
+      block.resize(existing.fBlockBytes[k]);
+      existing.ReadBlock(existing.fOffsets[k], block.size(), block.data());
+      compacted.WriteBlock(block.data(), block.size());
+    }
+    if (existing.HasCheckpoint()) {
+      block.resize(existing.fCheckpointBytes);
+      existing.ReadBlock(existing.fCheckpointOffset, block.size(), block.data());
+      compacted.WriteCheckpoint(block.data(), block.size());
+    }
+    compacted.Close();
+  }
+  if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+    std::cout << "ERROR while compacting the ensemble file.\n";
+    throw 1;
+  }
+}
+
+// Flush the blocks written so far
+void EnsembleWriter::Sync()
+{
+  if (fFile >= 0 && fdatasync(fFile) != 0) {
+    std::cout << "ERROR while flushing the ensemble file.\n";
+    throw 1;
+  }
+}
+
+// Write the index after the data, then the final header: the header is written only once data
+// and index are on the storage device. The header fits in a single disk sector, so that it is
+// replaced as a whole: the new configurations and the new count become visible together
+void EnsembleWriter::Close()
+{
+  if (fFile < 0) return;
+  std::vector<IndexEntry> index(fOffsets.size());
+  for (unsigned int i = 0; i < index.size(); i++) index[i] = {fOffsets[i], fBlockBytes[i]};
+  WriteAt(fFile, index.data(), index.size() * sizeof(IndexEntry), fEnd);
+  Sync();
+  const std::size_t nconfigs = index.size() / SegmentCount(fLayout, fSettings.ncells);
+  FileHeader header = BuildHeader(fSettings, fCodec, fLayout, nconfigs, fEnd);
+  header.checkpoint_offset = fCheckpointOffset;
+  header.checkpoint_bytes = fCheckpointBytes;
+  WriteAt(fFile, &header, sizeof(header), 0);
+  Sync();
+  close(fFile);
+  fFile = -1;
+}
+
+/************************ TextEnsembleWriter ***************************/
+
+// Constructor: write the settings, with the same stream format as the configurations
+TextEnsembleWriter::TextEnsembleWriter(const std::string& filename,
+                                       const EnsembleSettings& settings)
+    : fFile(filename), fNCells(settings.ncells), fAnnounced(settings.integer_params[3]), fCount(0)
+{
+  if (!fFile) {
+    std::cout << "ERROR while opening the output file.\n";
+    throw 1;
+  }
+  typedef std::numeric_limits<double> dbl;
+  fFile << std::scientific << std::setprecision(dbl::digits10);
+  for (int k = 0; k < 3; k++) fFile << settings.integer_params[k] << std::endl;
+  fCountField = fFile.tellp();
+  fFile << fAnnounced << std::endl;
+  for (int k = 0; k < 5; k++) fFile << settings.floating_params[k] << std::endl;
+  fFile << settings.improved << std::endl;
+  fFile << fNCells[0] << "  " << fNCells[1] << "  " << fNCells[2] << "  " << fNCells[3]
+        << std::endl;
+}
+
+// Destructor
+TextEnsembleWriter::~TextEnsembleWriter()
+{
+  try {
+    Close();
+  } catch (...) {
+  }
+}
+
+// Append a configuration line: the storage of Path is column-major, the file is row-major
+void TextEnsembleWriter::Append(const Path& path)
+{
+  if (path.GetNCells() != fNCells) throw 1;
+  FormatConfiguration(path, fLine);
+  fFile.write(fLine.data(), fLine.size());
+  if (!fFile) {
+    std::cout << "ERROR while writing the ensemble file.\n";
+    throw 1;
+  }
+  fCount++;
+}
+
+// Format batches of lines in parallel, one line per thread, and write each batch in order
+void TextEnsembleWriter::AppendAll(const Ensemble& ensemble, int nconfigs)
+{
+  if (nconfigs < 0 || nconfigs > ensemble.GetNSlots()) throw 1;
+  for (int k = 0; k < nconfigs; k++)
+    if (ensemble[k].GetNCells() != fNCells) throw 1;
+  const int batch = FilePool().GetNThreads();
+  std::vector<std::string> lines(std::min(batch, nconfigs));
+  for (int first = 0; first < nconfigs; first += batch) {
+    const int count = std::min(batch, nconfigs - first);
+    FilePool().Run(count, [&](int k) { FormatConfiguration(ensemble[first + k], lines[k]); });
+    for (int k = 0; k < count; k++) {
+      fFile.write(lines[k].data(), lines[k].size());
+      if (!fFile) {
+        std::cout << "ERROR while writing the ensemble file.\n";
+        throw 1;
+      }
+      fCount++;
+    }
+  }
+}
+
+// Correct the number of configurations, padding with spaces to the width of the announced one
+void TextEnsembleWriter::Close()
+{
+  if (!fFile.is_open()) return;
+  if (fCount != fAnnounced) {
+    std::string count = std::to_string(fCount);
+    std::string announced = std::to_string(fAnnounced);
+    if (count.size() > announced.size()) {
+      std::cout << "ERROR: more configurations than announced in the text ensemble file.\n";
+      throw 1;
+    }
+    count.resize(announced.size(), ' ');
+    fFile.seekp(fCountField);
+    fFile << count;
+  }
+  fFile.close();
+}
+
+/************************ EnsembleReader ***************************/
+
+// Check the magic string
+bool EnsembleReader::IsEnsembleFile(const std::string& filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  char magic[8] = {0};
+  file.read(magic, sizeof(magic));
+  return file && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+// Constructor: read and check header and index
+EnsembleReader::EnsembleReader(const std::string& filename) : fFilename(filename), fFile(-1)
+{
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    std::cout << "ERROR while opening the input file.\n";
+    throw 1;
+  }
+  FileHeader header;
+  file.read((char*)&header, sizeof(header));
+  if (!file || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    std::cout << "ERROR: " << filename << " is not a binary ensemble file.\n";
+    throw 1;
+  }
+  if (header.endian != kEndian) {
+    std::cout << "ERROR: the ensemble file was written with a different byte order.\n";
+    throw 1;
+  }
+  if (header.version != kVersion || (header.codec != kCodecRaw && header.codec != kCodecZlib) ||
+      header.layout > (std::uint32_t)EnsembleLayout::TimeSlices) {
+    std::cout << "ERROR: unsupported version of the ensemble file format.\n";
+    throw 1;
+  }
+  for (int k = 0; k < 4; k++) {
+    if (header.ncells[k] <= 0) {
+      std::cout << "ERROR: invalid lattice dimensions in the ensemble file.\n";
+      throw 1;
+    }
+  }
+  if (header.config_bytes != ConfigBytes({header.ncells, header.ncells + 4})) {
+    std::cout << "ERROR: inconsistent configuration size in the ensemble file.\n";
+    throw 1;
+  }
+  if (header.index_offset == 0) {
+    std::cout << "ERROR: the ensemble file is incomplete (missing index).\n";
+    throw 1;
+  }
+  fCodec = header.codec;
+  fLayout = (EnsembleLayout)header.layout;
+  fCheckpointOffset = header.checkpoint_offset;
+  fCheckpointBytes = header.checkpoint_bytes;
+  fSettings.ncells.assign(header.ncells, header.ncells + 4);
+  fSettings.integer_params.assign(header.int_params, header.int_params + 4);
+  fSettings.floating_params.assign(header.float_params, header.float_params + 5);
+  fSettings.improved = header.improved;
+  fSettings.integer_params[3] = header.nconfigs;
+  fNSegments = SegmentCount(fLayout, fSettings.ncells);
+
+  std::vector<IndexEntry> index(header.nconfigs * fNSegments);
+  file.seekg(header.index_offset);
+  file.read((char*)index.data(), index.size() * sizeof(IndexEntry));
+  if (!file) {
+    std::cout << "ERROR while reading the index of the ensemble file.\n";
+    throw 1;
+  }
+  auto valid_block = [&header, this](std::uint64_t offset, std::uint64_t bytes, int nsegments) {
+    const bool valid_size = fCodec == kCodecRaw ? bytes == header.config_bytes / nsegments
+                                                : bytes >= sizeof(BlockHeader);
+    return valid_size && offset >= sizeof(FileHeader) && offset <= header.index_offset &&
+           bytes <= header.index_offset - offset;
+  };
+  for (const IndexEntry& entry : index) {
+    if (!valid_block(entry.offset, entry.bytes, fNSegments) ||
+        (fCodec == kCodecRaw && entry.offset % sizeof(std::complex<double>) != 0)) {
+      std::cout << "ERROR: corrupted index in the ensemble file.\n";
+      throw 1;
+    }
+    fOffsets.push_back(entry.offset);
+    fBlockBytes.push_back(entry.bytes);
+  }
+  if (fCheckpointOffset != 0 && !valid_block(fCheckpointOffset, fCheckpointBytes, 1)) {
+    std::cout << "ERROR: corrupted checkpoint in the ensemble file.\n";
+    throw 1;
+  }
+  fFile = open(filename.c_str(), O_RDONLY);
+  if (fFile < 0) {
+    std::cout << "ERROR while opening the input file.\n";
+    throw 1;
+  }
+}
+
+// Destructor
+EnsembleReader::~EnsembleReader()
+{
+  if (fFile >= 0) close(fFile);
+}
+
+// Getters
+EnsembleSettings EnsembleReader::GetSettings() const
+{
+  return fSettings;
+}
+int EnsembleReader::GetNConfigs() const
+{
+  return fOffsets.size() / fNSegments;
+}
+EnsembleLayout EnsembleReader::GetLayout() const
+{
+  return fLayout;
+}
+
+// Read a block with positioned reads
+void EnsembleReader::ReadBlock(std::uint64_t offset, std::uint64_t bytes, void* data) const
+{
+  char* begin = (char*)data;
+  while (bytes > 0) {
+    ssize_t read = pread(fFile, begin, bytes, offset);
+    if (read <= 0) {
+      std::cout << "ERROR while reading the lattice configurations from file.\n";
+      throw 1;
+    }
+    begin += read;
+    bytes -= read;
+    offset += read;
+  }
+}
+
+// Read a block of size complex numbers, decompressing it if needed
+bool EnsembleReader::LoadBlock(std::uint64_t offset,
+                               std::uint64_t bytes,
+                               std::complex<double>* values,
+                               std::size_t size) const
+{
+  if (fCodec == kCodecRaw) {
+    ReadBlock(offset, bytes, values);
+    return true;
+  }
+  std::vector<char> block(bytes), planes;
+  ReadBlock(offset, bytes, block.data());
+  return DecodeBlock(block.data(), block.size(), values, size, planes);
+}
+
+// Read the segments of the i-th configuration which hold the requested links
+bool EnsembleReader::LoadSegments(int i,
+                                  Path& path,
+                                  const std::vector<int>& directions,
+                                  const std::vector<int>& slices) const
+{
+  const std::size_t size = SegmentSize(fLayout, fSettings.ncells);
+  if (fLayout == EnsembleLayout::Sites)
+    return LoadBlock(fOffsets[i], fBlockBytes[i], path.GetData(), size);
+  std::vector<std::complex<double>> segment(size);
+  for (int s = 0; s < fNSegments; s++) {
+    int mu, t;
+    SegmentContent(fLayout, fSettings.ncells, s, mu, t);
+    if (std::find(directions.begin(), directions.end(), mu) == directions.end()) continue;
+    if (t >= 0 && !slices.empty() && std::find(slices.begin(), slices.end(), t) == slices.end())
+      continue;
+    const int block = i * fNSegments + s;
+    if (!LoadBlock(fOffsets[block], fBlockBytes[block], segment.data(), size))
+      return false;
+    CopySegment(fLayout, s, segment.data(), path);
+  }
+  return true;
+}
+
+// Read the i-th configuration
+void EnsembleReader::Load(int i, Path& path) const
+{
+  Load(i, path, {0, 1, 2, 3});
+}
+void EnsembleReader::Load(int i,
+                          Path& path,
+                          const std::vector<int>& directions,
+                          const std::vector<int>& slices) const
+{
+  if (i < 0 || i >= GetNConfigs() || path.GetNCells() != fSettings.ncells) throw 1;
+  if (!LoadSegments(i, path, directions, slices)) {
+    std::cout << "ERROR: corrupted configuration " << i << " in the ensemble file.\n";
+    throw 1;
+  }
+}
+
+// Checkpoint getters
+bool EnsembleReader::HasCheckpoint() const
+{
+  return fCheckpointOffset != 0;
+}
+void EnsembleReader::LoadCheckpoint(Path& path) const
+{
+  if (!HasCheckpoint() || path.GetNCells() != fSettings.ncells) throw 1;
+  if (!LoadBlock(fCheckpointOffset, fCheckpointBytes, path.GetData(), path.GetSize())) {
+    std::cout << "ERROR: corrupted checkpoint in the ensemble file.\n";
+    throw 1;
+  }
+}
+
+// Map the file and place the slots on the configuration blocks; compressed or reordered blocks
+// are read in parallel instead, one configuration per thread
+Ensemble EnsembleReader::MapEnsemble() const
+{
+  if (fCodec != kCodecRaw || fLayout != EnsembleLayout::Sites) {
+    Ensemble ensemble(fSettings.ncells, GetNConfigs());
+    std::vector<char> loaded(GetNConfigs(), 0);
+    FilePool().Run(GetNConfigs(), [&](int i) {
+      try {
+        loaded[i] = LoadSegments(i, ensemble[i], {0, 1, 2, 3}, {});
+      } catch (...) {
+      }
+    });
+    for (unsigned int i = 0; i < loaded.size(); i++) {
+      if (!loaded[i]) {
+        std::cout << "ERROR: corrupted configuration " << i << " in the ensemble file.\n";
+        throw 1;
+      }
+    }
+    return ensemble;
+  }
+  std::vector<std::size_t> offsets;
+  for (std::uint64_t offset : fOffsets) offsets.push_back(offset / sizeof(std::complex<double>));
+  return Ensemble(fSettings.ncells, LinkBuffer(fFilename), offsets);
+}
+
+// Digest of the stored blocks of each configuration, computed in parallel
+std::vector<std::uint64_t> EnsembleReader::Digests() const
+{
+  std::vector<std::uint64_t> digests(GetNConfigs(), kDigestSeed);
+  std::vector<char> read(GetNConfigs(), 0);
+  FilePool().Run(GetNConfigs(), [&](int i) {
+    try {
+      std::vector<char> block;
+      for (int s = 0; s < fNSegments; s++) {
+        const std::size_t k = (std::size_t)i * fNSegments + s;
+        block.resize(fBlockBytes[k]);
+        ReadBlock(fOffsets[k], fBlockBytes[k], block.data());
+        digests[i] = Digest(block.data(), block.size(), digests[i]);
+      }
+      read[i] = 1;
+    } catch (...) {
+    }
+  });
+  if (std::find(read.begin(), read.end(), 0) != read.end()) {
+    std::cout << "ERROR while reading the lattice configurations from file.\n";
+    throw 1;
+  }
+  return digests;
+}
+
+/************************ TextEnsembleReader ***************************/
+
+// Constructor: read the settings
+TextEnsembleReader::TextEnsembleReader(const std::string& filename)
+    : fFilename(filename), fFile(filename), fCount(0)
+{
+  if (!fFile) {
+    std::cout << "ERROR while opening the input file.\n";
+    throw 1;
+  }
+  fSettings.ncells.assign(4, 0);
+  fSettings.integer_params.assign(4, 0);
+  fSettings.floating_params.assign(5, 0.);
+  for (int k = 0; k < 4; k++) fFile >> fSettings.integer_params[k];
+  for (int k = 0; k < 5; k++) fFile >> fSettings.floating_params[k];
+  fFile >> fSettings.improved;
+  for (int k = 0; k < 4; k++) fFile >> fSettings.ncells[k];
+  if (!fFile) {
+    std::cout << "ERROR while reading the settings from file.\n";
+    throw 1;
+  }
+}
+
+// Destructor
+TextEnsembleReader::~TextEnsembleReader()
+{
+}
+
+// Getters
+EnsembleSettings TextEnsembleReader::GetSettings() const
+{
+  return fSettings;
+}
+int TextEnsembleReader::GetNConfigs() const
+{
+  return fSettings.integer_params[3];
+}
+
+// Parse the next configuration line: the file is row-major, the storage of Path is column-major
+void TextEnsembleReader::Read(Path& path)
+{
+  if (path.GetNCells() != fSettings.ncells || fCount >= GetNConfigs()) throw 1;
+  // the first call finds the end of the line of the lattice dimensions
+  do {
+    std::getline(fFile, fLine);
+  } while (fFile && fLine.find_first_not_of(" \t\r") == std::string::npos);
+  if (!fFile || !ParseConfiguration(fLine.data(), fLine.data() + fLine.size(), path)) {
+    std::cout << "ERROR while reading the lattice configurations from file.\n" << std::flush;
+    throw 1;
+  }
+  fCount++;
+}
+
+// Map the rest of the file, find the configuration lines and parse them in parallel
+void TextEnsembleReader::ReadAll(Ensemble& ensemble)
+{
+  const int nconfigs = ensemble.GetNSlots();
+  if (nconfigs > GetNConfigs() - fCount) throw 1;
+  for (int k = 0; k < nconfigs; k++)
+    if (ensemble[k].GetNCells() != fSettings.ncells) throw 1;
+  const std::streamoff start = fFile.tellg();
+  struct stat status;
+  const int file = open(fFilename.c_str(), O_RDONLY);
+  if (start < 0 || file < 0 || fstat(file, &status) != 0 || status.st_size < start) {
+    if (file >= 0) close(file);
+    std::cout << "ERROR while reading the lattice configurations from file.\n";
+    throw 1;
+  }
+  if (status.st_size == start) {
+    close(file);
+    if (nconfigs == 0) return;
+    std::cout << "ERROR while reading the lattice configurations from file.\n";
+    throw 1;
+  }
+  void* map = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if (map == MAP_FAILED) {
+    std::cout << "ERROR while mapping the ensemble file.\n";
+    throw 1;
+  }
+  const char* const end = (const char*)map + status.st_size;
+
+  // Index the non-empty lines
+  std::vector<const char*> begins, ends;
+  const char* line = (const char*)map + start;
+  while (line < end && (int)begins.size() < nconfigs) {
+    const char* newline = (const char*)std::memchr(line, '\n', end - line);
+    const char* line_end = newline ? newline : end;
+    if (std::find_if_not(line, line_end, [](char c) { return std::isspace((unsigned char)c); }) !=
+        line_end) {
+      begins.push_back(line);
+      ends.push_back(line_end);
+    }
+    line = line_end + 1;
+  }
+
+  std::vector<char> parsed(begins.size(), 0);
+  FilePool().Run(begins.size(), [&](int k) {
+    parsed[k] = ParseConfiguration(begins[k], ends[k], ensemble[k]);
+  });
+  munmap(map, status.st_size);
+  if ((int)begins.size() != nconfigs || std::find(parsed.begin(), parsed.end(), 0) != parsed.end()) {
+    std::cout << "ERROR while reading the lattice configurations from file.\n" << std::flush;
+    throw 1;
+  }
+  fFile.seekg(line < end ? line - (const char*)map : status.st_size);
+  fCount += nconfigs;
+}
+
+// Digest of the configuration lines not read yet, read with a second stream
+std::vector<std::uint64_t> TextEnsembleReader::Digests()
+{
+  std::ifstream file(fFilename);
+  file.seekg(fFile.tellg());
+  std::vector<std::uint64_t> digests;
+  std::string line;
+  while ((int)digests.size() < GetNConfigs() - fCount && std::getline(file, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    digests.push_back(Digest(line.data(), line.size(), kDigestSeed));
+  }
+  if ((int)digests.size() != GetNConfigs() - fCount) {
+    std::cout << "ERROR while reading the lattice configurations from file.\n";
+    throw 1;
+  }
+  return digests;
+}
@@ -0,0 +1,401 @@
+////////////////////////////////////////////////////////////////////////
+/// \file EnsembleFile.h
+/// \brief Header file for the binary ensemble file format
+///
+/// Header file containing the definitions of the structure EnsembleSettings
+/// and of the classes EnsembleWriter and EnsembleReader, which write and
+/// read the versioned binary format of the Montecarlo ensembles, and of the
+/// classes TextEnsembleWriter and TextEnsembleReader, which write and read
+/// the text format. Further comments may be found in the implementation file.
+////////////////////////////////////////////////////////////////////////
+#ifndef ENSEMBLEFILE_H
+#define ENSEMBLEFILE_H
+
+#include <complex>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Ensemble.h"
+#include "Path.h"
+
+/// EnsembleSettings structure
+///
+/// Settings of the experiment which produced an ensemble, in the same form as the arguments of the
+/// Metropolis constructor.
+struct EnsembleSettings {
+  std::vector<int> ncells;              ///< Lattice dimensions in the 4 dimensions
+  std::vector<int> integer_params;      ///< {NofSU3, Ncorr, inner, Ncf}
+  std::vector<double> floating_params;  ///< {a, beta, beta_tilde, u0, epsilon}
+  bool improved = false;                ///< Improved action?
+};
+
+/// EnsembleLayout enum class
+///
+/// Order in which the links of each configuration are stored in the binary ensemble files. With
+/// the Directions and TimeSlices layouts, each group of links is a separate block with its own
+/// entry in the index, so that an analysis which needs only some directions (or time slices) reads
+/// only their blocks. \see EnsembleReader::Load
+enum class EnsembleLayout {
+  Sites,       ///< Memory order of Path: the 4 links of each site one after the other
+  Directions,  ///< One block per direction mu, with the links U_mu(x) of all the sites
+  TimeSlices   ///< One block per direction mu and time slice x_3, with the links U_mu(x) of the
+               ///< slice
+};
+
+/// Compare the settings of two experiments
+/// \return true if the settings are the same, apart from the number of configurations Ncf
+bool SameExperiment(const EnsembleSettings& first, const EnsembleSettings& second);
+
+/// EnsembleWriter class
+///
+/// Writer of the binary ensemble format. The file is made of a fixed-size header (magic string,
+/// version, byte order marker, settings block, number of configurations and position of the
+/// index), followed by one block per configuration with the link variables as raw doubles in the
+/// memory order of Path, and by an index with the offset and the size of every block. The index
+/// is written after the data, and the header is completed last: a file whose writing was
+/// interrupted has no index and is rejected by EnsembleReader.
+///
+/// Optionally, the blocks are compressed without loss: the bytes of the doubles are regrouped in
+/// eight planes (the k-th byte of every double in the k-th plane), which are compressed with zlib
+/// in parallel. Each compressed block starts with the sizes of its planes and a CRC-32 checksum,
+/// so that a corrupted configuration is detected when it is read, without decompressing the
+/// others. In the layouts other than EnsembleLayout::Sites, each configuration is split into
+/// several blocks (one per direction, or per direction and time slice), each with its own entry in
+/// the index and, if compressed, its own checksum.
+///
+/// An existing file can be extended: the new blocks and a new index are written after the end of
+/// the file, and the header is replaced last, so that an interrupted run leaves the previous
+/// ensemble intact. The file may also hold a checkpoint, the state of the Markov chain after the
+/// last configuration, which is not part of the ensemble and from which the chain is resumed.
+/// The index and the checkpoint replaced by each run remain in the file as unused bytes: once they
+/// take more than an eighth of the file, the file is compacted before the next configurations are
+/// appended to it.
+class EnsembleWriter
+{
+ private:
+  int fFile;                               ///< File descriptor of the output file
+  EnsembleSettings fSettings;              ///< Settings written in the header
+  std::uint32_t fCodec;                    ///< Encoding of the blocks, written in the header
+  EnsembleLayout fLayout;                  ///< Order of the links, written in the header
+  std::vector<std::uint64_t> fOffsets;     ///< Offset in bytes of each configuration block
+  std::vector<std::uint64_t> fBlockBytes;  ///< Size in bytes of each configuration block
+  std::uint64_t fEnd;                      ///< Offset at which the next block is written
+  std::uint64_t fCheckpointOffset;         ///< Offset of the checkpoint block (0 = none)
+  std::uint64_t fCheckpointBytes;          ///< Size in bytes of the checkpoint block
+  std::vector<char> fBlock;                ///< Buffer of the compressed block being written
+  std::vector<char> fPlanes;               ///< Buffer of the byte planes being compressed
+  std::vector<std::complex<double>> fSegment;  ///< Buffer of the links of a block, in the layout
+                                               ///< order
+
+  /// Encode a block
+  /// \param values links of the block
+  /// \param size number of complex numbers in the block
+  /// \param bytes set to the size of the encoded block
+  /// \return beginning of the block to be written: values, or fBlock if compressed
+  const void* Encode(const std::complex<double>* values, std::size_t size, std::uint64_t& bytes);
+
+  /// Write a block after the previous ones
+  /// \param data beginning of the block
+  /// \param bytes size of the block
+  void WriteBlock(const void* data, std::uint64_t bytes);
+
+  /// Write the checkpoint block after the previous blocks
+  /// \param data beginning of the block, encoded as the configuration blocks
+  /// \param bytes size of the block
+  void WriteCheckpoint(const void* data, std::uint64_t bytes);
+
+  /// Compact an ensemble file
+  ///
+  /// If more than an eighth of the file is unused, copy its blocks and its checkpoint, without
+  /// decoding them, into filename.compact, which then replaces the file.
+  /// \param filename name of the ensemble file
+  static void Compact(const std::string& filename);
+
+ public:
+  EnsembleWriter() = delete;
+  EnsembleWriter(const EnsembleWriter&) = delete;
+  EnsembleWriter& operator=(const EnsembleWriter&) = delete;
+
+  /// Constructor
+  ///
+  /// Create (or truncate) the output file and write a provisional header, or open an existing
+  /// ensemble file to append configurations to it.
+  /// \param filename name of the output file
+  /// \param settings settings of the experiment, written in the header: when appending, they must
+  /// be the same as those of the file, apart from Ncf
+  /// \param compressed if true, the configuration blocks are compressed; when appending, the
+  /// encoding of the file is kept
+  /// \param layout order of the links in the file; when appending, the layout of the file is kept
+  /// \param append if true, the configurations are appended to the existing file
+  EnsembleWriter(const std::string& filename,
+                 const EnsembleSettings& settings,
+                 bool compressed = false,
+                 EnsembleLayout layout = EnsembleLayout::Sites,
+                 bool append = false);
+
+  /// Destructor: the file is closed, if it was not already
+  ~EnsembleWriter();
+
+  /// Append a configuration to the file
+  /// \param path configuration: its dimensions must match the settings
+  void Append(const Path& path);
+
+  /// Append the first configurations of an ensemble
+  ///
+  /// Compressed blocks are encoded in parallel, in batches of one configuration per hardware
+  /// thread, and written in order: the file is the same as with EnsembleWriter::Append called on
+  /// each slot.
+  /// \param ensemble configurations to be written: their dimensions must match the settings
+  /// \param nconfigs number of slots to be written, starting from the first one
+  void AppendAll(const Ensemble& ensemble, int nconfigs);
+
+  /// Set the checkpoint
+  ///
+  /// Write the state of the chain, to be stored in the file at closing time in place of the
+  /// previous checkpoint. It must follow the last configuration: appending a configuration drops
+  /// the checkpoint, so that a file closed without a new one keeps the previous checkpoint only if
+  /// no configuration was appended to it.
+  /// \param path state of the chain: its dimensions must match the settings
+  void SetCheckpoint(const Path& path);
+
+  /// Flush the configurations written so far to the storage device
+  void Sync();
+
+  /// Close
+  ///
+  /// Write the index, flush the data to the storage device, complete the header and close the
+  /// file.
+  void Close();
+};
+
+/// TextEnsembleWriter class
+///
+/// Writer of the text format read by the Metropolis file constructor: the settings, one per line,
+/// followed by one line per configuration with the real and imaginary parts of the matrix elements
+/// in scientific notation with 15 digits after the point. The matrix elements are written in the
+/// (x, mu, i, j) order, with the row index i before the column index j. The lines are formatted
+/// with std::to_chars, which gives the same characters as the stream formatting.
+class TextEnsembleWriter
+{
+ private:
+  std::ofstream fFile;         ///< Output file
+  std::vector<int> fNCells;    ///< Lattice dimensions
+  int fAnnounced;              ///< Number of configurations written in the settings
+  int fCount;                  ///< Number of configurations appended so far
+  std::streampos fCountField;  ///< Position of the number of configurations in the file
+  std::string fLine;           ///< Buffer of the configuration line being written
+
+ public:
+  TextEnsembleWriter() = delete;
+
+  /// Constructor
+  ///
+  /// Create (or truncate) the output file and write the settings.
+  /// \param filename name of the output file
+  /// \param settings settings of the experiment: integer_params[3] is the number of configurations
+  /// written in the file, which is corrected at closing time if fewer configurations are appended
+  TextEnsembleWriter(const std::string& filename, const EnsembleSettings& settings);
+
+  /// Destructor: the file is closed, if it was not already
+  ~TextEnsembleWriter();
+
+  /// Append a configuration to the file
+  /// \param path configuration: its dimensions must match the settings
+  void Append(const Path& path);
+
+  /// Append the first configurations of an ensemble
+  ///
+  /// The lines are formatted in parallel, in batches of one line per hardware thread, and written
+  /// in order: the file is the same as with TextEnsembleWriter::Append called on each slot.
+  /// \param ensemble configurations to be written: their dimensions must match the settings
+  /// \param nconfigs number of slots to be written, starting from the first one
+  void AppendAll(const Ensemble& ensemble, int nconfigs);
+
+  /// Close
+  ///
+  /// Correct the number of configurations in the settings, if needed, and close the file.
+  void Close();
+};
+
+/// EnsembleReader class
+///
+/// Reader of the binary ensemble format written by EnsembleWriter. The header and the index are
+/// read and checked at construction; the configurations are then accessed through a copy-on-write
+/// mapping of the file, so that only the pages which are actually used are read from disk.
+/// Compressed blocks are checked against their checksum and decompressed when they are read.
+class EnsembleReader
+{
+  friend class EnsembleWriter;
+
+ private:
+  std::string fFilename;                   ///< Name of the input file
+  int fFile;                               ///< File descriptor of the input file
+  EnsembleSettings fSettings;              ///< Settings read from the header
+  std::uint32_t fCodec;                    ///< Encoding of the blocks, read from the header
+  EnsembleLayout fLayout;                  ///< Order of the links, read from the header
+  int fNSegments;                          ///< Number of blocks per configuration
+  std::vector<std::uint64_t> fOffsets;     ///< Offset in bytes of each configuration block
+  std::vector<std::uint64_t> fBlockBytes;  ///< Size in bytes of each configuration block
+  std::uint64_t fCheckpointOffset;         ///< Offset of the checkpoint block (0 = none)
+  std::uint64_t fCheckpointBytes;          ///< Size in bytes of the checkpoint block
+
+  /// Read a block, as it is stored in the file
+  /// \param offset position of the block
+  /// \param bytes size of the block
+  /// \param data destination, large enough for the block
+  void ReadBlock(std::uint64_t offset, std::uint64_t bytes, void* data) const;
+
+  /// Read a block, decompressing it if needed
+  /// \param offset position of the block
+  /// \param bytes size of the block
+  /// \param values destination
+  /// \param size number of complex numbers in the block
+  /// \return false if the block is corrupted
+  bool LoadBlock(std::uint64_t offset,
+                 std::uint64_t bytes,
+                 std::complex<double>* values,
+                 std::size_t size) const;
+
+  /// Read the blocks of a configuration which hold the requested links
+  /// \param i index of the configuration
+  /// \param path destination
+  /// \param directions directions to be read
+  /// \param slices time slices to be read (empty = all)
+  /// \return false if a block is corrupted
+  bool LoadSegments(int i,
+                    Path& path,
+                    const std::vector<int>& directions,
+                    const std::vector<int>& slices) const;
+
+ public:
+  EnsembleReader() = delete;
+  EnsembleReader(const EnsembleReader&) = delete;
+  EnsembleReader& operator=(const EnsembleReader&) = delete;
+
+  /// Constructor
+  ///
+  /// Read and check the header and the index of a binary ensemble file.
+  /// \param filename name of the input file
+  EnsembleReader(const std::string& filename);
+
+  /// Destructor
+  ~EnsembleReader();
+
+  /// Check the format of a file
+  /// \param filename name of the file
+  /// \return true if the file starts with the magic string of the binary ensemble format
+  static bool IsEnsembleFile(const std::string& filename);
+
+  /// \return settings stored in the header; the number of configurations Ncf is the one
+  /// actually stored in the file
+  EnsembleSettings GetSettings() const;
+
+  /// \return number of configurations stored in the file
+  int GetNConfigs() const;
+
+  /// \return order of the links in the file
+  EnsembleLayout GetLayout() const;
+
+  /// Map the ensemble
+  ///
+  /// Map the file and build an Ensemble whose slots are views on the configuration blocks: no
+  /// configuration is copied, and modifications to the slots are not written back to the file.
+  /// A compressed file, or a file in a layout other than EnsembleLayout::Sites, cannot be mapped:
+  /// its configurations are read in parallel into a new ensemble.
+  /// \return ensemble with one slot per configuration in the file
+  Ensemble MapEnsemble() const;
+
+  /// Load a configuration
+  ///
+  /// Read the i-th configuration from the file into path, without mapping the file: the memory in
+  /// use does not grow with the number of configurations read.
+  /// \param i index of the configuration
+  /// \param path destination: its dimensions must match the settings
+  void Load(int i, Path& path) const;
+
+  /// Load some links of a configuration
+  ///
+  /// Read only the blocks of the i-th configuration which hold the links in the given directions
+  /// and time slices, leaving the other links of path as they are. With the EnsembleLayout::Sites
+  /// layout, the whole configuration is read; with EnsembleLayout::Directions, the time slices
+  /// are not selected.
+  /// \param i index of the configuration
+  /// \param path destination: its dimensions must match the settings
+  /// \param directions directions mu of the links to be read
+  /// \param slices time slices x_3 of the links to be read (empty = all)
+  void Load(int i,
+            Path& path,
+            const std::vector<int>& directions,
+            const std::vector<int>& slices = {}) const;
+
+  /// Digest of each configuration
+  ///
+  /// 64 bit checksum of the stored bytes of each configuration (all its blocks, as they are on
+  /// disk), computed in parallel without decoding them: it identifies the configuration content
+  /// for the MeasurementCache.
+  /// \return one digest per configuration in the file
+  std::vector<std::uint64_t> Digests() const;
+
+  /// \return true if the file holds a checkpoint of the chain \see EnsembleWriter::SetCheckpoint
+  bool HasCheckpoint() const;
+
+  /// Load the checkpoint
+  /// \param path destination: its dimensions must match the settings
+  void LoadCheckpoint(Path& path) const;
+};
+
+/// TextEnsembleReader class
+///
+/// Sequential reader of the text format written by TextEnsembleWriter: the settings are read at
+/// construction, then each call to TextEnsembleReader::Read parses the next configuration line,
+/// or TextEnsembleReader::ReadAll parses many lines in parallel. The numbers are parsed with
+/// std::from_chars, which gives the same values as the stream parsing.
+class TextEnsembleReader
+{
+ private:
+  std::string fFilename;       ///< Name of the input file
+  std::ifstream fFile;         ///< Input file
+  EnsembleSettings fSettings;  ///< Settings read from the file
+  int fCount;                  ///< Number of configurations read so far
+  std::string fLine;           ///< Buffer of the configuration line being parsed
+
+ public:
+  TextEnsembleReader() = delete;
+
+  /// Constructor
+  ///
+  /// Open the file and read the settings.
+  /// \param filename name of the input file
+  TextEnsembleReader(const std::string& filename);
+
+  /// Destructor
+  ~TextEnsembleReader();
+
+  /// \return settings read from the file
+  EnsembleSettings GetSettings() const;
+
+  /// \return number of configurations stored in the file, as written in the settings
+  int GetNConfigs() const;
+
+  /// Read the next configuration
+  /// \param path destination: its dimensions must match the settings
+  void Read(Path& path);
+
+  /// Read the next configurations into all the slots of an ensemble
+  ///
+  /// The rest of the file is mapped in memory and split into configuration lines, which are parsed
+  /// in parallel, each one into its own slot.
+  /// \param ensemble destination: the dimensions of the slots must match the settings, and the
+  /// file must hold at least as many configurations still to be read as there are slots
+  void ReadAll(Ensemble& ensemble);
+
+  /// Digest of each configuration line
+  ///
+  /// 64 bit checksum of the characters of each configuration line not read yet: it identifies
+  /// the configuration content for the MeasurementCache. The position of the reader is unchanged.
+  /// \return one digest per configuration still to be read
+  std::vector<std::uint64_t> Digests();
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "EnsembleFile.h"
+#include "EnsembleStore.h"
+
+namespace
+{
+const char kCatalogue[] = "catalogue.txt";  // list of the settings of the stored ensembles
+const char kExtension[] = ".ens";           // extension of the ensemble files
+
+// FNV-1a hash of a 64 bit value, taken byte by byte from the least significant one, so that the
+// hash does not depend on the byte order of the machine
+std::uint64_t Hash(std::uint64_t value, std::uint64_t hash)
+{
+  for (int k = 0; k < 8; k++) hash = (hash ^ ((value >> (8 * k)) & 0xff)) * 0x100000001b3ULL;
+  return hash;
+}
+
+// Name of the file of a key, relative to the directory of the store
+std::string KeyFilename(std::uint64_t key)
+{
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << key << kExtension;
+  return name.str();
+}
+}  // namespace
+
+/************************ Constructor ***************************/
+
+// Constructor: create the directory of the store if needed
+EnsembleStore::EnsembleStore(const std::string& directory) : fDirectory(directory)
+{
+  if (mkdir(fDirectory.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cout << "ERROR while creating the ensemble store " << fDirectory << ".\n";
+    throw 1;
+  }
+}
+
+/************************ Public Methods ***************************/
+
+// Hash the settings apart from Ncf; the doubles are hashed through their exact bit pattern
+std::uint64_t EnsembleStore::Key(const EnsembleSettings& settings)
+{
+  if (settings.ncells.size() != 4 || settings.integer_params.size() != 4 ||
+      settings.floating_params.size() != 5)
+    throw 1;
+  std::uint64_t key = 0xcbf29ce484222325ULL;
+  for (int n : settings.ncells) key = Hash((std::uint32_t)n, key);
+  for (int k = 0; k < 3; k++) key = Hash((std::uint32_t)settings.integer_params[k], key);
+  for (double value : settings.floating_params) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    key = Hash(bits, key);
+  }
+  return Hash(settings.improved, key);
+}
+
+std::string EnsembleStore::GetFilename(const EnsembleSettings& settings) const
+{
+  return fDirectory + "/" + KeyFilename(Key(settings));
+}
+
+// Read the header of the stored file, if any
+int EnsembleStore::GetNConfigs(const EnsembleSettings& settings) const
+{
+  const std::string filename = GetFilename(settings);
+  if (!std::ifstream(filename).good()) return 0;
+  EnsembleSettings stored;
+  try {
+    stored = EnsembleReader(filename).GetSettings();
+  } catch (...) {
+    std::cout << "WARNING: the stored ensemble " << filename
+              << " is incomplete, it will be generated again\n";
+    return 0;
+  }
+  if (!SameExperiment(stored, settings)) {
+    std::cout << "ERROR: the stored ensemble " << filename << " has different settings.\n";
+    throw 1;
+  }
+  return stored.integer_params[3];
+}
+
+// Return the file of the settings, which must hold some configurations
+std::string EnsembleStore::Find(const EnsembleSettings& settings) const
+{
+  if (GetNConfigs(settings) == 0) {
+    std::cout << "ERROR: the ensemble store " << fDirectory
+              << " does not hold an ensemble with the requested settings.\n";
+    throw 1;
+  }
+  return GetFilename(settings);
+}
+
+// Append the settings to the catalogue, unless they are listed already
+void EnsembleStore::Add(const EnsembleSettings& settings) const
+{
+  const std::string name = KeyFilename(Key(settings));
+  const std::string catalogue = fDirectory + "/" + kCatalogue;
+  std::ifstream input(catalogue);
+  std::string line;
+  while (std::getline(input, line))
+    if (line.compare(0, name.size(), name) == 0) return;
+  input.close();
+
+  std::ofstream output(catalogue, std::ios::app);
+  output << std::setprecision(15) << name << "  NCells";
+  for (int n : settings.ncells) output << " " << n;
+  output << "  NofSU3 " << settings.integer_params[0] << "  Ncorr " << settings.integer_params[1]
+         << "  inner " << settings.integer_params[2];
+  const char* names[5] = {"a", "beta", "beta_tilde", "u0", "epsilon"};
+  for (int k = 0; k < 5; k++) output << "  " << names[k] << " " << settings.floating_params[k];
+  output << "  improved " << settings.improved << "\n";
+  if (!output) {
+    std::cout << "ERROR while writing the catalogue of the ensemble store " << fDirectory << ".\n";
+    throw 1;
+  }
+}
@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////
+/// \file EnsembleStore.h
+/// \brief Header file for the definition of the class EnsembleStore
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class EnsembleStore. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef ENSEMBLESTORE_H
+#define ENSEMBLESTORE_H
+
+#include <cstdint>
+#include <string>
+#include "EnsembleFile.h"
+
+/// EnsembleStore class
+///
+/// Local store of binary ensemble files, addressed by the settings of the experiment instead of by
+/// a file name: the ensemble generated with some settings is the file named after the hash of
+/// those settings (all of them apart from the number of configurations Ncf, which grows when the
+/// ensemble is continued). QCD_EXP looks up its settings in the store before generating, and
+/// QCD_POST may ask for an ensemble by its settings. A text catalogue in the store directory lists
+/// the settings of every file, for the reader's convenience.
+class EnsembleStore
+{
+ private:
+  std::string fDirectory;  ///< Directory of the store
+
+ public:
+  EnsembleStore() = delete;
+
+  /// Constructor
+  ///
+  /// Open the store, creating its directory if it does not exist yet.
+  /// \param directory directory of the store
+  EnsembleStore(const std::string& directory);
+
+  /// Key of the settings
+  /// \param settings settings of the experiment: the number of configurations is ignored
+  /// \return 64 bit hash of the settings, the same on every platform
+  static std::uint64_t Key(const EnsembleSettings& settings);
+
+  /// \param settings settings of the experiment
+  /// \return name of the file of the ensemble with these settings, whether it exists or not
+  std::string GetFilename(const EnsembleSettings& settings) const;
+
+  /// Number of stored configurations
+  ///
+  /// An incomplete file (whose first writing was interrupted) holds no configuration, and a file
+  /// whose settings differ from the requested ones is rejected.
+  /// \param settings settings of the experiment
+  /// \return number of configurations of the ensemble with these settings (0 if there is none)
+  int GetNConfigs(const EnsembleSettings& settings) const;
+
+  /// Find an ensemble
+  /// \param settings settings of the experiment
+  /// \return name of the file of the ensemble with these settings; an error is raised if the
+  /// store does not hold any configuration with these settings
+  std::string Find(const EnsembleSettings& settings) const;
+
+  /// Add an ensemble
+  ///
+  /// List the settings of a new ensemble in the catalogue of the store, before its file is written.
+  /// \param settings settings of the experiment
+  void Add(const EnsembleSettings& settings) const;
+};
+
+#endif
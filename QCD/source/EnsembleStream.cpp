@@ -0,0 +1,106 @@
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Ensemble.h"
+#include "EnsembleFile.h"
+#include "Path.h"
+#include "EnsembleStream.h"
+
+/************************ Private Methods ***************************/
+
+// Load the configurations in order into the free slots, until the end of the file
+void EnsembleStream::Loop()
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  while (fNextToLoad < fNConfigs) {
+    fFreeCV.wait(lock, [this]() { return fLoaded < fRing.GetNSlots() || fClosing; });
+    if (fClosing) break;
+    const int slot = (fHead + fLoaded) % fRing.GetNSlots();
+    const int index = fNextToLoad;
+    lock.unlock();
+    bool failed = false;
+    try {  // the slot is free: the caller does not touch it
+      if (fBinary)
+        fBinary->Load(index, fRing[slot], fDirections);
+      else
+        fText->Read(fRing[slot]);
+    } catch (...) {
+      failed = true;
+    }
+    lock.lock();
+    if (failed) {
+      fFailed = true;
+      fLoadedCV.notify_all();
+      break;
+    }
+    fNextToLoad++;
+    fLoaded++;
+    fLoadedCV.notify_all();
+  }
+}
+
+/************************ Public Methods ***************************/
+
+// Constructor: the format is recognized from the magic string of the binary files
+EnsembleStream::EnsembleStream(const std::string& filename, int depth, std::vector<int> directions)
+    : fDirections(directions), fHead(0), fLoaded(0), fNextToLoad(0), fClosing(false), fFailed(false)
+{
+  if (depth < 1) throw 1;
+  if (EnsembleReader::IsEnsembleFile(filename)) {
+    fBinary = std::make_unique<EnsembleReader>(filename);
+    fSettings = fBinary->GetSettings();
+    fNConfigs = fBinary->GetNConfigs();
+  } else {
+    fText = std::make_unique<TextEnsembleReader>(filename);
+    fSettings = fText->GetSettings();
+    fNConfigs = fText->GetNConfigs();
+  }
+  fRing = Ensemble(fSettings.ncells, depth);
+  fThread = std::thread(&EnsembleStream::Loop, this);
+}
+
+// Destructor
+EnsembleStream::~EnsembleStream()
+{
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fClosing = true;
+  }
+  fFreeCV.notify_all();
+  if (fThread.joinable()) fThread.join();
+}
+
+// Getters
+EnsembleSettings EnsembleStream::GetSettings() const
+{
+  return fSettings;
+}
+int EnsembleStream::GetNConfigs() const
+{
+  return fNConfigs;
+}
+
+// Return the oldest loaded slot and give it back to the reading thread
+bool EnsembleStream::Next(Path& path)
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  fLoadedCV.wait(lock, [this]() { return fLoaded > 0 || fFailed || fNextToLoad == fNConfigs; });
+  if (fLoaded == 0) {
+    if (fFailed) {
+      std::cout << "ERROR while reading the lattice configurations from file.\n";
+      throw 1;
+    }
+    return false;  // end of the file
+  }
+  const int slot = fHead;
+  lock.unlock();
+  path = fRing[slot];
+  lock.lock();
+  fHead = (fHead + 1) % fRing.GetNSlots();
+  fLoaded--;
+  fFreeCV.notify_all();
+  return true;
+}
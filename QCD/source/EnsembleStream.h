@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////
+/// \file EnsembleStream.h
+/// \brief Header file for the definition of the class EnsembleStream
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class EnsembleStream. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef ENSEMBLESTREAM_H
+#define ENSEMBLESTREAM_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Ensemble.h"
+#include "EnsembleFile.h"
+#include "Path.h"
+
+/// EnsembleStream class
+///
+/// Sequential reader of an ensemble file, either binary or text, which reads ahead in its own
+/// thread: while the caller works on a configuration, the following ones are loaded into a small
+/// ring of preallocated slots. The memory in use is bounded by the number of slots, whatever the
+/// number of configurations in the file.
+class EnsembleStream
+{
+ private:
+  std::unique_ptr<EnsembleReader> fBinary;    ///< Reader of the binary format
+  std::unique_ptr<TextEnsembleReader> fText;  ///< Reader of the text format
+  std::vector<int> fDirections;               ///< Directions of the links to be read
+  EnsembleSettings fSettings;                 ///< Settings of the ensemble
+  int fNConfigs;                              ///< Number of configurations in the file
+  Ensemble fRing;                             ///< Ring of slots holding the loaded configurations
+  int fHead;                                  ///< Slot of the next configuration to be returned
+  int fLoaded;                                ///< Number of loaded slots not yet returned
+  int fNextToLoad;                            ///< Index of the next configuration to be loaded
+  bool fClosing;                              ///< True when the reading thread must stop
+  bool fFailed;                               ///< True if the reading thread met an error
+  std::mutex fMutex;                          ///< Protects the state of the ring
+  std::condition_variable fLoadedCV;          ///< Signals loaded slots to the caller
+  std::condition_variable fFreeCV;            ///< Signals free slots to the reading thread
+  std::thread fThread;                        ///< Reading thread
+
+  /// Body of the reading thread
+  void Loop();
+
+ public:
+  EnsembleStream() = delete;
+  EnsembleStream(const EnsembleStream&) = delete;
+  EnsembleStream& operator=(const EnsembleStream&) = delete;
+
+  /// Constructor
+  ///
+  /// Open the file, read the settings and start reading ahead.
+  /// \param filename name of the input file, in the binary or in the text format
+  /// \param depth number of slots in the ring
+  /// \param directions directions of the links to be read: with a binary file in a layout split by
+  /// direction, only the blocks of these directions are read, and the other links are left as the
+  /// identity \see EnsembleReader::Load
+  EnsembleStream(const std::string& filename,
+                 int depth = 2,
+                 std::vector<int> directions = {0, 1, 2, 3});
+
+  /// Destructor: the reading thread is stopped
+  ~EnsembleStream();
+
+  /// \return settings of the ensemble
+  EnsembleSettings GetSettings() const;
+
+  /// \return number of configurations in the file
+  int GetNConfigs() const;
+
+  /// Next
+  ///
+  /// Copy the next configuration into path, waiting for it to be loaded if needed.
+  /// \param path destination: its dimensions must match the settings
+  /// \return false if all the configurations have already been returned
+  bool Next(Path& path);
+};
+
+#endif
@@ -0,0 +1,477 @@
+////////////////////////////////////////////////////////////////////////
+/// \file LatticeField.h
+/// \brief Header file for the field expressions on the lattice
+///
+/// Header file containing the definitions of the expression templates
+/// used to write functions of the link variables at the level of whole
+/// fields. Being templates, they are entirely defined in this file.
+////////////////////////////////////////////////////////////////////////
+#ifndef LATTICEFIELD_H
+#define LATTICEFIELD_H
+
+#include <armadillo>
+#include <complex>
+#include <cstddef>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+#include "my4Vector.h"
+#include "Path.h"
+using namespace arma;
+
+/// Field expressions on the lattice
+///
+/// A field expression is a function of the lattice site built from the link variables of one or
+/// more configurations, e.g. the plaquette in the plane mu-nu
+///
+///     LatticeField::Links U(path);
+///     trace(U[mu] * shift(U[nu], mu) * adj(shift(U[mu], nu)) * adj(U[nu]))
+///
+/// The operators and functions do not compute anything: they only record the expression in its
+/// type, and the expression is evaluated site by site when it is summed over the lattice or
+/// assigned to the links of a configuration (\see Metropolis::SumField, Metropolis::AssignField).
+/// The whole expression is thus evaluated in a single loop over the sites, shared among the
+/// threads of the analyses, and the only temporaries are the 3x3 matrices of each site: no field
+/// is ever stored for an intermediate result. A shift only moves the site at which its operand is
+/// evaluated, so it costs a few integer operations and no copy of the links.
+/// The values of the expressions are 3x3 complex matrices (cx_dmat), complex numbers or real
+/// numbers: matrices and numbers may be multiplied, while sums and differences require operands
+/// of the same kind.
+namespace LatticeField
+{
+/// Lattice site at which an expression is evaluated
+struct Site {
+  int x[4];  ///< Coordinates of the site
+  int n[4];  ///< Lattice dimensions in the 4 directions
+
+  /// Constructor
+  ///
+  /// \param i0 coordinate x_0 \param i1 coordinate x_1 \param i2 coordinate x_2 \param i3
+  /// coordinate x_3 \param ncells vector containing the lattice dimensions in the 4 dimensions
+  Site(int i0, int i1, int i2, int i3, const std::vector<int>& ncells)
+      : x{i0, i1, i2, i3}, n{ncells[0], ncells[1], ncells[2], ncells[3]}
+  {
+  }
+
+  /// Constructor
+  ///
+  /// \param position position 4-vector of the site
+  Site(const my4Vector& position)
+      : Site(position[0], position[1], position[2], position[3], position.GetNCells())
+  {
+  }
+
+  /// \param mu direction \param steps number of steps, negative for steps backward
+  /// \return site steps * mu away from this one, with periodic boundary conditions
+  Site Shifted(int mu, int steps) const
+  {
+    Site site = *this;
+    site.x[mu] = ((x[mu] + steps) % n[mu] + n[mu]) % n[mu];
+    return site;
+  }
+
+  /// \return index of the site in the lexicographic order of Path
+  std::size_t Index() const
+  {
+    return ((std::size_t)(x[0] * n[1] + x[1]) * n[2] + x[2]) * n[3] + x[3];
+  }
+};
+
+/// Base of the field expressions
+///
+/// Every expression E derives from Field<E>, defines the type Value of its values and evaluates
+/// itself at a site with Value operator()(const Site&) const.
+template <class E>
+struct Field {
+  /// \return the expression itself
+  const E& Self() const { return static_cast<const E&>(*this); }
+};
+
+/// Type of the values of a product of values of types A and B
+template <class A, class B>
+using ProductValue = typename std::conditional<
+    std::is_same<A, cx_dmat>::value || std::is_same<B, cx_dmat>::value,
+    cx_dmat,
+    typename std::conditional<std::is_same<A, double>::value && std::is_same<B, double>::value,
+                              double,
+                              std::complex<double>>::type>::type;
+
+/// Link variables U(x, mu) of a configuration in a given direction
+class LinkField : public Field<LinkField>
+{
+ private:
+  const std::complex<double>* fData;  ///< Storage of the configuration
+  std::vector<int> fNCells;           ///< Lattice dimensions of the configuration
+  int fMu;                            ///< Direction of the links
+
+ public:
+  typedef cx_dmat Value;
+
+  /// Constructor
+  ///
+  /// \param U path configuration, which must outlive the expression \param mu direction
+  LinkField(const Path& U, int mu) : fData(U.GetData()), fNCells(U.GetNCells()), fMu(mu)
+  {
+    if (mu < 0 || mu >= 4) throw 1;
+  }
+
+  /// \return 3x3 matrix of the link at the site, which aliases the memory of the configuration
+  const cx_dmat operator()(const Site& site) const
+  {
+    return cx_dmat(const_cast<std::complex<double>*>(fData) + (site.Index() * 4 + fMu) * 9, 3, 3,
+                   false, true);
+  }
+
+  /// Check the expression before a loop over the lattice
+  ///
+  /// An error is raised if the configuration does not have the lattice dimensions of the loop or
+  /// if it is the one written by the loop: the links of the other sites would then be read while
+  /// they are being overwritten.
+  /// \param ncells lattice dimensions of the loop \param written storage written by the loop
+  /// (nullptr if none)
+  void Check(const std::vector<int>& ncells, const std::complex<double>* written) const
+  {
+    if (ncells != fNCells) {
+      std::cout << "ERROR: the field expression and the lattice have different dimensions.\n";
+      throw 1;
+    }
+    if (written == fData) {
+      std::cout << "ERROR: a field expression cannot be assigned to the links it reads.\n";
+      throw 1;
+    }
+  }
+};
+
+/// Links of a configuration, as fields: U[mu] is the field of the links U(x, mu)
+class Links
+{
+ private:
+  const Path& fPath;  ///< Path configuration
+
+ public:
+  /// Constructor
+  ///
+  /// \param U path configuration, which must outlive the expressions built on it
+  Links(const Path& U) : fPath(U) {}
+
+  /// \param mu direction \return field of the links in the direction mu
+  LinkField operator[](int mu) const { return LinkField(fPath, mu); }
+};
+
+/// Constant value
+template <class T>
+class Constant : public Field<Constant<T>>
+{
+ private:
+  T fValue;  ///< Value at every site
+
+ public:
+  typedef T Value;
+
+  /// Constructor \param value value at every site
+  Constant(T value) : fValue(value) {}
+
+  /// \return the value
+  T operator()(const Site&) const { return fValue; }
+
+  /// Nothing to check \see LinkField::Check
+  void Check(const std::vector<int>&, const std::complex<double>*) const {}
+};
+
+/// Expression evaluated at a shifted site: its value at x is the value of the operand at
+/// x + steps * mu
+template <class E>
+class Shift : public Field<Shift<E>>
+{
+ private:
+  E fE;        ///< Operand
+  int fMu;     ///< Direction of the shift
+  int fSteps;  ///< Number of steps, negative for a shift backward
+
+ public:
+  typedef typename E::Value Value;
+
+  /// Constructor \param e operand \param mu direction \param steps number of steps
+  Shift(const E& e, int mu, int steps) : fE(e), fMu(mu), fSteps(steps)
+  {
+    if (mu < 0 || mu >= 4) throw 1;
+  }
+
+  /// \return value of the operand at the shifted site
+  Value operator()(const Site& site) const { return fE(site.Shifted(fMu, fSteps)); }
+
+  /// Check the operand \see LinkField::Check
+  void Check(const std::vector<int>& ncells, const std::complex<double>* written) const
+  {
+    fE.Check(ncells, written);
+  }
+};
+
+/// Hermitian conjugate (complex conjugate for the numbers) of an expression
+template <class E>
+class Adjoint : public Field<Adjoint<E>>
+{
+ private:
+  E fE;  ///< Operand
+
+  static cx_dmat Conjugate(const cx_dmat& value) { return value.t(); }
+  static std::complex<double> Conjugate(const std::complex<double>& value)
+  {
+    return std::conj(value);
+  }
+  static double Conjugate(double value) { return value; }
+
+ public:
+  typedef typename E::Value Value;
+
+  /// Constructor \param e operand
+  Adjoint(const E& e) : fE(e) {}
+
+  /// \return conjugate of the value of the operand
+  Value operator()(const Site& site) const { return Conjugate(fE(site)); }
+
+  /// Check the operand \see LinkField::Check
+  void Check(const std::vector<int>& ncells, const std::complex<double>* written) const
+  {
+    fE.Check(ncells, written);
+  }
+};
+
+/// Sum (sign = 1) or difference (sign = -1) of two expressions of the same kind
+template <class A, class B>
+class Sum : public Field<Sum<A, B>>
+{
+ private:
+  A fA;       ///< First operand
+  B fB;       ///< Second operand
+  int fSign;  ///< Sign of the second operand
+
+ public:
+  static_assert(std::is_same<typename A::Value, cx_dmat>::value ==
+                    std::is_same<typename B::Value, cx_dmat>::value,
+                "a field expression cannot add a matrix and a number");
+  typedef ProductValue<typename A::Value, typename B::Value> Value;
+
+  /// Constructor \param a first operand \param b second operand \param sign sign of b
+  Sum(const A& a, const B& b, int sign) : fA(a), fB(b), fSign(sign) {}
+
+  /// \return sum or difference of the values of the operands
+  Value operator()(const Site& site) const
+  {
+    if (fSign > 0) return fA(site) + fB(site);
+    return fA(site) - fB(site);
+  }
+
+  /// Check the operands \see LinkField::Check
+  void Check(const std::vector<int>& ncells, const std::complex<double>* written) const
+  {
+    fA.Check(ncells, written);
+    fB.Check(ncells, written);
+  }
+};
+
+/// Product of two expressions
+template <class A, class B>
+class Product : public Field<Product<A, B>>
+{
+ private:
+  A fA;  ///< First operand
+  B fB;  ///< Second operand
+
+ public:
+  typedef ProductValue<typename A::Value, typename B::Value> Value;
+
+  /// Constructor \param a first operand \param b second operand
+  Product(const A& a, const B& b) : fA(a), fB(b) {}
+
+  /// \return product of the values of the operands
+  Value operator()(const Site& site) const { return fA(site) * fB(site); }
+
+  /// \return first operand
+  const A& Left() const { return fA; }
+
+  /// \return second operand
+  const B& Right() const { return fB; }
+
+  /// Check the operands \see LinkField::Check
+  void Check(const std::vector<int>& ncells, const std::complex<double>* written) const
+  {
+    fA.Check(ncells, written);
+    fB.Check(ncells, written);
+  }
+};
+
+/// True if E is the product of two matrix expressions
+template <class E>
+struct IsMatrixProduct : std::false_type {
+};
+template <class A, class B>
+struct IsMatrixProduct<Product<A, B>>
+    : std::integral_constant<bool,
+                             std::is_same<typename A::Value, cx_dmat>::value &&
+                                 std::is_same<typename B::Value, cx_dmat>::value> {
+};
+
+/// Trace of a matrix expression
+template <class E>
+class Trace : public Field<Trace<E>>
+{
+ private:
+  E fE;  ///< Operand
+
+ public:
+  static_assert(std::is_same<typename E::Value, cx_dmat>::value,
+                "a field expression can only take the trace of a matrix");
+  typedef std::complex<double> Value;
+
+  /// Constructor \param e operand
+  Trace(const E& e) : fE(e) {}
+
+  /// \return trace of the value of the operand: for a product A B, tr(A B) = sum_ij A_ij B_ji is
+  /// computed without forming the last matrix product
+  Value operator()(const Site& site) const
+  {
+    if constexpr (IsMatrixProduct<E>::value) {
+      const cx_dmat A = fE.Left()(site);
+      const cx_dmat B = fE.Right()(site);
+      std::complex<double> trace = 0.;
+      for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) trace += A(i, j) * B(j, i);
+      }
+      return trace;
+    } else {
+      return arma::trace(fE(site));
+    }
+  }
+
+  /// Check the operand \see LinkField::Check
+  void Check(const std::vector<int>& ncells, const std::complex<double>* written) const
+  {
+    fE.Check(ncells, written);
+  }
+};
+
+/// Real (part = 0) or imaginary (part = 1) part of a complex expression
+template <class E>
+class Part : public Field<Part<E>>
+{
+ private:
+  E fE;       ///< Operand
+  int fPart;  ///< 0 for the real part, 1 for the imaginary part
+
+ public:
+  static_assert(std::is_same<typename E::Value, std::complex<double>>::value,
+                "a field expression can only take the real or imaginary part of a complex number");
+  typedef double Value;
+
+  /// Constructor \param e operand \param part 0 for the real part, 1 for the imaginary part
+  Part(const E& e, int part) : fE(e), fPart(part) {}
+
+  /// \return real or imaginary part of the value of the operand
+  Value operator()(const Site& site) const
+  {
+    const std::complex<double> value = fE(site);
+    return fPart == 0 ? value.real() : value.imag();
+  }
+
+  /// Check the operand \see LinkField::Check
+  void Check(const std::vector<int>& ncells, const std::complex<double>* written) const
+  {
+    fE.Check(ncells, written);
+  }
+};
+
+/// \param e expression \param mu direction \param steps number of steps, negative for steps
+/// backward \return expression whose value at x is the value of e at x + steps * mu
+template <class E>
+Shift<E> shift(const Field<E>& e, int mu, int steps = 1)
+{
+  return Shift<E>(e.Self(), mu, steps);
+}
+
+/// \param e expression \return hermitian conjugate of e
+template <class E>
+Adjoint<E> adj(const Field<E>& e)
+{
+  return Adjoint<E>(e.Self());
+}
+
+/// \param e matrix expression \return trace of e
+template <class E>
+Trace<E> trace(const Field<E>& e)
+{
+  return Trace<E>(e.Self());
+}
+
+/// \param e complex expression \return real part of e
+template <class E>
+Part<E> real(const Field<E>& e)
+{
+  return Part<E>(e.Self(), 0);
+}
+
+/// \param e complex expression \return imaginary part of e
+template <class E>
+Part<E> imag(const Field<E>& e)
+{
+  return Part<E>(e.Self(), 1);
+}
+
+/// \return sum of the expressions a and b
+template <class A, class B>
+Sum<A, B> operator+(const Field<A>& a, const Field<B>& b)
+{
+  return Sum<A, B>(a.Self(), b.Self(), 1);
+}
+
+/// \return difference of the expressions a and b
+template <class A, class B>
+Sum<A, B> operator-(const Field<A>& a, const Field<B>& b)
+{
+  return Sum<A, B>(a.Self(), b.Self(), -1);
+}
+
+/// \return product of the expressions a and b
+template <class A, class B>
+Product<A, B> operator*(const Field<A>& a, const Field<B>& b)
+{
+  return Product<A, B>(a.Self(), b.Self());
+}
+
+/// \return product of the number c and the expression e
+template <class E>
+Product<Constant<double>, E> operator*(double c, const Field<E>& e)
+{
+  return Product<Constant<double>, E>(Constant<double>(c), e.Self());
+}
+
+/// \return product of the expression e and the number c
+template <class E>
+Product<E, Constant<double>> operator*(const Field<E>& e, double c)
+{
+  return Product<E, Constant<double>>(e.Self(), Constant<double>(c));
+}
+
+/// \return product of the complex number c and the expression e
+template <class E>
+Product<Constant<std::complex<double>>, E> operator*(std::complex<double> c, const Field<E>& e)
+{
+  return Product<Constant<std::complex<double>>, E>(Constant<std::complex<double>>(c), e.Self());
+}
+
+/// \return product of the expression e and the complex number c
+template <class E>
+Product<E, Constant<std::complex<double>>> operator*(const Field<E>& e, std::complex<double> c)
+{
+  return Product<E, Constant<std::complex<double>>>(e.Self(), Constant<std::complex<double>>(c));
+}
+
+/// \return opposite of the expression e
+template <class E>
+Product<Constant<double>, E> operator-(const Field<E>& e)
+{
+  return Product<Constant<double>, E>(Constant<double>(-1.), e.Self());
+}
+}  // namespace LatticeField
+
+#endif
@@ -0,0 +1,364 @@
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "LatticeMemory.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+namespace
+{
+HugePages gPages = HugePages::None;  // Page size requested for the next allocations
+bool gPin = false;                   // Thread pinning switch
+bool gWarned = false;                // Warn only once about missing explicit huge pages
+
+const std::size_t k2MB = std::size_t(1) << 21;
+const std::size_t k1GB = std::size_t(1) << 30;
+
+std::size_t RoundUp(std::size_t value, std::size_t multiple)
+{
+  return ((value + multiple - 1) / multiple) * multiple;
+}
+
+const char* PagesName(HugePages pages)
+{
+  switch (pages) {
+    case HugePages::Transparent:
+      return "transparent huge pages";
+    case HugePages::Huge2MB:
+      return "2 MB huge pages";
+    case HugePages::Huge1GB:
+      return "1 GB huge pages";
+    default:
+      return "4 kB pages";
+  }
+}
+
+// Size in kB of the transparent huge pages backing the mapping which contains address
+std::size_t AnonHugePagesKB(const void* address)
+{
+  std::ifstream smaps("/proc/self/smaps");
+  std::string line;
+  bool inside = false;
+  std::uintptr_t target = (std::uintptr_t)address;
+  while (std::getline(smaps, line)) {
+    std::uintptr_t start = 0, end = 0;
+    char dash = 0;
+    std::istringstream range(line);
+    if ((range >> std::hex >> start >> dash >> end) && dash == '-') {
+      inside = (target >= start) && (target < end);
+    } else if (inside && line.compare(0, 14, "AnonHugePages:") == 0) {
+      std::istringstream value(line.substr(14));
+      std::size_t kb = 0;
+      value >> kb;
+      return kb;
+    }
+  }
+  return 0;
+}
+}  // namespace
+
+/************************ LinkBuffer ***************************/
+
+// Map a region large enough for size elements following the current page policy. The region is
+// not touched here: the first thread writing on a page decides its NUMA node.
+void LinkBuffer::Allocate(std::size_t size)
+{
+  fData = nullptr;
+  fOwner = true;
+  fSize = size;
+  fBytes = 0;
+  fMapping = nullptr;
+  fPages = HugePages::None;
+  fFile = false;
+  if (size == 0) return;
+  const std::size_t bytes = size * sizeof(std::complex<double>);
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+  // Buffers smaller than the requested page use the next smaller page size
+  HugePages pages = gPages;
+  if (pages == HugePages::Huge1GB && bytes < k1GB) pages = HugePages::Huge2MB;
+  if ((pages == HugePages::Huge2MB || pages == HugePages::Transparent) && bytes < k2MB)
+    pages = HugePages::None;
+
+#ifdef MAP_HUGETLB
+  if (pages == HugePages::Huge2MB || pages == HugePages::Huge1GB) {
+    const std::size_t page = (pages == HugePages::Huge1GB) ? k1GB : k2MB;
+    const int shift = (pages == HugePages::Huge1GB) ? 30 : 21;
+    void* mapping = mmap(nullptr, RoundUp(bytes, page), PROT_READ | PROT_WRITE,
+                         flags | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+    if (mapping != MAP_FAILED) {
+      fMapping = mapping;
+      fBytes = RoundUp(bytes, page);
+      fPages = pages;
+      fData = (std::complex<double>*)fMapping;
+      return;
+    }
+    if (!gWarned) {
+      std::cout << "WARNING: " << PagesName(pages)
+                << " not available, falling back to transparent huge pages.\n";
+      gWarned = true;
+    }
+  }
+#endif
+  if (pages != HugePages::None) pages = HugePages::Transparent;
+
+  if (pages == HugePages::Transparent) {
+    // Over-allocate and trim, so that the region is aligned to the 2 MB huge page boundary
+    const std::size_t length = RoundUp(bytes, k2MB);
+    void* mapping = mmap(nullptr, length + k2MB, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mapping == MAP_FAILED) {
+      std::cout << "ERROR while allocating the link variables.\n";
+      throw 1;
+    }
+    char* aligned = (char*)RoundUp((std::size_t)mapping, k2MB);
+    std::size_t head = aligned - (char*)mapping;
+    if (head > 0) munmap(mapping, head);
+    if (k2MB - head > 0) munmap(aligned + length, k2MB - head);
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+    fMapping = aligned;
+    fBytes = length;
+    fPages = HugePages::Transparent;
+  } else {
+    const std::size_t length = RoundUp(bytes, (std::size_t)sysconf(_SC_PAGESIZE));
+    void* mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mapping == MAP_FAILED) {
+      std::cout << "ERROR while allocating the link variables.\n";
+      throw 1;
+    }
+    fMapping = mapping;
+    fBytes = length;
+  }
+  fData = (std::complex<double>*)fMapping;
+}
+
+// Unmap the region
+void LinkBuffer::Release()
+{
+  if (fOwner && fMapping != nullptr) munmap(fMapping, fBytes);
+  fData = nullptr;
+  fMapping = nullptr;
+  fSize = 0;
+  fBytes = 0;
+}
+
+// Constructors
+LinkBuffer::LinkBuffer()
+    : fData(nullptr)
+    , fOwner(true)
+    , fSize(0)
+    , fBytes(0)
+    , fMapping(nullptr)
+    , fPages(HugePages::None)
+    , fFile(false)
+{
+}
+LinkBuffer::LinkBuffer(std::complex<double>* data, std::size_t size)
+    : fData(data)
+    , fOwner(false)
+    , fSize(size)
+    , fBytes(0)
+    , fMapping(nullptr)
+    , fPages(HugePages::None)
+    , fFile(false)
+{
+}
+
+// File mapping: private and writable, so that the content may be modified in memory (e.g. by the
+// smearing) without touching the file
+LinkBuffer::LinkBuffer(const std::string& filename) : LinkBuffer()
+{
+  int file = open(filename.c_str(), O_RDONLY);
+  struct stat status;
+  if (file < 0 || fstat(file, &status) != 0) {
+    if (file >= 0) close(file);
+    std::cout << "ERROR while opening the input file.\n";
+    throw 1;
+  }
+  const std::size_t length = status.st_size;
+  if (length > 0) {
+    void* mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    if (mapping == MAP_FAILED) {
+      close(file);
+      std::cout << "ERROR while mapping the input file.\n";
+      throw 1;
+    }
+    fMapping = mapping;
+    fBytes = length;
+    fData = (std::complex<double>*)fMapping;
+    fSize = length / sizeof(std::complex<double>);
+    fFile = true;
+  }
+  close(file);
+}
+LinkBuffer::LinkBuffer(std::size_t size)
+{
+  Allocate(size);
+}
+LinkBuffer::LinkBuffer(const LinkBuffer& other)
+{
+  Allocate(other.fSize);
+  if (fSize > 0) std::memcpy(fData, other.fData, fSize * sizeof(std::complex<double>));
+}
+LinkBuffer::LinkBuffer(LinkBuffer&& other) noexcept
+    : fData(other.fData)
+    , fOwner(other.fOwner)
+    , fSize(other.fSize)
+    , fBytes(other.fBytes)
+    , fMapping(other.fMapping)
+    , fPages(other.fPages)
+    , fFile(other.fFile)
+{
+  other.fData = nullptr;
+  other.fMapping = nullptr;
+  other.fSize = 0;
+  other.fBytes = 0;
+}
+
+// Assignments: equal sizes reuse the pages, so that the NUMA placement is preserved
+LinkBuffer& LinkBuffer::operator=(const LinkBuffer& other)
+{
+  if (this == &other) return *this;
+  if (fSize != other.fSize) {
+    if (!fOwner) throw 1;
+    Release();
+    Allocate(other.fSize);
+  }
+  if (fSize > 0) std::memcpy(fData, other.fData, fSize * sizeof(std::complex<double>));
+  return *this;
+}
+LinkBuffer& LinkBuffer::operator=(LinkBuffer&& other) noexcept
+{
+  if (this == &other) return *this;
+  Release();
+  fData = other.fData;
+  fOwner = other.fOwner;
+  fSize = other.fSize;
+  fBytes = other.fBytes;
+  fMapping = other.fMapping;
+  fPages = other.fPages;
+  fFile = other.fFile;
+  other.fData = nullptr;
+  other.fMapping = nullptr;
+  other.fSize = 0;
+  other.fBytes = 0;
+  return *this;
+}
+
+// Destructor
+LinkBuffer::~LinkBuffer()
+{
+  Release();
+}
+
+// Getters
+std::complex<double>* LinkBuffer::GetData()
+{
+  return fData;
+}
+const std::complex<double>* LinkBuffer::GetData() const
+{
+  return fData;
+}
+std::size_t LinkBuffer::GetSize() const
+{
+  return fSize;
+}
+HugePages LinkBuffer::GetPages() const
+{
+  return fPages;
+}
+bool LinkBuffer::IsFileMapping() const
+{
+  return fFile;
+}
+
+/************************ Memory policy ***************************/
+
+void LatticeMemory::SetHugePages(HugePages pages)
+{
+  gPages = pages;
+}
+
+HugePages LatticeMemory::GetHugePages()
+{
+  return gPages;
+}
+
+void LatticeMemory::SetThreadPinning(bool pin)
+{
+  gPin = pin;
+}
+
+// Bind the calling thread to the index-th CPU among the ones available to the process
+void LatticeMemory::PinCurrentThread(int index)
+{
+  if (!gPin) return;
+  cpu_set_t available;
+  CPU_ZERO(&available);
+  if (sched_getaffinity(0, sizeof(available), &available) != 0) return;
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    if (CPU_ISSET(cpu, &available)) cpus.push_back(cpu);
+  if (cpus.empty()) return;
+  cpu_set_t selected;
+  CPU_ZERO(&selected);
+  CPU_SET(cpus[index % cpus.size()], &selected);
+  sched_setaffinity(0, sizeof(selected), &selected);
+}
+
+// Report on which NUMA nodes the pages of the buffer reside, sampling at most 4096 pages
+void LatticeMemory::PrintPlacement(const std::string& label, const LinkBuffer& buffer)
+{
+  std::cout << label << ": " << buffer.GetSize() * sizeof(std::complex<double>) / 1024.
+            << " kB, " << (buffer.IsFileMapping() ? "file mapping" : PagesName(buffer.GetPages()));
+  if (buffer.GetSize() == 0) {
+    std::cout << std::endl;
+    return;
+  }
+  const char* begin = (const char*)buffer.GetData();
+  const std::size_t bytes = buffer.GetSize() * sizeof(std::complex<double>);
+  if (buffer.GetPages() == HugePages::Transparent)
+    std::cout << " (" << AnonHugePagesKB(begin) << " kB actually backed by huge pages)";
+
+  const std::size_t page = sysconf(_SC_PAGESIZE);
+  const std::size_t stride = RoundUp(std::max(page, bytes / 4096), page);
+  std::vector<void*> pages;
+  for (std::size_t offset = 0; offset < bytes; offset += stride)
+    pages.push_back((void*)(((std::uintptr_t)(begin + offset)) & ~(page - 1)));
+  std::vector<int> status(pages.size(), 0);
+#ifdef SYS_move_pages
+  long result = syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0);
+#else
+  long result = -1;
+#endif
+  if (result != 0) {
+    std::cout << ", NUMA placement not available\n";
+    return;
+  }
+  std::map<int, int> nodes;
+  for (int node : status) nodes[node]++;
+  std::cout << ", sampled pages per NUMA node:";
+  for (const auto& node : nodes) {
+    if (node.first >= 0)
+      std::cout << "  node " << node.first << " -> " << node.second;
+    else
+      std::cout << "  not resident -> " << node.second;
+  }
+  std::cout << std::endl;
+}
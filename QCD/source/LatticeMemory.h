@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////
+/// \file LatticeMemory.h
+/// \brief Header file for the memory management of the link variables
+///
+/// Header file containing the definition of the class LinkBuffer, used by
+/// the class Path to store the link variables, and of the functions which
+/// set the memory policy (huge pages, thread pinning) and report where the
+/// memory actually landed. Further comments may be found in the
+/// implementation file.
+////////////////////////////////////////////////////////////////////////
+#ifndef LATTICEMEMORY_H
+#define LATTICEMEMORY_H
+
+#include <complex>
+#include <cstddef>
+#include <string>
+
+/// HugePages enum class
+///
+/// Enum class which collects the available page sizes for the buffers allocated by LinkBuffer.
+/// Explicit huge pages must be reserved by the system administrator (see
+/// /proc/sys/vm/nr_hugepages): when they are not available, LinkBuffer falls back to transparent
+/// huge pages. Buffers smaller than the requested page use the next smaller page size.
+enum class HugePages {
+  None,         ///< Standard 4 kB pages
+  Transparent,  ///< Transparent huge pages, requested with madvise
+  Huge2MB,      ///< Explicit 2 MB huge pages
+  Huge1GB       ///< Explicit 1 GB huge pages
+};
+
+/// LinkBuffer class
+///
+/// Contiguous buffer of complex numbers, obtained directly from the kernel with mmap according to
+/// the policy set with LatticeMemory::SetHugePages. The pages are not touched at allocation time,
+/// so that each page is placed on the NUMA node of the first thread writing on it (first-touch
+/// placement). Copies are deep copies. A LinkBuffer may also be a view on memory owned by someone
+/// else: copying into a view writes on that memory, while copying from a view gives an owning
+/// buffer. Finally, a LinkBuffer may map a whole file copy-on-write: the file is read lazily by
+/// the kernel, and modifications stay private to the process.
+class LinkBuffer
+{
+ private:
+  std::complex<double>* fData;  ///< Pointer to the first element
+  bool fOwner;                  ///< True if the memory is owned, false for a view
+  std::size_t fSize;            ///< Number of complex elements
+  std::size_t fBytes;           ///< Length of the mapped region in bytes
+  void* fMapping;               ///< Start of the mapped region
+  HugePages fPages;             ///< Page size actually granted by the kernel
+  bool fFile;                   ///< True if the region maps a file
+
+  /// Allocate
+  ///
+  /// Map a new region for size elements, without touching it.
+  /// \param size number of complex elements
+  void Allocate(std::size_t size);
+
+  /// Release the mapped region, if any
+  void Release();
+
+ public:
+  /// Default constructor: empty buffer
+  LinkBuffer();
+
+  /// Constructor
+  ///
+  /// \param size number of complex elements: the content is left uninitialised
+  LinkBuffer(std::size_t size);
+
+  /// View constructor
+  ///
+  /// \param data external memory, which must outlive the view
+  /// \param size number of complex elements
+  LinkBuffer(std::complex<double>* data, std::size_t size);
+
+  /// File mapping constructor
+  ///
+  /// Map the whole file copy-on-write: the buffer starts at the beginning of the file and
+  /// contains as many complex elements as fit in it.
+  /// \param filename name of the file to be mapped
+  LinkBuffer(const std::string& filename);
+
+  /// Copy and move constructors
+  LinkBuffer(const LinkBuffer& other);
+  LinkBuffer(LinkBuffer&& other) noexcept;
+
+  /// Copy and move assignments: a copy between buffers of equal size reuses the existing pages
+  /// (views cannot be resized)
+  LinkBuffer& operator=(const LinkBuffer& other);
+  LinkBuffer& operator=(LinkBuffer&& other) noexcept;
+
+  /// Destructor
+  ~LinkBuffer();
+
+  /// \return pointer to the first element
+  std::complex<double>* GetData();
+
+  /// \return pointer to the first element
+  const std::complex<double>* GetData() const;
+
+  /// \return number of complex elements
+  std::size_t GetSize() const;
+
+  /// \return page size actually granted for the buffer
+  HugePages GetPages() const;
+
+  /// \return true if the buffer maps a file
+  bool IsFileMapping() const;
+};
+
+/// Memory policy and placement report
+namespace LatticeMemory
+{
+/// Set the page size used for the following LinkBuffer allocations
+/// \param pages requested page size
+void SetHugePages(HugePages pages);
+
+/// \return the page size used for the LinkBuffer allocations
+HugePages GetHugePages();
+
+/// Enable or disable the thread pinning performed by LatticeMemory::PinCurrentThread
+/// \param pin true to pin the threads
+void SetThreadPinning(bool pin);
+
+/// Pin the calling thread
+///
+/// If the thread pinning is enabled, bind the calling thread to the CPU index modulo the number
+/// of available CPUs, so that the pages it touches first stay on its NUMA node.
+/// \param index index of the thread in its partition
+void PinCurrentThread(int index);
+
+/// Print placement
+///
+/// Print on standard output the number of pages of the buffer resident on each NUMA node and the
+/// page size granted by the kernel.
+/// \param label name of the buffer in the report
+/// \param buffer buffer whose placement is reported
+void PrintPlacement(const std::string& label, const LinkBuffer& buffer);
+}  // namespace LatticeMemory
+
+#endif
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <armadillo>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "my4Vector.h"
+#include "Path.h"
+#include "LoopShapes.h"
+using namespace arma;
+
+/************************ Constructor ***************************/
+
+// Constructor: walk each shape from the root of the tree, reusing the nodes of the steps already
+// taken by a previous shape
+LoopShapes::LoopShapes(const std::vector<std::string>& shapes) : fShapes(shapes), fNSteps(0)
+{
+  for (const std::string& shape : fShapes) {
+    std::vector<int> steps = Parse(shape);
+    std::vector<int> position(4, 0);
+    int node = -1;
+    for (int step : steps) {
+      const int mu = std::abs(step) - 1;
+      const bool backward = step < 0;
+      if (backward) position[mu]--;
+      int next = -1;
+      for (int k = node + 1; k < (int)fNodes.size() && next < 0; k++) {
+        if (fNodes[k].parent == node && fNodes[k].mu == mu && fNodes[k].backward == backward)
+          next = k;
+      }
+      if (next < 0) {
+        fNodes.push_back({node, mu, backward, position});
+        next = fNodes.size() - 1;
+      }
+      if (!backward) position[mu]++;
+      node = next;
+    }
+    if (position != std::vector<int>(4, 0)) {
+      std::cout << "ERROR: the loop shape " << shape << " is not a closed path.\n";
+      throw 1;
+    }
+    fEnds.push_back(node);
+    fNSteps += steps.size();
+  }
+}
+
+/************************ Public Methods ***************************/
+
+// Read the pairs of sign and direction, ignoring the blanks
+std::vector<int> LoopShapes::Parse(const std::string& shape)
+{
+  std::vector<int> steps;
+  for (std::size_t k = 0; k < shape.size(); k++) {
+    if (std::isspace((unsigned char)shape[k])) continue;
+    if ((shape[k] != '+' && shape[k] != '-') || k + 1 >= shape.size() || shape[k + 1] < '0' ||
+        shape[k + 1] > '3') {
+      std::cout << "ERROR: the loop shape " << shape
+                << " is not a sequence of steps +mu or -mu, with mu from 0 to 3.\n";
+      throw 1;
+    }
+    const int mu = shape[k + 1] - '0';
+    steps.push_back(shape[k] == '+' ? mu + 1 : -(mu + 1));
+    k++;
+  }
+  if (steps.empty()) {
+    std::cout << "ERROR: empty loop shape.\n";
+    throw 1;
+  }
+  return steps;
+}
+
+std::vector<std::string> LoopShapes::GetShapes() const
+{
+  return fShapes;
+}
+
+int LoopShapes::GetNProducts() const
+{
+  return fNodes.size();
+}
+
+int LoopShapes::GetNSteps() const
+{
+  return fNSteps;
+}
+
+std::vector<int> LoopShapes::GetDirections() const
+{
+  std::vector<int> directions;
+  for (const Node& node : fNodes) {
+    if (std::find(directions.begin(), directions.end(), node.mu) == directions.end())
+      directions.push_back(node.mu);
+  }
+  std::sort(directions.begin(), directions.end());
+  return directions;
+}
+
+// Multiply the links along the tree: the nodes are in an order where every parent comes first
+void LoopShapes::Evaluate(const Path& U, const my4Vector& x, std::vector<double>& values) const
+{
+  const std::vector<int> n = x.GetNCells();
+  std::vector<cx_dmat> products(fNodes.size());
+  std::vector<int> y(4);
+  for (std::size_t k = 0; k < fNodes.size(); k++) {
+    const Node& node = fNodes[k];
+    for (int c = 0; c < 4; c++) y[c] = ((x[c] + node.site[c]) % n[c] + n[c]) % n[c];
+    const cx_dmat link = node.backward ? cx_dmat(U(my4Vector(y, n), node.mu).t())
+                                       : U(my4Vector(y, n), node.mu);
+    products[k] = node.parent < 0 ? link : products[node.parent] * link;
+  }
+  for (std::size_t s = 0; s < fEnds.size(); s++)
+    values[s] += trace(products[fEnds[s]]).real() / 3.;
+}
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////
+/// \file LoopShapes.h
+/// \brief Header file for the definition of the class LoopShapes
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class LoopShapes. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef LOOPSHAPES_H
+#define LOOPSHAPES_H
+
+#include <string>
+#include <vector>
+#include "my4Vector.h"
+#include "Path.h"
+
+/// LoopShapes class
+///
+/// Set of closed paths of links (loop shapes) of any form, each one given as a direction string:
+/// a sequence of steps "+mu" (a link forward in the direction mu) or "-mu" (a link backward), with
+/// mu from 0 to 3. For example, "+0+1-0-1" is the plaquette in the plane 0-1, "+0+0+1-0-0-1" the
+/// 2x1 rectangle, "+0+1-0+2-1-2" a chair and "+0+1+2-0-1-2" a parallelogram.
+/// The shapes are compiled once into a tree of links: each node is a link, given by its
+/// displacement from the starting site, its direction and its orientation, and the shapes starting
+/// with the same steps share the nodes of those steps. At each site, the product of the links
+/// along the tree is computed once for every node, so that a common prefix of several shapes is
+/// multiplied only once.
+class LoopShapes
+{
+ private:
+  /// Node of the tree of links
+  struct Node {
+    int parent;             ///< Index of the parent node (-1 for a first link)
+    int mu;                 ///< Direction of the link
+    bool backward;          ///< True for a step backward, i.e. the link U(y, mu)^dagger
+    std::vector<int> site;  ///< Displacement from the starting site of the site y of the link
+  };
+
+  std::vector<std::string> fShapes;  ///< Direction strings of the shapes
+  std::vector<Node> fNodes;          ///< Tree of links: every parent precedes its children
+  std::vector<int> fEnds;            ///< Index of the last node of each shape
+  int fNSteps;                       ///< Total number of steps of the shapes
+
+ public:
+  LoopShapes() = delete;
+
+  /// Constructor
+  ///
+  /// Parse the shapes and compile them into the tree of links. An error is raised if a direction
+  /// string is not well formed or if it does not describe a closed path.
+  /// \param shapes direction strings of the shapes
+  LoopShapes(const std::vector<std::string>& shapes);
+
+  /// Parse
+  ///
+  /// \param shape direction string
+  /// \return steps of the shape, +(mu + 1) forward and -(mu + 1) backward in the direction mu; an
+  /// error is raised if the direction string is not well formed
+  static std::vector<int> Parse(const std::string& shape);
+
+  /// \return fShapes
+  std::vector<std::string> GetShapes() const;
+
+  /// \return number of matrix products per site for all the shapes, thanks to the shared prefixes
+  int GetNProducts() const;
+
+  /// \return number of matrix products per site if each shape were evaluated on its own
+  int GetNSteps() const;
+
+  /// \return sorted list of the link directions used by the shapes
+  std::vector<int> GetDirections() const;
+
+  /// Evaluate
+  ///
+  /// Add the value of each shape starting at the site x, i.e. the real part of the trace of the
+  /// product of its links divided by 3, to the corresponding element of values.
+  /// \param U path configuration
+  /// \param x starting site
+  /// \param values values of the shapes, in the order of the constructor
+  void Evaluate(const Path& U, const my4Vector& x, std::vector<double>& values) const;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "EnsembleFile.h"
+#include "MeasurementCache.h"
+
+namespace
+{
+const char kMagic[8] = {'L', 'Q', 'C', 'D', 'M', 'E', 'A', 'S'};
+const std::uint32_t kVersion = 1;
+const std::uint32_t kEndian = 0x01020304;  // read back as 0x04030201 on the opposite byte order
+
+// Header of the side-car: 16 bytes
+struct CacheHeader {
+  char magic[8];          // kMagic
+  std::uint32_t version;  // kVersion
+  std::uint32_t endian;   // kEndian
+};
+static_assert(sizeof(CacheHeader) == 16, "unexpected padding in the cache header");
+
+// Header of an entry, followed by nvalues doubles
+struct EntryHeader {
+  std::uint64_t digest;    // digest of the configuration, see EnsembleReader::Digests
+  std::uint64_t tag;       // tag of the measurement, see MeasurementCache::Tag
+  std::uint32_t nvalues;   // number of values
+  std::uint32_t checksum;  // CRC-32 of the fields above and of the values
+};
+static_assert(sizeof(EntryHeader) == 24, "unexpected padding in the cache entry header");
+
+// Checksum of an entry
+std::uint32_t EntryChecksum(const EntryHeader& header, const std::vector<double>& values)
+{
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, (const Bytef*)&header, offsetof(EntryHeader, checksum));
+  return crc32(crc, (const Bytef*)values.data(), values.size() * sizeof(double));
+}
+
+// FNV-1a hash of bytes, continuing a previous hash
+std::uint64_t Hash(const void* data, std::size_t bytes, std::uint64_t hash)
+{
+  const unsigned char* begin = (const unsigned char*)data;
+  for (std::size_t k = 0; k < bytes; k++) hash = (hash ^ begin[k]) * 0x100000001b3ULL;
+  return hash;
+}
+}  // namespace
+
+/************************ Constructor and destructor ***************************/
+
+// Constructor: compute the digests of the ensemble and read the valid entries of the side-car
+MeasurementCache::MeasurementCache(const std::string& ensemble_filename)
+    : fFilename(ensemble_filename + ".cache")
+{
+  if (EnsembleReader::IsEnsembleFile(ensemble_filename))
+    fDigests = EnsembleReader(ensemble_filename).Digests();
+  else
+    fDigests = TextEnsembleReader(ensemble_filename).Digests();
+
+  struct stat status;
+  const bool exists = stat(fFilename.c_str(), &status) == 0;
+  std::ifstream input(fFilename, std::ios::binary);
+  CacheHeader header;
+  std::streamoff valid = 0;  // end of the last valid entry
+  if (input.read((char*)&header, sizeof(header)) &&
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.version == kVersion &&
+      header.endian == kEndian) {
+    valid = sizeof(header);
+    EntryHeader entry;
+    std::vector<double> values;
+    while (input.read((char*)&entry, sizeof(entry)) &&
+           entry.nvalues <= (status.st_size - valid) / sizeof(double)) {
+      values.resize(entry.nvalues);
+      if (!input.read((char*)values.data(), values.size() * sizeof(double)) ||
+          EntryChecksum(entry, values) != entry.checksum)
+        break;
+      fEntries[{entry.digest, entry.tag}] = values;
+      valid = input.tellg();
+    }
+  }
+  input.close();
+
+  // Start a new side-car, or drop the bytes after the last valid entry
+  if (valid == 0) {
+    if (exists && status.st_size > 0)
+      std::cout << "WARNING: the measurement cache " << fFilename
+                << " is not readable, it will be rewritten\n";
+    std::ofstream output(fFilename, std::ios::binary | std::ios::trunc);
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.endian = kEndian;
+    output.write((const char*)&header, sizeof(header));
+    if (!output) {
+      std::cout << "ERROR while creating the measurement cache " << fFilename << ".\n";
+      throw 1;
+    }
+  } else if (valid < status.st_size) {
+    std::cout << "WARNING: incomplete entries at the end of the measurement cache " << fFilename
+              << " are discarded\n";
+    if (truncate(fFilename.c_str(), valid) != 0) {
+      std::cout << "ERROR while repairing the measurement cache " << fFilename << ".\n";
+      throw 1;
+    }
+  }
+  fFile.open(fFilename, std::ios::binary | std::ios::app);
+  if (!fFile) {
+    std::cout << "ERROR while opening the measurement cache " << fFilename << ".\n";
+    throw 1;
+  }
+}
+
+// Destructor
+MeasurementCache::~MeasurementCache()
+{
+  fFile.flush();
+}
+
+/************************ Public Methods ***************************/
+
+// Hash the observable name and the exact bytes of the smearing parameters
+std::uint64_t MeasurementCache::Tag(const std::string& observable,
+                                    const std::vector<std::pair<int, double>>& smearings)
+{
+  std::uint64_t tag = Hash(observable.data(), observable.size(), 0xcbf29ce484222325ULL);
+  for (const auto& smearing : smearings) {
+    const std::int32_t ntimes = smearing.first;
+    tag = Hash(&ntimes, sizeof(ntimes), tag);
+    tag = Hash(&smearing.second, sizeof(smearing.second), tag);
+  }
+  return tag;
+}
+
+std::string MeasurementCache::GetFilename() const
+{
+  return fFilename;
+}
+
+// Look up the entry of the i-th configuration
+bool MeasurementCache::Find(int i, std::uint64_t tag, std::vector<double>& values) const
+{
+  auto entry = fEntries.find({fDigests.at(i), tag});
+  if (entry == fEntries.end()) return false;
+  values = entry->second;
+  return true;
+}
+
+// Add an entry and append it to the side-car
+void MeasurementCache::Store(int i, std::uint64_t tag, const std::vector<double>& values)
+{
+  EntryHeader header;
+  header.digest = fDigests.at(i);
+  header.tag = tag;
+  header.nvalues = values.size();
+  header.checksum = EntryChecksum(header, values);
+  fFile.write((const char*)&header, sizeof(header));
+  fFile.write((const char*)values.data(), values.size() * sizeof(double));
+  if (!fFile) {
+    std::cout << "ERROR while writing the measurement cache " << fFilename << ".\n";
+    throw 1;
+  }
+  fEntries[{header.digest, tag}] = values;
+}
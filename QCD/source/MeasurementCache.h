@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////
+/// \file MeasurementCache.h
+/// \brief Header file for the definition of the class MeasurementCache
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class MeasurementCache. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef MEASUREMENTCACHE_H
+#define MEASUREMENTCACHE_H
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// MeasurementCache class
+///
+/// Persistent cache of the per-configuration measurements of an ensemble, stored in a binary
+/// side-car of the ensemble file (same name, with the extension ".cache"). Each entry holds the
+/// values measured on one configuration, and is keyed by the digest of the configuration content
+/// and by a tag of the observable and of the smearings applied before the measurement: a later
+/// analysis of the same configurations finds its values without reading the links again. Since
+/// the entries are addressed by content, they stay valid when new configurations are appended to
+/// the ensemble, and an ensemble file which is rewritten with other content simply misses them.
+///
+/// The side-car starts with a small header (magic string, version, byte order marker), followed
+/// by the entries, each one with its own checksum; the new entries are appended at the end. An
+/// entry interrupted while being written is discarded, together with any following byte.
+class MeasurementCache
+{
+ private:
+  std::string fFilename;                ///< Name of the side-car file
+  std::vector<std::uint64_t> fDigests;  ///< Digest of each configuration of the ensemble
+  std::map<std::pair<std::uint64_t, std::uint64_t>, std::vector<double>>
+      fEntries;         ///< Values of each entry, by {configuration digest, tag}
+  std::ofstream fFile;  ///< Side-car file, open for appending the new entries
+
+ public:
+  MeasurementCache() = delete;
+  MeasurementCache(const MeasurementCache&) = delete;
+  MeasurementCache& operator=(const MeasurementCache&) = delete;
+
+  /// Constructor
+  ///
+  /// Compute the digests of the configurations of the ensemble file and read the entries of its
+  /// side-car, which is created if it does not exist yet.
+  /// \param ensemble_filename name of the ensemble file, in the binary or in the text format
+  MeasurementCache(const std::string& ensemble_filename);
+
+  /// Destructor: the new entries are flushed to the side-car
+  ~MeasurementCache();
+
+  /// Tag of a measurement
+  ///
+  /// Identify a measurement by the name of the observable and by the smearings applied to the
+  /// configurations before it, with their exact parameters.
+  /// \param observable name of the observable, including any parameter which changes its values
+  /// \param smearings smearings {Ntimes, smearing_par} applied, in order
+  /// \return tag of the entries of the measurement
+  static std::uint64_t Tag(const std::string& observable,
+                           const std::vector<std::pair<int, double>>& smearings);
+
+  /// \return name of the side-car file
+  std::string GetFilename() const;
+
+  /// Find an entry
+  /// \param i index of the configuration in the ensemble
+  /// \param tag tag of the measurement \see Tag
+  /// \param values destination of the cached values
+  /// \return true if the entry exists, false if the measurement must be done
+  bool Find(int i, std::uint64_t tag, std::vector<double>& values) const;
+
+  /// Store an entry
+  ///
+  /// Add the values measured on a configuration, and append them to the side-car.
+  /// \param i index of the configuration in the ensemble
+  /// \param tag tag of the measurement \see Tag
+  /// \param values measured values
+  void Store(int i, std::uint64_t tag, const std::vector<double>& values);
+};
+
+#endif
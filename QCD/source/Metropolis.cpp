@@ -1,17 +1,68 @@
 #include <algorithm>
 #include <armadillo>
+#include <chrono>
 #include <complex>
+#include <cstddef>
+#include <cstdint>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <random>
 #include <string>
 #include <vector>
+#include "AxisTransformation.h"
+#include "BackgroundWriter.h"
+#include "Ensemble.h"
+#include "EnsembleFile.h"
+#include "EnsembleStream.h"
+#include "LatticeField.h"
+#include "LatticeMemory.h"
+#include "LoopShapes.h"
+#include "MeasurementCache.h"
 #include "my4Vector.h"
+#include "OffAxisLines.h"
 #include "Path.h"
+#include "PlaquetteField.h"
+#include "PolyakovLoops.h"
+#include "Statistics.h"
+#include "ThreadPool.h"
+#include "WilsonLines.h"
 #include "Metropolis.h"
 
+namespace
+{
+// Maximum sizes {R, T} of the RxT Wilson loops: (approximately) half the grid dimensions
+std::vector<int> RxTExtent(const std::vector<int>& n)
+{
+  return {(int)(std::min({n[0], n[1], n[2]}) / 2.), (int)(n[3] / 2.)};
+}
+
+// Maximum multiple R of an off-axis vector, such that no component of R e exceeds the maximum
+// size R of the RxT Wilson loops
+int OffAxisExtent(const std::vector<int>& n, const std::vector<int>& base)
+{
+  return RxTExtent(n)[0] / *std::max_element(base.begin(), base.end());
+}
+
+// Frames of a symmetrization: each time frame, once smeared, is transformed by each spatial frame
+std::vector<AxisTransformation> TimeFrames(const std::vector<int>& n, Symmetrization symmetrization)
+{
+  if (symmetrization == Symmetrization::None) return {AxisTransformation(n)};
+  return AxisTransformation::TimeAxes(n);
+}
+
+std::vector<AxisTransformation> SpatialFrames(const std::vector<int>& n,
+                                              Symmetrization symmetrization)
+{
+  if (symmetrization == Symmetrization::Hypercubic) return AxisTransformation::SpatialGroup(n);
+  return {AxisTransformation(n)};
+}
+}  // namespace
+
 using namespace arma;
 
 /************************ Private Methods ***************************/
@@ -86,6 +137,121 @@ void Metropolis::PrintStatus(int index, int n_max) const
   if (index == n_max - 1) std::cout << 100 << std::endl << std::flush;
 }
 
+// Copy the settings read from an ensemble file
+void Metropolis::ApplySettings(const EnsembleSettings& settings)
+{
+  fNofSU3 = settings.integer_params[0];
+  fNcorr = settings.integer_params[1];
+  fInnerCycles = settings.integer_params[2];
+  fNcf = settings.integer_params[3];
+  fA = settings.floating_params[0];
+  fBeta = settings.floating_params[1];
+  fBetaTilde = settings.floating_params[2];
+  fU0 = settings.floating_params[3];
+  fEpsilon = settings.floating_params[4];
+  fImproved = settings.improved;
+  fPath.Reshape(settings.ncells);
+  SetSweepTiles(settings.ncells);
+}
+
+// Smear the configuration U Ntimes, slab by slab
+void Metropolis::SmearConfiguration(Path& U, int Ntimes, double smearing_par) const
+{
+  std::vector<int> n = fPath.GetNCells();
+  for (int i_smear = 0; i_smear < Ntimes; i_smear++) {
+    Path gauge_der = GaugeDerivative(U);
+    ForEachSlab([&](int i0, int i1) {
+      for (int i2 = 0; i2 < n[2]; i2++) {
+        for (int i3 = 0; i3 < n[3]; i3++) {
+          for (int mu = 0; mu < 3; mu++) {
+            my4Vector x({i0, i1, i2, i3}, n);
+            U.Set(x, mu) = U(x, mu) + smearing_par * fA * fA * gauge_der(x, mu);
+          }
+        }
+      }
+    });
+  }
+}
+
+// Save the current path as the i-th sampled configuration
+void Metropolis::StoreConfiguration(int i, const Path& path)
+{
+  if (fOutput != nullptr)
+    fOutput->Push(path);
+  else
+    fResult.Snapshot(i, path);
+}
+
+// Measure the target loops on the configuration just sampled and test the stopping rule
+bool Metropolis::CheckStopping(int sampled, const Path& path)
+{
+  if (fTargetError > 0.) {
+    std::vector<int> n = path.GetNCells();
+    const double norm = n[0] * n[1] * n[2] * n[3] * 6.;
+    for (unsigned int k = 0; k < fTargetLoops.size(); k++) {
+      double loop = 0.;
+      for (int i0 = 0; i0 < n[0]; i0++) {
+        for (int i1 = 0; i1 < n[1]; i1++) {
+          for (int i2 = 0; i2 < n[2]; i2++) {
+            for (int i3 = 0; i3 < n[3]; i3++) {
+              my4Vector x({i0, i1, i2, i3}, n);
+              for (int mu = 0; mu < 4; mu++) {
+                for (int nu = 0; nu < mu; nu++)
+                  loop += WilsonLoop(fTargetLoops[k][0], fTargetLoops[k][1], mu, nu, x, path);
+              }
+            }
+          }
+        }
+      }
+      fTargetSeries[k].push_back(loop / norm);
+    }
+    if (sampled >= std::max(fMinNcf, 2)) {
+      bool reached = true;
+      for (const auto& series : fTargetSeries) {
+        Estimate estimate = Statistics::AutocorrelatedError(series);
+        if (estimate.error > fTargetError * std::abs(estimate.mean)) reached = false;
+      }
+      if (reached) {
+        fStopReason = "target relative error reached";
+        return true;
+      }
+    }
+  }
+  if (fMaxMinutes > 0.) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - fStartTime;
+    if (elapsed.count() / 60. >= fMaxMinutes) {
+      fStopReason = "time budget exhausted";
+      return true;
+    }
+  }
+  // Without a stopping rule, the generation always samples Ncf configurations: no reason is given
+  if (sampled == fNcf && (fTargetError > 0. || fMaxMinutes > 0.))
+    fStopReason = "configuration budget (Ncf) exhausted";
+  return false;
+}
+
+// Print the target loops measured during the generation
+void Metropolis::PrintTargetEstimates() const
+{
+  for (unsigned int k = 0; k < fTargetSeries.size(); k++) {
+    Estimate estimate = Statistics::AutocorrelatedError(fTargetSeries[k]);
+    std::cout << fTargetLoops[k][0] << "x" << fTargetLoops[k][1] << " Wilson loop =   "
+              << estimate.mean << "  +/-  " << estimate.error << "  (tau_int = " << estimate.tau_int
+              << ")\n";
+  }
+}
+
+// Experiment settings in the form of the binary ensemble files
+EnsembleSettings Metropolis::GetSettings() const
+{
+  EnsembleSettings settings;
+  settings.ncells = fPath.GetNCells();
+  settings.integer_params = {fNofSU3, fNcorr, fInnerCycles, fNcf};
+  settings.floating_params = {fA, fBeta, fBetaTilde, fU0, fEpsilon};
+  settings.improved = fImproved;
+  return settings;
+}
+
 // Auxiliary method to print the experiment settings as a header of an output file
 void Metropolis::PrintSettingsOnFile(std::ofstream& file) const
 {
@@ -102,6 +268,7 @@ void Metropolis::PrintSettingsOnFile(std::ofstream& file) const
   file << "Beta_tilde: " << fBetaTilde << std::endl;
   file << "u0 coefficient: " << fU0 << std::endl;
   file << "Improved? " << std::boolalpha << fImproved << std::noboolalpha << std::endl;
+  if (!fStopReason.empty()) file << "Generation stopped: " << fStopReason << std::endl;
   file << "####################################\n\n";
 }
 
@@ -123,56 +290,50 @@ Metropolis::Metropolis(std::vector<int> N,
     , fEpsilon(floating_params[4])
     , fImproved(isimproved)
     , fPath(N)
+    , fTargetError(0.)
+    , fMinNcf(0)
+    , fMaxMinutes(0.)
+    , fOutput(nullptr)
+    , fWarmupUpdates(-1)
+    , fSymmetrization(Symmetrization::None)
+    , fResampling(Resampling::None)
+    , fBinSize(1)
+    , fNResamples(1000)
+    , fResamplingSeed(1)
 {
   if ((integer_params.size() != 4) || (floating_params.size() != 5)) throw 1;
-  for (int i = 0; i < fNcf; i++) fResult.push_back(fPath);
   for (int i = 0; i < 2 * fNofSU3; i++) fSetOfSU3.push_back(cx_dmat(3, 3, fill::zeros));
+  SetSweepTiles(N);
 }
 
 // Constructor from an input file
-Metropolis::Metropolis(std::string infile) : fPath()
+Metropolis::Metropolis(std::string infile, bool streaming)
+    : fPath()
+    , fTargetError(0.)
+    , fMinNcf(0)
+    , fMaxMinutes(0.)
+    , fOutput(nullptr)
+    , fWarmupUpdates(-1)
+    , fInputFile(infile)
+    , fStreaming(streaming)
+    , fSymmetrization(Symmetrization::None)
+    , fResampling(Resampling::None)
+    , fBinSize(1)
+    , fNResamples(1000)
+    , fResamplingSeed(1)
 {
-  std::ifstream file_input(infile);
-  if (!file_input) {
-    cout << "ERROR while opening the input file.\n";
-    throw 1;
-  }
-  file_input >> fNofSU3 >> fNcorr >> fInnerCycles >> fNcf;
-  file_input >> fA >> fBeta >> fBetaTilde >> fU0 >> fEpsilon;
-  file_input >> fImproved;
-  std::vector<int> n = {0, 0, 0, 0};
-  file_input >> n[0] >> n[1] >> n[2] >> n[3];
-  fPath.Reshape(n);
-  for (int i = 0; i < fNcf; i++) fResult.push_back(fPath);
-  double real = 0., imag = 0.;
-  for (int index = 0; index < fNcf; index++) {
-    for (int i0 = 0; i0 < n[0]; i0++) {
-      for (int i1 = 0; i1 < n[1]; i1++) {
-        for (int i2 = 0; i2 < n[2]; i2++) {
-          for (int i3 = 0; i3 < n[3]; i3++) {
-            for (int mu = 0; mu < 4; mu++) {
-              for (int i = 0; i < 3; i++) {
-                for (int j = 0; j < 3; j++) {
-                  my4Vector x({i0, i1, i2, i3}, n);
-                  file_input >> real >> imag;
-                  if (file_input) {
-                    std::complex<double> matrix_element(real, imag);
-                    my4Vector x({i0, i1, i2, i3}, n);
-                    fResult[index].Set(x, mu)(i, j) = matrix_element;
-                  } else {
-                    std::cout << "ERROR while reading the lattice configurations from file.\n"
-                              << std::flush;
-                    throw 1;
-                  }
-                }
-              }
-            }
-          }
-        }
-      }
+  if (EnsembleReader::IsEnsembleFile(infile)) {  // binary format: map the configurations
+    EnsembleReader reader(infile);
+    ApplySettings(reader.GetSettings());
+    if (!fStreaming) fResult = reader.MapEnsemble();
+  } else {  // text format: parse the configurations
+    TextEnsembleReader reader(infile);
+    ApplySettings(reader.GetSettings());
+    if (!fStreaming) {
+      fResult = Ensemble(fPath.GetNCells(), fNcf);
+      reader.ReadAll(fResult);
     }
   }
-  file_input.close();
 }
 
 // Destructor
@@ -201,6 +362,10 @@ double Metropolis::GetBeta() const
 {
   return fBeta;
 }
+double Metropolis::GetBetaTilde() const
+{
+  return fBetaTilde;
+}
 double Metropolis::GetU0() const
 {
   return fU0;
@@ -213,14 +378,22 @@ Path Metropolis::GetCurrentPath() const
 {
   return fPath;
 }
-std::vector<Path> Metropolis::GetCurrentResult() const
+Ensemble Metropolis::GetCurrentResult() const
 {
-  return fResult;
+  Ensemble result = fResult;
+  for (int i = 0; i < result.GetNSlots(); i++)
+    for (const auto& smearing : fSmearings)
+      SmearConfiguration(result[i], smearing.first, smearing.second);
+  return result;
 }
 bool Metropolis::IsImproved() const
 {
   return fImproved;
 }
+std::string Metropolis::GetStopReason() const
+{
+  return fStopReason;
+}
 
 // Print current path on standard output
 void Metropolis::PrintPathOnScreen() const
@@ -259,23 +432,131 @@ void Metropolis::PrintPathOnFile(std::string filename) const
   std::cout << std::defaultfloat << std::setprecision(default_precision);
 }
 
+// Build the sweep order: tiles in lexicographic order, sites in lexicographic order inside each tile
+void Metropolis::SetSweepTiles(std::vector<int> tiles)
+{
+  std::vector<int> n = fPath.GetNCells();
+  if (tiles.size() != 4) throw 1;
+  for (int mu = 0; mu < 4; mu++) {
+    if (tiles[mu] <= 0) throw 1;
+    tiles[mu] = std::min(tiles[mu], n[mu]);
+  }
+  fSweepOrder.clear();
+  for (int b0 = 0; b0 < n[0]; b0 += tiles[0]) {
+    for (int b1 = 0; b1 < n[1]; b1 += tiles[1]) {
+      for (int b2 = 0; b2 < n[2]; b2 += tiles[2]) {
+        for (int b3 = 0; b3 < n[3]; b3 += tiles[3]) {
+          for (int i0 = b0; i0 < std::min(b0 + tiles[0], n[0]); i0++) {
+            for (int i1 = b1; i1 < std::min(b1 + tiles[1], n[1]); i1++) {
+              for (int i2 = b2; i2 < std::min(b2 + tiles[2], n[2]); i2++) {
+                for (int i3 = b3; i3 < std::min(b3 + tiles[3], n[3]); i3++) {
+                  fSweepOrder.push_back(my4Vector({i0, i1, i2, i3}, n));
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// Set the target relative error and the budgets which stop the generation
+void Metropolis::SetStoppingRule(double target_error,
+                                 std::vector<std::vector<int>> loops,
+                                 int min_configs,
+                                 double max_minutes)
+{
+  for (const auto& loop : loops) {
+    if ((loop.size() != 2) || (loop[0] <= 0) || (loop[1] <= 0)) {
+      std::cout << "ERROR: target loops must be given as {N_mu, N_nu} with positive sizes.\n";
+      throw 1;
+    }
+  }
+  if (target_error > 0. && loops.empty()) {
+    std::cout << "ERROR: a target error needs at least one target loop.\n";
+    throw 1;
+  }
+  fTargetError = target_error;
+  fTargetLoops = loops;
+  fMinNcf = min_configs;
+  fMaxMinutes = max_minutes;
+}
+
+// Stream the sampled configurations to output and release the slots of fResult
+void Metropolis::SetOutput(BackgroundWriter* output)
+{
+  fOutput = output;
+  if (fOutput != nullptr) fResult = Ensemble();
+}
+
+// The slots are allocated only by the run which fills them, so that a run streaming its
+// configurations never touches the memory of the whole ensemble
+void Metropolis::AllocateResult()
+{
+  if (fOutput == nullptr && fResult.GetNSlots() != fNcf)
+    fResult = Ensemble(fPath.GetNCells(), fNcf);
+}
+
+// Start from the checkpoint of the file, if any, otherwise from its last configuration, which
+// must first be decorrelated from the following one
+void Metropolis::Resume(std::string filename)
+{
+  EnsembleReader reader(filename);
+  if (!SameExperiment(reader.GetSettings(), GetSettings())) {
+    std::cout << "ERROR: the settings differ from those of the ensemble file to resume.\n";
+    throw 1;
+  }
+  if (reader.HasCheckpoint()) {
+    reader.LoadCheckpoint(fPath);
+    fWarmupUpdates = 0;
+    std::cout << "Resuming the chain from the checkpoint of " << filename << " ("
+              << reader.GetNConfigs() << " configurations)\n";
+  } else if (reader.GetNConfigs() > 0) {
+    reader.Load(reader.GetNConfigs() - 1, fPath);
+    fWarmupUpdates = fNcorr;
+    std::cout << "Resuming the chain from the last configuration of " << filename << " ("
+              << reader.GetNConfigs() << " configurations)\n";
+  }
+}
+
+// Re-allocate fPath and fResult from the calling thread: the copies are first touched here
+void Metropolis::PlaceMemory()
+{
+  fPath = Path(fPath);
+  fResult = Ensemble(fResult);
+}
+
+// Print the placement of fPath and of the ensemble buffers
+void Metropolis::PrintMemoryReport(const std::string& label) const
+{
+  LatticeMemory::PrintPlacement(label + " current path", fPath.GetBuffer());
+  if (fResult.GetNSlots() > 0)
+    LatticeMemory::PrintPlacement(label + " ensemble", fResult.GetBuffer());
+}
+
 // Clear result: bring the result vector to the default one
 void Metropolis::ClearResult()
 {
-  for (int i = 0; i < fNcf; i++) fResult[i] = Path(fPath.GetNCells());
+  for (int i = 0; i < fResult.GetNSlots(); i++) fResult[i].FillIdentity();
 }
 
 // Print settings and Montecarlo configurations on file:
-// by default, the print mode is silent, which is the required option for later postprocessing
-// (matrix elements are printed with maximum accuracy, no headers); as an option, 'V' may be
-// specified for a verbose print, which is more user readable, yet less accurate (it saves disk
-// space, though).
+// by default, the print mode is silent, which is a text format suitable for later postprocessing
+// (matrix elements are printed with maximum accuracy, no headers); 'B' selects the binary format,
+// with raw doubles and an index of the configurations, and 'C' its compressed version; as an
+// option, 'V' may be specified for a verbose print, which is more user readable, yet less accurate
+// (it saves disk space, though).
 void Metropolis::PrintAllOnFile(std::string filename, char mode) const
 {
   std::cout << "Printing the lattice configurations on file..\n" << std::flush;
-  std::vector<int> n = fPath.GetNCells();
-  std::ofstream file_result(filename);
-  if (mode == 'V') {  // Verbose option
+  if (mode == 'B' || mode == 'C') {  // Binary options
+    EnsembleWriter writer(filename, GetSettings(), mode == 'C');
+    writer.AppendAll(fResult, fNcf);
+    writer.Close();
+  } else if (mode == 'V') {  // Verbose option
+    std::vector<int> n = fPath.GetNCells();
+    std::ofstream file_result(filename);
     PrintSettingsOnFile(file_result);
     file_result << "Sampled configurations will follow:\n";
     file_result << "ith-configuration; (x, y, x, t, mu) grid position and mu index, (l,m) matrix "
@@ -301,45 +582,12 @@ void Metropolis::PrintAllOnFile(std::string filename, char mode) const
         }
       }
     }
+    file_result.close();
   } else {  // Default, silent option
-    typedef std::numeric_limits<double> dbl;
-    const auto default_precision = file_result.precision();
-    file_result << std::scientific << std::setprecision(dbl::digits10);
-
-    file_result << fNofSU3 << std::endl;
-    file_result << fNcorr << std::endl;
-    file_result << fInnerCycles << std::endl;
-    file_result << fNcf << std::endl;
-    file_result << fA << std::endl;
-    file_result << fBeta << std::endl;
-    file_result << fBetaTilde << std::endl;
-    file_result << fU0 << std::endl;
-    file_result << fEpsilon << std::endl;
-    file_result << fImproved << std::endl;
-    file_result << n[0] << "  " << n[1] << "  " << n[2] << "  " << n[3] << std::endl;
-    for (int index = 0; index < fNcf; index++) {
-      for (int i0 = 0; i0 < n[0]; i0++) {
-        for (int i1 = 0; i1 < n[1]; i1++) {
-          for (int i2 = 0; i2 < n[2]; i2++) {
-            for (int i3 = 0; i3 < n[3]; i3++) {
-              for (int mu = 0; mu < 4; mu++) {
-                for (int i = 0; i < 3; i++) {
-                  for (int j = 0; j < 3; j++) {
-                    my4Vector x({i0, i1, i2, i3}, n);
-                    file_result << fResult[index](x, mu)(i, j).real() << " "
-                                << fResult[index](x, mu)(i, j).imag() << " ";
-                  }
-                }
-              }
-            }
-          }
-        }
-      }
-      file_result << std::endl;
-    }
-    file_result << std::defaultfloat << std::setprecision(default_precision);
+    TextEnsembleWriter writer(filename, GetSettings());
+    writer.AppendAll(fResult, fNcf);
+    writer.Close();
   }
-  file_result.close();
 }
 
 // Randomize to get the set of random SU3 matrices
@@ -368,39 +616,43 @@ void Metropolis::RandomizeSU3()
   }
 }
 
-// Compute plaquette and rectangle expectation values
-void Metropolis::ComputePlaquetteRectangle() const
+// Measure the sums of the plaquettes and of the rectangles. The plaquettes are read from the
+// plaquette field, and the rectangles are assembled from the lines of length 1 and 2: with
+// A = L_mu(x, 2) L_nu(x + 2 mu, 1) and B = L_nu(x, 1) L_mu(x + nu, 2), the 2 x 1 loop in the
+// (mu, nu) plane is Re tr(A B^dagger) / 3
+Measurement Metropolis::PlaquetteRectangleMeasurement() const
 {
-  std::cout << "Computing 1x1 and 2x1 plaquettes expectation values..\nProgress %: " << std::flush;
+  return {"plaquette_rectangle", 2, {2, 2, 2, 2}, true,
+          [this](int, const Path&, const WilsonLines& lines, const PlaquetteField& plaquettes,
+                 std::vector<double>& sum) {
+            SumOverSites(
+                [&](const my4Vector& x, std::vector<double>& value) {
+                  for (int mu = 0; mu < 4; mu++) {
+                    for (int nu = 0; nu < mu; nu++) {
+                      value[0] += plaquettes.RealTrace(x, mu, nu) / 3.;
+                      const cx_dmat A = lines(x, mu, 2) * lines(x.Offset(2, mu), nu, 1);
+                      const cx_dmat B = lines(x, nu, 1) * lines(x.Offset(1, nu), mu, 2);
+                      value[1] += WilsonLines::RealTrace(A, B) / 3.;
+                    }
+                  }
+                },
+                sum);
+          },
+          {0, 1, 2, 3}};
+}
 
+// Print plaquette and rectangle expectation values
+void Metropolis::PrintPlaquetteRectangle(const std::vector<std::vector<double>>& sums) const
+{
   std::vector<int> n = fPath.GetNCells();
   std::vector<double> estimators = {0., 0.};  // First= axa plaquette; Second=ax2a rectangle
   std::vector<double> errors = {0., 0.};      // Same as above
   std::vector<double> square_estimators = {0., 0.};
-  std::vector<double> old_estimators = {0., 0.};
-  for (int i = 0; i < fNcf; i++) {
-    PrintStatus(i, fNcf);
-    old_estimators[0] = estimators[0];
-    old_estimators[1] = estimators[1];
-    for (int i0 = 0; i0 < n[0]; i0++) {
-      for (int i1 = 0; i1 < n[1]; i1++) {
-        for (int i2 = 0; i2 < n[2]; i2++) {
-          for (int i3 = 0; i3 < n[3]; i3++) {
-            for (int mu = 0; mu < 4; mu++) {
-              for (int nu = 0; nu < mu; nu++) {
-                my4Vector x({i0, i1, i2, i3}, n);
-                estimators[0] += WilsonLoop(1, 1, mu, nu, x, i);
-                estimators[1] += WilsonLoop(2, 1, mu, nu, x, i);
-              }
-            }
-          }
-        }
-      }
+  for (const std::vector<double>& sum : sums) {
+    for (int k = 0; k < 2; k++) {
+      estimators[k] += sum[k];
+      square_estimators[k] += std::pow(sum[k] / (double)(n[0] * n[1] * n[2] * n[3] * 6.), 2.0);
     }
-    square_estimators[0] += std::pow(
-        (estimators[0] - old_estimators[0]) / (double)(n[0] * n[1] * n[2] * n[3] * 6.), 2.0);
-    square_estimators[1] += std::pow(
-        (estimators[1] - old_estimators[1]) / (double)(n[0] * n[1] * n[2] * n[3] * 6.), 2.0);
   }
   std::cout << "End of statistics computation\n";
   estimators[0] /= (double)(n[0] * n[1] * n[2] * n[3] * 6. * fNcf);
@@ -411,55 +663,105 @@ void Metropolis::ComputePlaquetteRectangle() const
 
   errors[0] = std::sqrt((square_estimators[0] - pow(estimators[0], 2.0)) / fNcf);
   errors[1] = std::sqrt((square_estimators[1] - pow(estimators[1], 2.0)) / fNcf);
+  if (fResampling != Resampling::None) {
+    const double norm = n[0] * n[1] * n[2] * n[3] * 6.;
+    const std::vector<Estimate> resampled = Resample(sums, [norm](const std::vector<double>& mean) {
+      return std::vector<double>({mean[0] / norm, mean[1] / norm});
+    });
+    errors = {resampled[0].error, resampled[1].error};
+  }
 
   std::cout << "Results:\nsquare plaquette =   " << estimators[0] << "  +/-  " << errors[0]
             << std::endl;
   std::cout << "rectangular plaquette =   " << estimators[1] << "  +/-  " << errors[1] << std::endl;
 }
 
-// Compute RxT Wilson Loops
-void Metropolis::ComputeRxTWilsonLoops() const
+// Measure the sums of the RxT Wilson loops, in the order (T - 1) * nR + R - 1. Each loop costs two
+// products of the lines L_d(x, n): W(R,T) is Re tr(A B^dagger) / 3, with A = L_s(x, R)
+// L_t(x + R s, T) and B = L_t(x, T) L_s(x + T t, R), and the loops T x R in the (t, s) plane and
+// R x T in the (s, t) plane, which are complex conjugate, have the same value
+Measurement Metropolis::RxTWilsonLoopsMeasurement() const
+{
+  const std::vector<int> extent = RxTExtent(fPath.GetNCells());
+  const int nR = extent[0];
+  const int nT = extent[1];
+  return {"rxt_wilson_loops_" + std::to_string(nR) + "x" + std::to_string(nT), nR * nT,
+          {nR, nR, nR, nT}, false,
+          [this, nR, nT](int, const Path&, const WilsonLines& lines, const PlaquetteField&,
+                         std::vector<double>& sum) {
+            SumOverSites(
+                [&](const my4Vector& x, std::vector<double>& value) {
+                  for (int space_dir = 0; space_dir < 3; space_dir++) {
+                    for (int R = 1; R <= nR; R++) {
+                      const my4Vector xR = x.Offset(R, space_dir);
+                      for (int T = 1; T <= nT; T++) {
+                        const cx_dmat A = lines(x, space_dir, R) * lines(xR, 3, T);
+                        const cx_dmat B = lines(x, 3, T) * lines(x.Offset(T, 3), space_dir, R);
+                        value[(T - 1) * nR + R - 1] += (2. / 3.) * WilsonLines::RealTrace(A, B);
+                      }
+                    }
+                  }
+                },
+                sum);
+          },
+          {0, 1, 2, 3}};
+}
+
+// Print the RxT Wilson loops and the potential estimates: with a resampling, the errors of the
+// loops and of their ratios come from the same resamples, so the correlations among the loops are
+// taken into account
+void Metropolis::PrintRxTWilsonLoops(const std::vector<std::vector<double>>& sums) const
 {
-  std::cout << "Computing RxT Wilson loops..\nProgress %: " << std::flush;
   std::vector<int> n = fPath.GetNCells();
-  // Define the max loop dimensions in the R and T directions as (approximately) half the grid dimensions
-  const int nR = (int)(std::min({n[0], n[1], n[2]}) / 2.);
-  const int nT = (int)(n[3] / 2.);
+  const std::vector<int> extent = RxTExtent(n);
+  const int nR = extent[0];
+  const int nT = extent[1];
+  const double norm = n[0] * n[1] * n[2] * n[3] * 6.;
   // Define the matrices containing the results for the RxT loop dimension
-  std::vector<std::vector<double>> estimators, errors, square_estimators, old_estimators;
+  std::vector<std::vector<double>> estimators, errors, square_estimators;
   std::vector<double> inner;
   for (int R = 0; R <= nR; R++) inner.push_back(0.);
   for (int T = 0; T <= nT; T++) estimators.push_back(inner);
   errors = estimators;
   square_estimators = estimators;
-  old_estimators = estimators;
 
-  // Loop over the configurations and the lattice to get the Montecarlo estimators for the loops
-  for (int i = 0; i < fNcf; i++) {
-    PrintStatus(i, fNcf);
-    old_estimators = estimators;
-    for (int i0 = 0; i0 < n[0]; i0++) {
-      for (int i1 = 0; i1 < n[1]; i1++) {
-        for (int i2 = 0; i2 < n[2]; i2++) {
-          for (int i3 = 0; i3 < n[3]; i3++) {
-            my4Vector x({i0, i1, i2, i3}, n);
-            for (int T = 1; T <= nT; T++) {
-              for (int R = 1; R <= nR; R++) {
-                for (int space_dir = 0; space_dir < 3; space_dir++) {
-                  estimators[T][R] +=
-                      WilsonLoop(T, R, 3, space_dir, x, i) + WilsonLoop(R, T, space_dir, 3, x, i);
-                }
-              }
-            }
-          }
-        }
+  for (const std::vector<double>& sum : sums) {
+    for (int T = 1; T <= nT; T++) {
+      for (int R = 1; R <= nR; R++) {
+        estimators[T][R] += sum[(T - 1) * nR + R - 1];
+        square_estimators[T][R] += std::pow(sum[(T - 1) * nR + R - 1] / norm, 2.0);
       }
     }
+  }
+  for (int T = 1; T <= nT; T++) {
+    for (int R = 1; R <= nR; R++) {
+      estimators[T][R] /= norm * fNcf;
+      errors[T][R] = sqrt((square_estimators[T][R] / fNcf - pow(estimators[T][R], 2.0)) / fNcf);
+    }
+  }
+  // Ratios W(r,t)/W(r,t+a) and their errors, propagated as uncorrelated
+  std::vector<std::vector<double>> ratios = estimators, ratio_errors = errors;
+  for (int T = 1; T < nT; T++) {
+    for (int R = 1; R <= nR; R++) {
+      ratios[T][R] = estimators[T][R] / estimators[T + 1][R];
+      ratio_errors[T][R] = std::pow(std::pow(errors[T][R] / estimators[T][R], 2.) +
+                                        std::pow(errors[T + 1][R] / estimators[T + 1][R], 2.),
+                                    0.5) *
+                           std::abs(ratios[T][R]);
+    }
+  }
+  if (fResampling != Resampling::None) {
+    const std::vector<Estimate> resampled =
+        Resample(sums, [nR, nT, norm](const std::vector<double>& mean) {
+          std::vector<double> values;  // The loops, then the ratios, in the order of mean
+          for (int k = 0; k < nR * nT; k++) values.push_back(mean[k] / norm);
+          for (int k = 0; k < nR * (nT - 1); k++) values.push_back(mean[k] / mean[k + nR]);
+          return values;
+        });
     for (int T = 1; T <= nT; T++) {
       for (int R = 1; R <= nR; R++) {
-        square_estimators[T][R] += std::pow(
-            (estimators[T][R] - old_estimators[T][R]) / (double)(n[0] * n[1] * n[2] * n[3] * 6.),
-            2.0);
+        errors[T][R] = resampled[(T - 1) * nR + R - 1].error;
+        if (T < nT) ratio_errors[T][R] = resampled[nR * nT + (T - 1) * nR + R - 1].error;
       }
     }
   }
@@ -473,11 +775,8 @@ void Metropolis::ComputeRxTWilsonLoops() const
   file_loop_output << std::endl;
   for (int T = 1; T <= nT; T++) {
     file_loop_output << T;
-    for (int R = 1; R <= nR; R++) {
-      estimators[T][R] /= n[0] * n[1] * n[2] * n[3] * 6. * fNcf;
-      errors[T][R] = sqrt((square_estimators[T][R] / fNcf - pow(estimators[T][R], 2.0)) / fNcf);
+    for (int R = 1; R <= nR; R++)
       file_loop_output << "\t" << estimators[T][R] << ":" << errors[T][R];
-    }
     file_loop_output << std::endl;
   }
   file_loop_output.close();
@@ -492,13 +791,8 @@ void Metropolis::ComputeRxTWilsonLoops() const
   file_potential_output << std::endl;
   for (int T = 1; T < nT; T++) {
     file_potential_output << T;
-    for (int R = 1; R <= nR; R++) {
-      file_potential_output << "\t" << estimators[T][R] / estimators[T + 1][R] << ":"
-                            << std::pow(std::pow(errors[T][R] / estimators[T][R], 2.) +
-                                            std::pow(errors[T + 1][R] / estimators[T + 1][R], 2.),
-                                        0.5) *
-                                   std::abs(estimators[T][R] / estimators[T + 1][R]);
-    }
+    for (int R = 1; R <= nR; R++)
+      file_potential_output << "\t" << ratios[T][R] << ":" << ratio_errors[T][R];
     file_potential_output << std::endl;
   }
   std::cout << "Printing on file \"RXT_potential_file.dat\"\n";
@@ -512,76 +806,654 @@ void Metropolis::ComputeRxTWilsonLoops() const
   file_potential_plot << "Potential aV(r)\n";
   file_potential_plot << "First column: r/a    Second column: aV(r)   Third column: sigma(aV(r))\n";
   for (int R = 1; R <= nR; R++) {
-    file_potential_plot << R << "\t" << estimators[nT - 1][R] / estimators[nT][R] << "\t"
-                        << std::pow(std::pow(errors[nT - 1][R] / estimators[nT - 1][R], 2.) +
-                                        std::pow(errors[nT][R] / estimators[nT][R], 2.),
-                                    0.5) *
-                               std::abs(estimators[nT - 1][R] / estimators[nT][R])
+    file_potential_plot << R << "\t" << ratios[nT - 1][R] << "\t" << ratio_errors[nT - 1][R]
                         << std::endl;
   }
   file_potential_plot.close();
   std::cout << "Printing on file \"RXT_potential_plot_file.dat\"\n";
 }
 
+// Measure the sums of the loop shapes, compiled once into their tree of links
+Measurement Metropolis::LoopShapesMeasurement() const
+{
+  std::shared_ptr<LoopShapes> shapes = std::make_shared<LoopShapes>(fLoopShapes);
+  std::string observable = "loop_shapes";
+  for (const std::string& shape : fLoopShapes) observable += " " + shape;
+  return {observable, (int)fLoopShapes.size(), {0, 0, 0, 0}, false,
+          [this, shapes](int, const Path& U, const WilsonLines&, const PlaquetteField&,
+                         std::vector<double>& sum) {
+            SumOverSites([&](const my4Vector& x,
+                             std::vector<double>& value) { shapes->Evaluate(U, x, value); },
+                         sum);
+          },
+          shapes->GetDirections()};
+}
+
+// Print the loop shapes expectation values
+void Metropolis::PrintLoopShapes(const std::vector<std::vector<double>>& sums) const
+{
+  std::vector<int> n = fPath.GetNCells();
+  const double volume = (double)n[0] * n[1] * n[2] * n[3];
+  std::vector<Estimate> resampled;
+  if (fResampling != Resampling::None) {
+    resampled = Resample(sums, [volume](const std::vector<double>& mean) {
+      std::vector<double> values;
+      for (double value : mean) values.push_back(value / volume);
+      return values;
+    });
+  }
+  std::cout << "End of statistics computation\nResults:\n";
+  for (std::size_t k = 0; k < fLoopShapes.size(); k++) {
+    double estimator = 0., square_estimator = 0.;
+    for (const std::vector<double>& sum : sums) {
+      estimator += sum[k] / volume;
+      square_estimator += std::pow(sum[k] / volume, 2.0);
+    }
+    estimator /= fNcf;
+    square_estimator /= fNcf;
+    const double error = resampled.empty()
+                             ? std::sqrt((square_estimator - std::pow(estimator, 2.0)) / fNcf)
+                             : resampled[k].error;
+    std::cout << "loop " << fLoopShapes[k] << " =   " << estimator << "  +/-  " << error
+              << std::endl;
+  }
+}
+
+// Measure the sums of the Polyakov loops (real and imaginary parts) and of their correlators in
+// each class of separations: the loops of the spatial sites are computed slab by slab, and the
+// correlators of all the separations with fast Fourier transforms
+Measurement Metropolis::PolyakovLoopsMeasurement() const
+{
+  std::shared_ptr<PolyakovLoops> polyakov = std::make_shared<PolyakovLoops>(fPath.GetNCells());
+  return {"polyakov_loops", 2 + polyakov->GetNClasses(), {0, 0, 0, 0}, false,
+          [this, polyakov](int, const Path& U, const WilsonLines&, const PlaquetteField&,
+                           std::vector<double>& sum) {
+            std::vector<std::complex<double>> loops(polyakov->GetNSites());
+            ForEachSlab([&](int i0, int i1) { polyakov->Compute(U, i0, i1, loops); });
+            for (const std::complex<double>& loop : loops) {
+              sum[0] += loop.real();
+              sum[1] += loop.imag();
+            }
+            std::vector<double> correlators(polyakov->GetNClasses(), 0.);
+            polyakov->Correlators(loops, correlators);
+            for (int k = 0; k < polyakov->GetNClasses(); k++) sum[2 + k] += correlators[k];
+          },
+          {3}};
+}
+
+// Print the Polyakov loop and its correlators: the potential is aV(r) = -ln C(r) / N_3, with the
+// error propagated from that of C(r), or resampled
+void Metropolis::PrintPolyakovLoops(const std::vector<std::vector<double>>& sums) const
+{
+  std::vector<int> n = fPath.GetNCells();
+  PolyakovLoops polyakov(n);
+  const std::vector<int> distances2 = polyakov.GetDistances2();
+  const std::vector<int> multiplicity = polyakov.GetMultiplicity();
+  const int nvalues = 2 + polyakov.GetNClasses();
+  std::vector<double> norms = {(double)polyakov.GetNSites(), (double)polyakov.GetNSites()};
+  for (int k = 0; k < polyakov.GetNClasses(); k++)
+    norms.push_back((double)polyakov.GetNSites() * multiplicity[k]);
+  std::vector<double> estimators(nvalues, 0.), errors(nvalues, 0.);
+  for (int k = 0; k < nvalues; k++) {
+    double square_estimator = 0.;
+    for (const std::vector<double>& sum : sums) {
+      estimators[k] += sum[k] / norms[k];
+      square_estimator += std::pow(sum[k] / norms[k], 2.0);
+    }
+    estimators[k] /= fNcf;
+    square_estimator /= fNcf;
+    errors[k] = std::sqrt((square_estimator - std::pow(estimators[k], 2.0)) / fNcf);
+  }
+  // Errors of the potentials, propagated from those of the correlators or resampled
+  std::vector<double> potential_errors(polyakov.GetNClasses());
+  for (int k = 0; k < polyakov.GetNClasses(); k++)
+    potential_errors[k] = errors[2 + k] / (std::abs(estimators[2 + k]) * n[3]);
+  if (fResampling != Resampling::None) {
+    const int nt = n[3];
+    const std::vector<Estimate> resampled =
+        Resample(sums, [nvalues, norms, nt](const std::vector<double>& mean) {
+          std::vector<double> values;  // The mean values, then the potentials
+          for (int k = 0; k < nvalues; k++) values.push_back(mean[k] / norms[k]);
+          for (int k = 2; k < nvalues; k++) values.push_back(-std::log(mean[k] / norms[k]) / nt);
+          return values;
+        });
+    for (int k = 0; k < nvalues; k++) errors[k] = resampled[k].error;
+    for (int k = 0; k < polyakov.GetNClasses(); k++)
+      potential_errors[k] = resampled[nvalues + k].error;
+  }
+  std::cout << "End of statistics computation\nResults:\n";
+  std::cout << "Re <L> =   " << estimators[0] << "  +/-  " << errors[0] << std::endl;
+  std::cout << "Im <L> =   " << estimators[1] << "  +/-  " << errors[1] << std::endl;
+
+  std::ofstream file_output("POLYAKOV_correlator_file.dat");
+  PrintSettingsOnFile(file_output);
+  file_output << "Polyakov loop correlator C(r) = <L(x) L(x+r)^*> and potential aV(r) = -ln C(r) / "
+              << n[3] << "\n";
+  file_output << "Columns: r/a   multiplicity   C(r)   sigma(C(r))   aV(r)   sigma(aV(r))\n";
+  for (int k = 0; k < polyakov.GetNClasses(); k++) {
+    const double correlator = estimators[2 + k];
+    const double error = errors[2 + k];
+    file_output << std::sqrt((double)distances2[k]) << "\t" << multiplicity[k] << "\t"
+                << correlator << "\t" << error << "\t" << -std::log(correlator) / n[3] << "\t"
+                << potential_errors[k] << std::endl;
+  }
+  file_output.close();
+  std::cout << "Printing on file \"POLYAKOV_correlator_file.dat\"\n";
+}
+
+// Measure the sums of the off-axis Wilson loops, for each base vector in the order (R - 1) * nT +
+// T - 1. The spatial paths of the vectors equivalent to each base vector are built once per
+// configuration, and the loop R x T is Re tr(A B^dagger) / 3, with A = L_e(x, R) L_t(x + R e, T)
+// and B = L_t(x, T) L_e(x + T t, R), as for the RxT Wilson loops
+Measurement Metropolis::OffAxisWilsonLoopsMeasurement() const
+{
+  const std::vector<int> n = fPath.GetNCells();
+  const int nT = RxTExtent(n)[1];
+  const std::vector<std::vector<int>> bases = fOffAxisVectors;
+  std::string observable = "off_axis_wilson_loops_" + std::to_string(nT);
+  int nvalues = 0;
+  for (const std::vector<int>& base : bases) {
+    if (OffAxisExtent(n, base) < 1) {
+      std::cout << "ERROR: the off-axis vector {" << base[0] << ", " << base[1] << ", " << base[2]
+                << "} is longer than half the lattice.\n";
+      throw 1;
+    }
+    observable += " " + std::to_string(base[0]) + "," + std::to_string(base[1]) + "," +
+                  std::to_string(base[2]) + "x" + std::to_string(OffAxisExtent(n, base));
+    nvalues += OffAxisExtent(n, base) * nT;
+  }
+  return {observable, nvalues, {0, 0, 0, nT}, false,
+          [this, n, nT, bases](int, const Path& U, const WilsonLines& lines, const PlaquetteField&,
+                               std::vector<double>& sum) {
+            int first = 0;  // Index of the first value of each base vector
+            for (const std::vector<int>& base : bases) {
+              const int nR = OffAxisExtent(n, base);
+              OffAxisLines paths(n, OffAxisLines::Variants(base), nR);
+              ForEachSlab([&](int i0, int i1) { paths.ComputeUnits(U, i0, i1); });
+              ForEachSlab([&](int i0, int i1) { paths.ComputeLines(i0, i1); });
+              std::vector<double> base_sum(nR * nT, 0.);
+              SumOverSites(
+                  [&](const my4Vector& x, std::vector<double>& value) {
+                    for (int v = 0; v < paths.GetNVectors(); v++) {
+                      for (int R = 1; R <= nR; R++) {
+                        const my4Vector xR = paths.End(x, v, R);
+                        for (int T = 1; T <= nT; T++) {
+                          const cx_dmat A = paths(x, v, R) * lines(xR, 3, T);
+                          const cx_dmat B = lines(x, 3, T) * paths(x.Offset(T, 3), v, R);
+                          value[(R - 1) * nT + T - 1] += WilsonLines::RealTrace(A, B) / 3.;
+                        }
+                      }
+                    }
+                  },
+                  base_sum);
+              for (int k = 0; k < nR * nT; k++) sum[first + k] += base_sum[k];
+              first += nR * nT;
+            }
+          },
+          {0, 1, 2, 3}};
+}
+
+// Print the off-axis Wilson loops, sorted by the distance R |e|, and the potential estimates from
+// the ratio W(r,t)/W(r,t+a) at the two largest times, as for the RxT Wilson loops
+void Metropolis::PrintOffAxisWilsonLoops(const std::vector<std::vector<double>>& sums) const
+{
+  const std::vector<int> n = fPath.GetNCells();
+  const int nT = RxTExtent(n)[1];
+  // Rows of the output: distance, label of the path, index of the first value and normalization
+  struct Row {
+    double r;
+    std::string path;
+    int first;
+    double norm;
+  };
+  std::vector<Row> rows;
+  int first = 0;
+  for (const std::vector<int>& base : fOffAxisVectors) {
+    const double length =
+        std::sqrt((double)(base[0] * base[0] + base[1] * base[1] + base[2] * base[2]));
+    const double norm = (double)n[0] * n[1] * n[2] * n[3] * OffAxisLines::Variants(base).size();
+    for (int R = 1; R <= OffAxisExtent(n, base); R++) {
+      rows.push_back({R * length,
+                      "{" + std::to_string(base[0]) + "," + std::to_string(base[1]) + "," +
+                          std::to_string(base[2]) + "}x" + std::to_string(R),
+                      first, norm});
+      first += nT;
+    }
+  }
+  std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.r < b.r; });
+
+  std::vector<std::vector<double>> estimators(rows.size(), std::vector<double>(nT + 1, 0.));
+  std::vector<std::vector<double>> errors = estimators;
+  for (std::size_t k = 0; k < rows.size(); k++) {
+    for (int T = 1; T <= nT; T++) {
+      double square_estimator = 0.;
+      for (const std::vector<double>& sum : sums) {
+        estimators[k][T] += sum[rows[k].first + T - 1] / rows[k].norm;
+        square_estimator += std::pow(sum[rows[k].first + T - 1] / rows[k].norm, 2.0);
+      }
+      estimators[k][T] /= fNcf;
+      square_estimator /= fNcf;
+      errors[k][T] = std::sqrt((square_estimator - std::pow(estimators[k][T], 2.0)) / fNcf);
+    }
+  }
+  // Errors of the potentials, propagated as uncorrelated or resampled with those of the loops
+  std::vector<double> potential_errors(rows.size(), 0.);
+  for (std::size_t k = 0; k < rows.size() && nT >= 2; k++) {
+    potential_errors[k] = std::pow(std::pow(errors[k][nT - 1] / estimators[k][nT - 1], 2.) +
+                                       std::pow(errors[k][nT] / estimators[k][nT], 2.),
+                                   0.5) *
+                          std::abs(estimators[k][nT - 1] / estimators[k][nT]);
+  }
+  if (fResampling != Resampling::None) {
+    const std::vector<Estimate> resampled =
+        Resample(sums, [rows, nT](const std::vector<double>& mean) {
+          std::vector<double> values;  // The loops of each row, then the potentials
+          for (const Row& row : rows) {
+            for (int T = 1; T <= nT; T++) values.push_back(mean[row.first + T - 1] / row.norm);
+          }
+          for (const Row& row : rows) {
+            if (nT >= 2) values.push_back(mean[row.first + nT - 2] / mean[row.first + nT - 1]);
+          }
+          return values;
+        });
+    for (std::size_t k = 0; k < rows.size(); k++) {
+      for (int T = 1; T <= nT; T++) errors[k][T] = resampled[k * nT + T - 1].error;
+      if (nT >= 2) potential_errors[k] = resampled[rows.size() * nT + k].error;
+    }
+  }
+  std::cout << "End of statistics computation\n";
+
+  // File output: first print the loop estimators
+  std::ofstream file_loop_output("OFFAXIS_loops_file.dat");
+  PrintSettingsOnFile(file_loop_output);
+  file_loop_output << "off-axis Wilson loop expectation values (the format is -> value:error)\n";
+  file_loop_output << "Vertical: r/a, path      Horizontal: t/a\n";
+  file_loop_output << "\t";
+  for (int T = 1; T <= nT; T++) file_loop_output << "\t" << T;
+  file_loop_output << std::endl;
+  for (std::size_t k = 0; k < rows.size(); k++) {
+    file_loop_output << rows[k].r << "\t" << rows[k].path;
+    for (int T = 1; T <= nT; T++)
+      file_loop_output << "\t" << estimators[k][T] << ":" << errors[k][T];
+    file_loop_output << std::endl;
+  }
+  file_loop_output.close();
+  std::cout << "Printing on file \"OFFAXIS_loops_file.dat\"\n";
+
+  // File output: then print the asymptotic W(r,t)/W(r,t+a) estimators, i.e. the potential
+  // estimators, in the format of RXT_potential_plot_file.dat
+  if (nT < 2) return;
+  std::ofstream file_potential_plot("OFFAXIS_potential_plot_file.dat");
+  PrintSettingsOnFile(file_potential_plot);
+  file_potential_plot << "Potential aV(r)\n";
+  file_potential_plot << "First column: r/a    Second column: aV(r)   Third column: sigma(aV(r))\n";
+  for (std::size_t k = 0; k < rows.size(); k++) {
+    file_potential_plot << rows[k].r << "\t" << estimators[k][nT - 1] / estimators[k][nT] << "\t"
+                        << potential_errors[k] << std::endl;
+  }
+  file_potential_plot.close();
+  std::cout << "Printing on file \"OFFAXIS_potential_plot_file.dat\"\n";
+}
+
+// Resample the sums with the jackknife, or with the bootstrap if set
+std::vector<Estimate> Metropolis::Resample(const std::vector<std::vector<double>>& sums,
+                                           const Statistics::Derived& f) const
+{
+  if (fResampling == Resampling::Bootstrap)
+    return Statistics::Bootstrap(sums, f, fNResamples, fResamplingSeed, fBinSize, fPool.get());
+  return Statistics::Jackknife(sums, f, fBinSize, fPool.get());
+}
+
 #include "../CUSTOM_POST.h"  //This defines the custom statistics function
 
 // Compute and return gauge-covariant derivative summed over all directions on the i-th result
 // element
 Path Metropolis::GaugeDerivative(int i) const
 {
+  return GaugeDerivative(fResult[i]);
+}
+
+// Compute and return gauge-covariant derivative summed over all directions on the configuration U:
+// the staples of the 4 directions rho are assigned to each direction mu in a single loop
+Path Metropolis::GaugeDerivative(const Path& U) const
+{
+  using namespace LatticeField;
   Path outPath(fPath.GetNCells());
-  Path U = fResult[i];
-  std::vector<int> n = fPath.GetNCells();
-  for (int i0 = 0; i0 < n[0]; i0++) {
-    for (int i1 = 0; i1 < n[1]; i1++) {
-      for (int i2 = 0; i2 < n[2]; i2++) {
-        for (int i3 = 0; i3 < n[3]; i3++) {
-          for (int mu = 0; mu < 4; mu++) {
-            cx_dmat sum(3, 3, fill::zeros);
-            my4Vector x({i0, i1, i2, i3}, n);
-            for (int rho = 0; rho < 4; rho++) {
-              sum += (1. / std::pow(fU0 * fA, 2.)) *
-                     (U(x, rho) * U(x.Offset(1, rho), mu) * U(x.Offset(1, mu), rho).t() -
-                      2. * fU0 * fU0 * U(x, mu) +
-                      U(x.Offset(-1, rho), rho).t() * U(x.Offset(-1, rho), mu) *
-                          U(x.Offset(-1, rho).Offset(1, mu), rho));
-            }
-            outPath.Set(x, mu) = sum;
-          }
-        }
-      }
-    }
+  Links V(U);
+  for (int mu = 0; mu < 4; mu++) {
+    auto term = [&](int rho) {
+      return V[rho] * shift(V[mu], rho) * adj(shift(V[rho], mu)) - 2. * fU0 * fU0 * V[mu] +
+             adj(shift(V[rho], rho, -1)) * shift(V[mu], rho, -1) *
+                 shift(shift(V[rho], mu), rho, -1);
+    };
+    AssignField(outPath, mu,
+                (1. / std::pow(fU0 * fA, 2.)) * (term(0) + term(1) + term(2) + term(3)));
   }
   return outPath;
 }
 
-// Smear fResult NTimes with a smearing parameter smearing_par
+// Record the smearing: it is applied to a copy of each configuration when the configuration is
+// measured, and with a symmetrization to each frame of the configuration, so that the
+// configurations whose values all come from the measurement cache are never smeared
 void Metropolis::SpatialSmearing(int Ntimes, double smearing_par)
 {
-  std::vector<int> n = fPath.GetNCells();
-  std::cout << "Spatial smearing of the link variables in the results (" << Ntimes
-            << " times)..\nProgress %: ";
-  int iteration = 0;
-  for (int i_smear = 0; i_smear < Ntimes; i_smear++) {
+  fSmearings.push_back({Ntimes, smearing_par});
+  std::cout << "Spatial smearing of the link variables (" << Ntimes
+            << " times) will be applied to each "
+            << (fSymmetrization != Symmetrization::None ? "frame of the configurations\n"
+                                                        : "configuration as it is measured\n");
+}
+
+// Call measure on each configuration, from fResult or streamed from the input file: with at least
+// as many configurations to measure as threads, the configurations are measured one per thread,
+// otherwise one at a time, each split into slabs by the analyses
+void Metropolis::ForEachConfiguration(const std::function<void(int, const Path&)>& measure,
+                                      const std::vector<int>& directions,
+                                      const std::vector<char>& needed) const
+{
+  int nmeasured = 0;
+  for (int i = 0; i < fNcf; i++)
+    if (needed.empty() || needed[i]) nmeasured++;
+  const int batch =
+      (fPool && nmeasured >= fPool->GetNThreads()) ? fPool->GetNThreads() : 1;
+  std::mutex progress_mutex;
+  int done = 0;
+  // The frames of a symmetrization mix the directions, and are smeared by MeasureAll
+  const bool smear = fSymmetrization == Symmetrization::None;
+
+  if (!fStreaming) {
+    // fResult keeps the configurations as read: the smearings act on a copy of each one
+    auto smear_and_measure = [&](int i) {
+      if (!smear || fSmearings.empty()) {
+        measure(i, fResult[i]);
+        return;
+      }
+      Path U(fResult[i]);
+      for (const auto& smearing : fSmearings)
+        SmearConfiguration(U, smearing.first, smearing.second);
+      measure(i, U);
+    };
+    if (batch == 1) {
+      for (int i = 0; i < fNcf; i++) {
+        PrintStatus(i, fNcf);
+        if (needed.empty() || needed[i]) smear_and_measure(i);
+      }
+      return;
+    }
+    std::vector<int> indices;
+    for (int i = 0; i < fNcf; i++)
+      if (needed.empty() || needed[i]) indices.push_back(i);
+    fPool->Run(indices.size(), [&](int k) {
+      smear_and_measure(indices[k]);
+      std::lock_guard<std::mutex> lock(progress_mutex);
+      PrintStatus(done++, nmeasured);
+    });
+    return;
+  }
+  EnsembleStream stream(fInputFile, std::max(2, batch),
+                        fSmearings.empty() && smear ? directions
+                                                    : std::vector<int>({0, 1, 2, 3}));
+  std::vector<Path> U(batch, Path(fPath.GetNCells()));
+  std::vector<int> indices(batch);
+  int i = 0;
+  while (i < fNcf) {
+    // Read the next batch of configurations to be measured, then smear and measure them
+    int filled = 0;
+    for (; i < fNcf && filled < batch; i++) {
+      if (batch == 1) PrintStatus(i, fNcf);
+      if (!stream.Next(U[filled])) {
+        std::cout << "ERROR while reading the lattice configurations from file.\n";
+        throw 1;
+      }
+      if (needed.empty() || needed[i]) indices[filled++] = i;
+    }
+    auto smear_and_measure = [&](int k) {
+      if (smear) {
+        for (const auto& smearing : fSmearings)
+          SmearConfiguration(U[k], smearing.first, smearing.second);
+      }
+      measure(indices[k], U[k]);
+      if (batch == 1) return;
+      std::lock_guard<std::mutex> lock(progress_mutex);
+      PrintStatus(done++, nmeasured);
+    };
+    if (batch == 1) {
+      if (filled == 1) smear_and_measure(0);
+    } else {
+      fPool->Run(filled, smear_and_measure);
+    }
+  }
+}
+
+// Measure each configuration, taking from the cache the values it already holds
+std::vector<std::vector<double>> Metropolis::MeasureEach(
+    const std::string& observable,
+    int nvalues,
+    const std::function<void(int, const Path&, std::vector<double>&)>& measure,
+    const std::vector<int>& directions) const
+{
+  Measurement measurement = {
+      observable, nvalues, {0, 0, 0, 0}, false,
+      [&measure](int i, const Path& U, const WilsonLines&, const PlaquetteField&,
+                 std::vector<double>& values) { measure(i, U, values); },
+      directions};
+  return MeasureAll({measurement})[0];
+}
+
+// Measure all the observables in one traversal: a configuration is read, smeared and given its
+// Wilson lines and plaquette field if some observable is missing from the cache, and only those
+// observables are measured on it
+std::vector<std::vector<std::vector<double>>> Metropolis::MeasureAll(
+    const std::vector<Measurement>& measurements) const
+{
+  const int nmeasurements = measurements.size();
+  std::vector<std::vector<std::vector<double>>> values(nmeasurements,
+                                                       std::vector<std::vector<double>>(fNcf));
+  std::vector<std::vector<char>> missing(nmeasurements, std::vector<char>(fNcf, 1));
+  std::vector<std::uint64_t> tags(nmeasurements, 0);
+  std::vector<int> cached(nmeasurements, 0);
+  std::vector<char> needed(fNcf, 0);
+  std::vector<int> directions;
+  const std::vector<int> n = fPath.GetNCells();
+  const std::vector<AxisTransformation> time_frames = TimeFrames(n, fSymmetrization);
+  const std::vector<AxisTransformation> spatial_frames = SpatialFrames(n, fSymmetrization);
+  const double nframes = (double)time_frames.size() * spatial_frames.size();
+  for (int m = 0; m < nmeasurements; m++) {
+    const Measurement& measurement = measurements[m];
+    // The averages over the frames are different measurements
+    std::string observable = measurement.observable;
+    if (fSymmetrization == Symmetrization::TimeAxes) observable += " time_axes";
+    if (fSymmetrization == Symmetrization::Hypercubic) observable += " hypercubic";
+    const bool cacheable = fCache && measurement.cached;
+    if (cacheable) tags[m] = MeasurementCache::Tag(observable, fSmearings);
     for (int i = 0; i < fNcf; i++) {
-      Path gauge_der = GaugeDerivative(i);
-      for (int i0 = 0; i0 < n[0]; i0++) {
-        for (int i1 = 0; i1 < n[1]; i1++) {
-          for (int i2 = 0; i2 < n[2]; i2++) {
-            for (int i3 = 0; i3 < n[3]; i3++) {
-              for (int mu = 0; mu < 3; mu++) {
-                my4Vector x({i0, i1, i2, i3}, n);
-                fResult[i].Set(x, mu) =
-                    fResult[i](x, mu) + smearing_par * fA * fA * gauge_der(x, mu);
+      if (cacheable && fCache->Find(i, tags[m], values[m][i]) &&
+          (int)values[m][i].size() == measurement.nvalues) {
+        missing[m][i] = 0;
+        cached[m]++;
+      } else {
+        values[m][i].assign(measurement.nvalues, 0.);
+        needed[i] = 1;
+      }
+    }
+    for (int mu : measurement.directions)
+      if (std::find(directions.begin(), directions.end(), mu) == directions.end())
+        directions.push_back(mu);
+  }
+  std::sort(directions.begin(), directions.end());
+
+  if (std::find(needed.begin(), needed.end(), 1) != needed.end()) {
+    std::mutex cache_mutex;
+    ForEachConfiguration(
+        [&](int i, const Path& configuration) {
+          // Lines long enough for all the observables measured on this configuration
+          std::vector<int> lengths(4, 0);
+          for (int m = 0; m < nmeasurements; m++) {
+            if (!missing[m][i]) continue;
+            for (int mu = 0; mu < 4; mu++)
+              lengths[mu] = std::max(lengths[mu], measurements[m].line_lengths[mu]);
+          }
+          bool plaquettes_used = false;
+          for (int m = 0; m < nmeasurements; m++)
+            plaquettes_used = plaquettes_used || (missing[m][i] && measurements[m].plaquettes);
+          // Measure the missing observables on a frame, adding to their values
+          auto measure_frame = [&](const Path& U) {
+            WilsonLines lines(n, lengths);
+            if (*std::max_element(lengths.begin(), lengths.end()) > 0)
+              ForEachSlab([&](int i0, int i1) { lines.Compute(U, i0, i1); });
+            // Plaquette field shared by the observables that use it, computed from the links as
+            // they are now, i.e. after the smearing of the configuration
+            PlaquetteField plaquettes(n, plaquettes_used);
+            if (plaquettes_used) {
+              ForEachSlab([&](int i0, int i1) { plaquettes.Compute(U, i0, i1); });
+              plaquettes.Validate();
+            }
+            for (int m = 0; m < nmeasurements; m++)
+              if (missing[m][i]) measurements[m].measure(i, U, lines, plaquettes, values[m][i]);
+          };
+          if (fSymmetrization == Symmetrization::None) {
+            measure_frame(configuration);
+          } else {
+            // The smearings act on the spatial directions: they are applied to each time frame,
+            // and commute with the spatial frames, which map the direction 3 onto itself
+            Path timed(n), transformed(n);
+            for (const AxisTransformation& time_frame : time_frames) {
+              ForEachSlab([&](int i0, int i1) { time_frame.Apply(configuration, timed, i0, i1); });
+              for (const auto& smearing : fSmearings)
+                SmearConfiguration(timed, smearing.first, smearing.second);
+              for (const AxisTransformation& spatial_frame : spatial_frames) {
+                if (spatial_frame.IsIdentity()) {
+                  measure_frame(timed);
+                  continue;
+                }
+                ForEachSlab(
+                    [&](int i0, int i1) { spatial_frame.Apply(timed, transformed, i0, i1); });
+                measure_frame(transformed);
               }
             }
+            for (int m = 0; m < nmeasurements; m++) {
+              if (!missing[m][i]) continue;
+              for (double& value : values[m][i]) value /= nframes;
+            }
           }
-        }
-      }
-      PrintStatus(iteration, fNcf * Ntimes);
-      iteration++;
+          std::lock_guard<std::mutex> lock(cache_mutex);
+          for (int m = 0; m < nmeasurements; m++)
+            if (fCache && measurements[m].cached && missing[m][i])
+              fCache->Store(i, tags[m], values[m][i]);
+        },
+        directions, needed);
+  } else {
+    PrintStatus(fNcf - 1, fNcf);
+  }
+  if (fCache) {
+    for (int m = 0; m < nmeasurements; m++)
+      if (measurements[m].cached)
+        std::cout << cached[m] << " of " << fNcf
+                  << " configurations read from the measurement cache " << fCache->GetFilename()
+                  << " (" << measurements[m].observable << ")\n";
+  }
+  return values;
+}
+
+// Open the measurement cache of the input file
+void Metropolis::UseMeasurementCache()
+{
+  if (fInputFile.empty()) {
+    std::cout << "ERROR: the measurement cache is available only for an ensemble read from file.\n";
+    throw 1;
+  }
+  fCache = std::make_shared<MeasurementCache>(fInputFile);
+}
+
+// Start the pool of the analyses
+void Metropolis::SetThreads(int nthreads)
+{
+  if (nthreads == 1)
+    fPool.reset();
+  else
+    fPool = std::make_shared<ThreadPool>(nthreads);
+}
+
+// Check the vectors now, so that a malformed one stops the program before the analysis
+void Metropolis::SetOffAxisVectors(const std::vector<std::vector<int>>& vectors)
+{
+  for (const std::vector<int>& base : vectors) {
+    if (base.size() != 3 || *std::min_element(base.begin(), base.end()) < 0 ||
+        *std::max_element(base.begin(), base.end()) == 0) {
+      std::cout << "ERROR: an off-axis vector must have 3 non-negative components, not all zero.\n";
+      throw 1;
     }
   }
+  fOffAxisVectors = vectors;
+}
+
+// Set the frames averaged by the analyses: the recorded smearings act on each frame
+void Metropolis::SetSymmetrization(Symmetrization symmetrization)
+{
+  fSymmetrization = symmetrization;
+  if (symmetrization == Symmetrization::None) return;
+  std::vector<int> n = fPath.GetNCells();
+  std::cout << "Frames of each configuration in the averages of the observables: "
+            << TimeFrames(n, symmetrization).size() * SpatialFrames(n, symmetrization).size()
+            << " (time directions: " << TimeFrames(n, symmetrization).size() << ")\n";
+}
+
+// The bins must leave at least two of them for the errors
+void Metropolis::SetResampling(Resampling resampling,
+                               int bin_size,
+                               int nresamples,
+                               std::uint64_t seed)
+{
+  if (bin_size < 1 || (resampling != Resampling::None && 2 * bin_size > fNcf)) {
+    std::cout << "ERROR: the bins of the resampling must be at least 2, with at least one "
+                 "configuration each.\n";
+    throw 1;
+  }
+  if (resampling == Resampling::Bootstrap && nresamples < 2) {
+    std::cout << "ERROR: the bootstrap needs at least 2 resamples.\n";
+    throw 1;
+  }
+  fResampling = resampling;
+  fBinSize = bin_size;
+  fNResamples = nresamples;
+  fResamplingSeed = seed;
+}
+
+// Check the shapes now, so that a malformed one stops the program before the analysis
+void Metropolis::SetLoopShapes(const std::vector<std::string>& shapes)
+{
+  LoopShapes loops(shapes);
+  fLoopShapes = shapes;
+}
+
+// Run the slabs on the pool, or serially without a pool
+void Metropolis::ForEachSlab(const std::function<void(int, int)>& slab) const
+{
+  std::vector<int> n = fPath.GetNCells();
+  std::function<void(int)> task = [&](int k) { slab(k / n[1], k % n[1]); };
+  if (fPool) {
+    fPool->Run(n[0] * n[1], task);
+  } else {
+    for (int k = 0; k < n[0] * n[1]; k++) task(k);
+  }
+}
+
+// Sum each slab in its own accumulator, then add the accumulators in slab order
+void Metropolis::SumOverSites(
+    const std::function<void(const my4Vector&, std::vector<double>&)>& site,
+    std::vector<double>& sum) const
+{
+  std::vector<int> n = fPath.GetNCells();
+  std::vector<std::vector<double>> slab_sums(n[0] * n[1], std::vector<double>(sum.size(), 0.));
+  ForEachSlab([&](int i0, int i1) {
+    std::vector<double>& slab_sum = slab_sums[i0 * n[1] + i1];
+    for (int i2 = 0; i2 < n[2]; i2++) {
+      for (int i3 = 0; i3 < n[3]; i3++) site(my4Vector({i0, i1, i2, i3}, n), slab_sum);
+    }
+  });
+  for (const std::vector<double>& slab_sum : slab_sums) {
+    for (std::size_t k = 0; k < sum.size(); k++) sum[k] += slab_sum[k];
+  }
 }
 
 // Update the current path: it returns the acceptance ratio for the update
@@ -596,32 +1468,25 @@ double Metropolis::UpdateCurrentPath()
   std::uniform_int_distribution<> uni_int(0, 2 * fNofSU3 - 1);
   double accepted = 0.0;
   std::vector<int> n = fPath.GetNCells();
-  // Seep over the lattice and do the update
-  for (int i0 = 0; i0 < n[0]; i0++) {
-    for (int i1 = 0; i1 < n[1]; i1++) {
-      for (int i2 = 0; i2 < n[2]; i2++) {
-        for (int i3 = 0; i3 < n[3]; i3++) {
-          for (int mu = 0; mu < 4; mu++) {
-            my4Vector x({i0, i1, i2, i3}, n);
-            // Compute the action independent on the link at (x,mu)
-            cx_dmat gamma_x_mu = Gamma(x, mu);
-            cx_dmat gamma_improved_x_mu(3, 3, fill::zeros);
-            if (fImproved) gamma_improved_x_mu = GammaImproved(x, mu);
-            // Do fInnerCycles updates before going to the next site
-            for (int inner = 0; inner < fInnerCycles; inner++) {
-              cx_dmat old_link_x_mu = fPath(x, mu);
-              double old_S_x_mu = S(x, mu, gamma_x_mu, gamma_improved_x_mu);
-              int index = uni_int(generator1);
-              fPath.Set(x, mu) = fSetOfSU3[index] * fPath(x, mu);
-              double deltaS = S(x, mu, gamma_x_mu, gamma_improved_x_mu) - old_S_x_mu;
-              // Accept or reject the update, depending on the sign of deltaS
-              if ((deltaS < 0) || (std::exp(-deltaS) > uni_01(generator2)))
-                accepted += 1.0;
-              else
-                fPath.Set(x, mu) = old_link_x_mu;
-            }
-          }
-        }
+  // Sweep over the lattice in the order defined by the tiles and do the update
+  for (const my4Vector& x : fSweepOrder) {
+    for (int mu = 0; mu < 4; mu++) {
+      // Compute the action independent on the link at (x,mu)
+      cx_dmat gamma_x_mu = Gamma(x, mu);
+      cx_dmat gamma_improved_x_mu(3, 3, fill::zeros);
+      if (fImproved) gamma_improved_x_mu = GammaImproved(x, mu);
+      // Do fInnerCycles updates before going to the next site
+      for (int inner = 0; inner < fInnerCycles; inner++) {
+        cx_dmat old_link_x_mu = fPath(x, mu);
+        double old_S_x_mu = S(x, mu, gamma_x_mu, gamma_improved_x_mu);
+        int index = uni_int(generator1);
+        fPath.Set(x, mu) = fSetOfSU3[index] * fPath(x, mu);
+        double deltaS = S(x, mu, gamma_x_mu, gamma_improved_x_mu) - old_S_x_mu;
+        // Accept or reject the update, depending on the sign of deltaS
+        if ((deltaS < 0) || (std::exp(-deltaS) > uni_01(generator2)))
+          accepted += 1.0;
+        else
+          fPath.Set(x, mu) = old_link_x_mu;
       }
     }
   }
@@ -631,70 +1496,212 @@ double Metropolis::UpdateCurrentPath()
 // Run the Metropolis algorithm on the current path
 void Metropolis::RunMetropolis()
 {
+  AllocateResult();
   std::cout << "Randomization of the SU3 matrices...\n";
   RandomizeSU3();
-  std::cout << "Metropolis is running..\nGrid thermalization...\nProgress %: " << std::flush;
+  const int warmup = fWarmupUpdates >= 0 ? fWarmupUpdates : 10 * fNcorr;
+  std::cout << "Metropolis is running..\n"
+            << (fWarmupUpdates >= 0 ? "Decorrelation of the resumed path...\n"
+                                    : "Grid thermalization...\n")
+            << "Progress %: " << std::flush;
   double avg = 0.0;
   int counter = 0;
-  fResult.clear();
 
-  for (int i = 0; i < 10 * fNcorr; i++) {  // thermalize the path
-    PrintStatus(i, 10 * fNcorr);
+  for (int i = 0; i < warmup; i++) {  // thermalize (or decorrelate) the path
+    PrintStatus(i, warmup);
     UpdateCurrentPath();
   }
+  if (warmup == 0) std::cout << "100\n";
   std::cout << "Generating configurations...\nProgress %: " << std::flush;
-  for (int i = 0; i < fNcf; i++) {  // repeat the following Ncf times
+  fTargetSeries.assign(fTargetError > 0. ? fTargetLoops.size() : 0, std::vector<double>());
+  fStartTime = std::chrono::steady_clock::now();
+  int sampled = 0;
+  for (int i = 0; i < fNcf; i++) {  // repeat the following Ncf times, at most
     PrintStatus(i, fNcf);
-    fResult.push_back(fPath);           // save current path
+    StoreConfiguration(i, fPath);  // save current path
+    sampled++;
+    // stop early, skipping the decorrelation
+    if (CheckStopping(sampled, fPath) && sampled < fNcf) break;
     for (int j = 0; j < fNcorr; j++) {  // discard fNcorr paths before saving again
       avg += UpdateCurrentPath();       // compute the average acceptance ratio
       counter++;
     }
   }
+  if (sampled < fNcf) std::cout << std::endl;
+  // After a complete run, fPath has been decorrelated from the last sample: it is the state the
+  // chain is resumed from
+  if (fOutput != nullptr && sampled == fNcf) fOutput->Checkpoint(fPath);
+  fNcf = sampled;
 
-  std::cout << "Metropolis has finished. The avg acceptance level is: " << avg / counter
-            << std::endl;
+  std::cout << "Metropolis has finished. The avg acceptance level is: "
+            << (counter > 0 ? avg / counter : 0.) << std::endl;
+  if (!fStopReason.empty())
+    std::cout << "Generation stopped after " << fNcf << " configurations: " << fStopReason
+              << std::endl;
+  PrintTargetEstimates();
+}
+
+// Total action of the current path: every plaquette (and rectangle) is counted once, so that
+// the local Metropolis::S terms are recovered when the link U_mu(x) is varied
+double Metropolis::TotalAction() const
+{
+  std::vector<int> n = fPath.GetNCells();
+  double plaquettes = 0., rectangles = 0.;
+  for (int i0 = 0; i0 < n[0]; i0++) {
+    for (int i1 = 0; i1 < n[1]; i1++) {
+      for (int i2 = 0; i2 < n[2]; i2++) {
+        for (int i3 = 0; i3 < n[3]; i3++) {
+          my4Vector x({i0, i1, i2, i3}, n);
+          for (int mu = 0; mu < 4; mu++) {
+            for (int nu = 0; nu < mu; nu++) {
+              plaquettes += WilsonLoop(1, 1, mu, nu, x, fPath);
+              if (fImproved)
+                rectangles += WilsonLoop(2, 1, mu, nu, x, fPath) + WilsonLoop(1, 2, mu, nu, x, fPath);
+            }
+          }
+        }
+      }
+    }
+  }
+  if (fImproved)
+    return -fBetaTilde * ((5. / (3. * std::pow(fU0, 4.))) * plaquettes -
+                          (1. / (12. * std::pow(fU0, 6.))) * rectangles);
+  else
+    return -fBeta * plaquettes;
 }
 
 // WILSON LOOP: to compute N_mu x N_nu Wilson loops around position x in the mu-nu plane using the
-// j-th path configuration
-double Metropolis::WilsonLoop(int N_mu, int N_nu, int mu, int nu, const my4Vector& x, int j) const
+// path configuration U
+double Metropolis::WilsonLoop(
+    int N_mu, int N_nu, int mu, int nu, const my4Vector& x, const Path& U) const
 {
   // lower horizontal segment in the mu direction
   cx_dmat LowerMu(3, 3, fill::eye);
-  for (int i = 0; i < N_mu; i++) LowerMu = LowerMu * fResult[j](x.Offset(i, mu), mu);
+  for (int i = 0; i < N_mu; i++) LowerMu = LowerMu * U(x.Offset(i, mu), mu);
   // right vertical segment in the nu direction
   cx_dmat RightNu(3, 3, fill::eye);
-  for (int i = 0; i < N_nu; i++)
-    RightNu = RightNu * fResult[j](x.Offset(N_mu, mu).Offset(i, nu), nu);
+  for (int i = 0; i < N_nu; i++) RightNu = RightNu * U(x.Offset(N_mu, mu).Offset(i, nu), nu);
   // upper horizontal segment "backward" in the mu direction
   cx_dmat UpperMu(3, 3, fill::eye);
   for (int i = 1; i <= N_mu; i++)
-    UpperMu = UpperMu * (fResult[j](x.Offset(N_nu, nu).Offset(N_mu - i, mu), mu).t());
+    UpperMu = UpperMu * (U(x.Offset(N_nu, nu).Offset(N_mu - i, mu), mu).t());
   // left vertical segment "downward" in the nu direction
   cx_dmat LeftNu(3, 3, fill::eye);
-  for (int i = 1; i <= N_nu; i++) LeftNu = LeftNu * (fResult[j](x.Offset(N_nu - i, nu), nu).t());
+  for (int i = 1; i <= N_nu; i++) LeftNu = LeftNu * (U(x.Offset(N_nu - i, nu), nu).t());
   // combine the segments into a Wilson loop
   return (1. / 3.) * ((trace(LowerMu * RightNu * UpperMu * LeftNu)).real());
 }
 
+// WILSON LOOP: to compute N_mu x N_nu Wilson loops around position x in the mu-nu plane using the
+// j-th path configuration
+double Metropolis::WilsonLoop(int N_mu, int N_nu, int mu, int nu, const my4Vector& x, int j) const
+{
+  return WilsonLoop(N_mu, N_nu, mu, nu, x, fResult[j]);
+}
+
 // Method to select the analysis to compute using the enum class Type
 void Metropolis::ComputeStatistics(Type type) const
 {
-  switch (type) {
-    case Type::PlaquetteRectangle: {
-      ComputePlaquetteRectangle();
-      break;
-    }
-    case Type::QuarkPotential: {
-      ComputeRxTWilsonLoops();
-      break;
+  ComputeStatistics(std::vector<Type>({type}));
+}
+
+// Measure the analyses of all the types in a single traversal of the ensemble, then print them
+void Metropolis::ComputeStatistics(const std::vector<Type>& types) const
+{
+  std::vector<Measurement> measurements;
+  for (Type type : types) {
+    switch (type) {
+      case Type::PlaquetteRectangle: {
+        std::cout << "Computing 1x1 and 2x1 plaquettes expectation values..\n";
+        measurements.push_back(PlaquetteRectangleMeasurement());
+        break;
+      }
+      case Type::QuarkPotential: {
+        std::cout << "Computing RxT Wilson loops..\n";
+        measurements.push_back(RxTWilsonLoopsMeasurement());
+        break;
+      }
+      case Type::Custom: {
+        std::cout << "Computing custom function expectation value..\n";
+        measurements.push_back(CustomMeasurement());
+        break;
+      }
+      case Type::LoopShapes: {
+        if (fLoopShapes.empty()) {
+          std::cout << "ERROR: no loop shapes set for the analysis.\n";
+          throw 1;
+        }
+        std::cout << "Computing the expectation values of " << fLoopShapes.size()
+                  << " loop shapes..\n";
+        measurements.push_back(LoopShapesMeasurement());
+        break;
+      }
+      case Type::PolyakovLoops: {
+        std::cout << "Computing Polyakov loops and their correlators..\n";
+        measurements.push_back(PolyakovLoopsMeasurement());
+        break;
+      }
+      case Type::OffAxisWilsonLoops: {
+        if (fOffAxisVectors.empty()) {
+          std::cout << "ERROR: no off-axis vectors set for the analysis.\n";
+          throw 1;
+        }
+        std::cout << "Computing off-axis Wilson loops..\n";
+        measurements.push_back(OffAxisWilsonLoopsMeasurement());
+        break;
+      }
+      default:
+        std::cout << "No statistics computed, wrong predefined type\n";
+        return;
     }
-    case Type::Custom: {
-      ComputeCustom();
-      break;
+  }
+  if (measurements.empty()) return;
+  std::cout << "Progress %: " << std::flush;
+  std::vector<std::vector<std::vector<double>>> sums = MeasureAll(measurements);
+  for (std::size_t k = 0; k < types.size(); k++) {
+    switch (types[k]) {
+      case Type::PlaquetteRectangle: {
+        PrintPlaquetteRectangle(sums[k]);
+        break;
+      }
+      case Type::QuarkPotential: {
+        PrintRxTWilsonLoops(sums[k]);
+        break;
+      }
+      case Type::Custom: {
+        PrintCustom(sums[k]);
+        break;
+      }
+      case Type::LoopShapes: {
+        PrintLoopShapes(sums[k]);
+        break;
+      }
+      case Type::PolyakovLoops: {
+        PrintPolyakovLoops(sums[k]);
+        break;
+      }
+      case Type::OffAxisWilsonLoops: {
+        PrintOffAxisWilsonLoops(sums[k]);
+        break;
+      }
     }
-    default:
-      std::cout << "No statistics computed, wrong predefined type\n";
   }
 }
+
+// Compute plaquette and rectangle expectation values
+void Metropolis::ComputePlaquetteRectangle() const
+{
+  ComputeStatistics(Type::PlaquetteRectangle);
+}
+
+// Compute RxT Wilson Loops
+void Metropolis::ComputeRxTWilsonLoops() const
+{
+  ComputeStatistics(Type::QuarkPotential);
+}
+
+// Compute the expectation value of the custom function defined in CUSTOM_POST.h
+void Metropolis::ComputeCustom() const
+{
+  ComputeStatistics(Type::Custom);
+}
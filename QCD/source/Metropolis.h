@@ -10,13 +10,29 @@
 #define METROPOLIS_H
 
 #include <armadillo>
+#include <chrono>
 #include <complex>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <random>
 #include <string>
+#include <type_traits>
 #include <vector>
+#include "AxisTransformation.h"
+#include "Ensemble.h"
+#include "EnsembleFile.h"
+#include "LatticeField.h"
 #include "Path.h"
+#include "Statistics.h"
 using namespace arma;
 
+class BackgroundWriter;
+class MeasurementCache;
+class PlaquetteField;
+class ThreadPool;
+class WilsonLines;
+
 /// Type enum class
 ///
 /// Enum class which collects the available types of analysis for the method
@@ -24,7 +40,34 @@ using namespace arma;
 enum class Type {
   PlaquetteRectangle,  ///< Select the 1x1 and 1x2 Wilson loops expectation values
   QuarkPotential,       ///< Select the quark potential computation
-  Custom                ///< Select a customized analysis, as defined in CUSTOM_POST.h
+  Custom,               ///< Select a customized analysis, as defined in CUSTOM_POST.h
+  LoopShapes,           ///< Select the loops given as direction strings \see SetLoopShapes
+  PolyakovLoops,        ///< Select the Polyakov loops and their correlators \see PolyakovLoops
+  OffAxisWilsonLoops    ///< Select the Wilson loops with off-axis spatial sides
+                        ///< \see SetOffAxisVectors
+};
+
+/// Measurement struct
+///
+/// Observable measured on each configuration by Metropolis::MeasureAll, in the same traversal of
+/// the ensemble as the other observables: the configurations are read and smeared once, and the
+/// Wilson lines and the plaquette field of each configuration are built once for all the
+/// observables.
+struct Measurement {
+  std::string observable;         ///< Name of the observable: it must change whenever measure does
+  int nvalues;                    ///< Number of values measured on each configuration
+  std::vector<int> line_lengths;  ///< Maximum length of the Wilson lines used by measure in each
+                                  ///< direction (0 = none) \see WilsonLines
+  bool plaquettes;                ///< True if measure uses the plaquette field \see PlaquetteField
+  std::function<void(
+      int, const Path&, const WilsonLines&, const PlaquetteField&, std::vector<double>&)>
+      measure;                    ///< Function called with the index of the configuration, the
+                                  ///< configuration, its Wilson lines, its plaquette field and the
+                                  ///< values to be filled, initially zero
+  std::vector<int> directions;    ///< Directions of the links used by measure
+                                  ///< \see Metropolis::ForEachConfiguration
+  bool cached = true;             ///< False if the values must never go through the measurement
+                                  ///< cache, e.g. when observable is not tied to the code of measure
 };
 
 /// Metropolis class
@@ -42,6 +85,8 @@ enum class Type {
 /// \see intro
 class Metropolis
 {
+  friend class ParallelTempering;
+
  private:
   int fNofSU3;       ///< Number of SU3 matrices to be generated and used to update the links
   int fNcorr;        ///< Number of correlated configurations to skip before next sampling
@@ -61,8 +106,46 @@ class Metropolis
 
   std::vector<cx_dmat> fSetOfSU3;  ///< Set of SU3 matrices used to update the links
   Path fPath;                      ///< Path object which defines the current lattice configuration
-  std::vector<Path> fResult;  ///< Vector of Path configurations: it stores the Montecarlo ensemble
-                              ///< obtained by running Metropolis::RunMetropolis
+  std::vector<my4Vector> fSweepOrder;  ///< Order in which the sites are visited by
+                                       ///< Metropolis::UpdateCurrentPath \see SetSweepTiles
+  Ensemble fResult;  ///< Pool of Path configurations: it stores the Montecarlo ensemble
+                     ///< obtained by running Metropolis::RunMetropolis
+
+  double fTargetError;  ///< Relative error on the target observables which stops the generation
+                        ///< (0 = always sample fNcf configurations) \see SetStoppingRule
+  std::vector<std::vector<int>> fTargetLoops;  ///< Target Wilson loops {N_mu, N_nu}, averaged
+                                               ///< over all the planes mu > nu
+  int fMinNcf;          ///< Minimum number of configurations before the stopping test
+  double fMaxMinutes;   ///< Time budget of the generation in minutes (0 = unlimited)
+  std::vector<std::vector<double>> fTargetSeries;  ///< Inline measurements of the target loops
+  std::chrono::steady_clock::time_point fStartTime;  ///< Start of the configuration generation
+  std::string fStopReason;  ///< Reason why the last generation stopped (empty without a stopping
+                            ///< rule)
+  BackgroundWriter* fOutput;  ///< Writer receiving the sampled configurations, if any
+                              ///< \see SetOutput
+  int fWarmupUpdates;  ///< Updates of fPath before the first sample (-1 = thermalization from a
+                       ///< cold start, 10 fNcorr updates) \see Resume
+
+  std::string fInputFile;  ///< Input file read one configuration at a time, in streaming mode
+  bool fStreaming;         ///< True if the configurations are streamed from fInputFile instead of
+                           ///< being stored in fResult
+  std::vector<std::pair<int, double>> fSmearings;  ///< Smearings {Ntimes, smearing_par} applied to
+                                                   ///< a copy of each configuration measured
+  std::shared_ptr<MeasurementCache> fCache;  ///< Cache of the measurements on the configurations
+                                             ///< of fInputFile, if enabled
+                                             ///< \see UseMeasurementCache
+  std::shared_ptr<ThreadPool> fPool;  ///< Threads of the analyses (none = serial) \see SetThreads
+  std::vector<std::string> fLoopShapes;  ///< Direction strings of the loops of Type::LoopShapes
+                                         ///< \see SetLoopShapes
+  std::vector<std::vector<int>> fOffAxisVectors;  ///< Base vectors of the spatial sides of the
+                                                  ///< loops of Type::OffAxisWilsonLoops
+                                                  ///< \see SetOffAxisVectors
+  Symmetrization fSymmetrization;  ///< Average of the observables over the equivalent frames of
+                                   ///< each configuration \see SetSymmetrization
+  Resampling fResampling;          ///< Method for the errors of the analyses \see SetResampling
+  int fBinSize;                    ///< Number of consecutive configurations in each bin
+  int fNResamples;                 ///< Number of resamples of the bootstrap
+  std::uint64_t fResamplingSeed;   ///< Seed of the resamples of the bootstrap
 
   /************************ Private Methods ***************************/
   /// Gamma
@@ -102,12 +185,107 @@ class Metropolis
   /// \param max_index max index value of the loop
   void PrintStatus(int index, int max_index) const;
 
+  /// Apply the settings of an ensemble file
+  /// \param settings settings read from the file
+  void ApplySettings(const EnsembleSettings& settings);
+
+  /// Store a configuration
+  ///
+  /// Auxiliary method to save a path as the i-th sampled configuration: it is pushed to fOutput if
+  /// set, otherwise it is copied in the i-th slot of fResult.
+  /// \param i index of the sampled configuration
+  /// \param path sampled path: fPath, or the path of the replica at the target beta
+  /// \see ParallelTempering
+  void StoreConfiguration(int i, const Path& path);
+
+  /// Allocate the result
+  ///
+  /// Auxiliary method to allocate, from the calling thread, the fNcf slots of fResult filled by a
+  /// run without output, if they are not allocated yet. \see SetOutput
+  void AllocateResult();
+
+  /// Check the stopping rule
+  ///
+  /// Auxiliary method called after each sampled configuration: measure the target loops on the
+  /// sampled path and decide whether the generation may stop, recording the reason in fStopReason.
+  /// \param sampled number of configurations sampled so far
+  /// \param path sampled path
+  /// \return true if the generation must stop
+  bool CheckStopping(int sampled, const Path& path);
+
+  /// Print the target estimates
+  ///
+  /// Auxiliary method to print the target loops measured during the generation, with their
+  /// autocorrelation-aware errors.
+  void PrintTargetEstimates() const;
+
   /// Print settings on file
   ///
   /// Auxiliary method to print the experiment settings as a header of an output file.
   /// \param file output file object on which the settings are printed
   void PrintSettingsOnFile(std::ofstream& file) const;
 
+  /// \return measurement of the sums of the 1x1 and 1x2 Wilson loops on each configuration
+  /// \see ComputePlaquetteRectangle
+  Measurement PlaquetteRectangleMeasurement() const;
+
+  /// Print the 1x1 and 1x2 Wilson loop expectation values
+  /// \param sums values of PlaquetteRectangleMeasurement on each configuration
+  void PrintPlaquetteRectangle(const std::vector<std::vector<double>>& sums) const;
+
+  /// \return measurement of the sums of the RxT Wilson loops on each configuration
+  /// \see ComputeRxTWilsonLoops
+  Measurement RxTWilsonLoopsMeasurement() const;
+
+  /// Print the RxT Wilson loop expectation values and the potential estimates on file
+  /// \param sums values of RxTWilsonLoopsMeasurement on each configuration
+  void PrintRxTWilsonLoops(const std::vector<std::vector<double>>& sums) const;
+
+  /// \return measurement of the custom function on each configuration, as defined in
+  /// CUSTOM_POST.h \see ComputeCustom
+  Measurement CustomMeasurement() const;
+
+  /// Print the expectation value of the custom function, as defined in CUSTOM_POST.h
+  /// \param sums values of CustomMeasurement on each configuration
+  void PrintCustom(const std::vector<std::vector<double>>& sums) const;
+
+  /// \return measurement of the sums of the loops of fLoopShapes on each configuration
+  /// \see SetLoopShapes
+  Measurement LoopShapesMeasurement() const;
+
+  /// Print the expectation values of the loops of fLoopShapes
+  /// \param sums values of LoopShapesMeasurement on each configuration
+  void PrintLoopShapes(const std::vector<std::vector<double>>& sums) const;
+
+  /// \return measurement of the sums of the Polyakov loops and of their correlators on each
+  /// configuration \see PolyakovLoops
+  Measurement PolyakovLoopsMeasurement() const;
+
+  /// Print the expectation values of the Polyakov loop and of its correlators, and the potential
+  /// obtained from the correlators, on file POLYAKOV_correlator_file.dat
+  /// \param sums values of PolyakovLoopsMeasurement on each configuration
+  void PrintPolyakovLoops(const std::vector<std::vector<double>>& sums) const;
+
+  /// \return measurement of the sums of the off-axis Wilson loops on each configuration
+  /// \see SetOffAxisVectors
+  Measurement OffAxisWilsonLoopsMeasurement() const;
+
+  /// Print the off-axis Wilson loops and the potential estimates, sorted by distance, on files
+  /// OFFAXIS_loops_file.dat and OFFAXIS_potential_plot_file.dat
+  /// \param sums values of OffAxisWilsonLoopsMeasurement on each configuration
+  void PrintOffAxisWilsonLoops(const std::vector<std::vector<double>>& sums) const;
+
+  /// Resample
+  ///
+  /// Estimate quantities derived from the mean values of the sums on the configurations, with the
+  /// errors of the method set by SetResampling, on the threads of the analyses.
+  /// \param sums values of a measurement on each configuration
+  /// \param f function of the mean values of the sums, returning the derived quantities
+  /// \return value and error of each derived quantity \see Statistics::Jackknife,
+  /// Statistics::Bootstrap
+  std::vector<Estimate> Resample(const std::vector<std::vector<double>>& sums,
+                                 const Statistics::Derived& f) const;
+
  public:
   Metropolis() = delete;
 
@@ -126,8 +304,13 @@ class Metropolis
   /// Metropolis constructor from file
   ///
   /// \param infile input file: it should be a previous output of the method
-  /// Metropolis::PrintAllOnFile in the non-verbose option \see Metropolis::PrintAllOnFile
-  Metropolis(std::string infile);
+  /// Metropolis::PrintAllOnFile in the binary or non-verbose text option. Binary files are mapped
+  /// in memory, so that the configurations are read from disk only when they are used.
+  /// \param streaming if true, only the settings are read here: the analyses read the
+  /// configurations one at a time, with read-ahead, so that the memory in use does not depend on
+  /// the number of configurations \see Metropolis::ForEachConfiguration, EnsembleStream
+  /// \see Metropolis::PrintAllOnFile, EnsembleReader
+  Metropolis(std::string infile, bool streaming = false);
 
   /// Metropolis destructor
   ~Metropolis();
@@ -156,14 +339,21 @@ class Metropolis
   /// \return fImproved
   bool IsImproved() const;
 
+  /// \return fStopReason, the reason why the last generation stopped
+  std::string GetStopReason() const;
+
+  /// \return the experiment settings in the form stored by the ensemble files
+  EnsembleSettings GetSettings() const;
+
   /// \return fSetOfSU3
   std::vector<cx_dmat> GetSetOfSU3() const;
 
   /// \return fPath, the current lattice configuration
   Path GetCurrentPath() const;
 
-  /// \return fResult, the vector containing the Metropolis ensemble of lattice configurations
-  std::vector<Path> GetCurrentResult() const;
+  /// \return fResult, the pool containing the Metropolis ensemble of lattice configurations, with
+  /// the smearings applied \see SpatialSmearing
+  Ensemble GetCurrentResult() const;
 
   /// Print current path on standard output
   void PrintPathOnScreen() const;
@@ -177,15 +367,74 @@ class Metropolis
   /// Print settings and Montecarlo configurations on file.
   /// \param outfile name of the file to print on
   /// \param opt option for the type of output:\n
-  ///           - by default, the print mode is silent, which is the required option for later
+  ///           - by default, the print mode is silent, which is a text format suitable for later
   ///           postprocessing (matrix elements are printed with maximum accuracy, no headers)\n
+  ///           - 'B' selects the binary format of EnsembleWriter, which stores the raw doubles and
+  ///           is read back by QCD_POST without parsing \see EnsembleWriter\n
+  ///           - 'C' selects the compressed version of the binary format\n
   ///           - as an option, 'V' may be specified for a verbose print, which is more user
   ///           readable and it saves disk space, though it is less accurate
   void PrintAllOnFile(std::string outfile, char opt = 'S') const;
 
+  /// Set the sweep tiles
+  ///
+  /// Define the order in which Metropolis::UpdateCurrentPath visits the lattice: the lattice is
+  /// split into 4D tiles of the given sizes, the tiles are visited in lexicographic order and all
+  /// the sites of a tile are updated before moving to the next one, so that the links reached by
+  /// the (improved) staples stay in cache. Each single link update satisfies detailed balance, so
+  /// any fixed visiting order preserves the equilibrium distribution. Tile sizes equal to the
+  /// lattice dimensions give the plain lexicographic sweep, which is the default.
+  /// \param tiles vector containing the tile sizes in the 4 dimensions
+  void SetSweepTiles(std::vector<int> tiles);
+
+  /// Set the stopping rule
+  ///
+  /// Turn fNcf into a budget: the generation stops as soon as the relative errors of all the
+  /// target loops, measured inline on each sampled configuration, are below target_error, or when
+  /// the configuration (fNcf) or time budget runs out. The errors include the integrated
+  /// autocorrelation time of each series. \see Statistics::AutocorrelatedError
+  /// \param target_error relative error to reach on every target loop (0 = no target)
+  /// \param loops target Wilson loops in the form {N_mu, N_nu}, e.g. {1, 1} for the plaquette
+  /// \param min_configs minimum number of configurations before the target is tested
+  /// \param max_minutes time budget of the generation in minutes (0 = unlimited)
+  void SetStoppingRule(double target_error,
+                       std::vector<std::vector<int>> loops,
+                       int min_configs,
+                       double max_minutes);
+
+  /// Set the output
+  ///
+  /// Stream the configurations sampled by the following runs to output as soon as they are taken,
+  /// instead of collecting them in fResult: the slots of fResult are released, and no run
+  /// allocates them, so the memory in use no longer grows with fNcf. The output must be closed by
+  /// the caller after the run.
+  /// \param output writer of the ensemble file, or nullptr to collect the configurations in fResult
+  void SetOutput(BackgroundWriter* output);
+
+  /// Resume
+  ///
+  /// Continue the Markov chain stored in an ensemble file instead of starting from a cold lattice:
+  /// fPath is set to the checkpoint of the file, if any, and the first sample is taken
+  /// immediately; otherwise, fPath is set to the last configuration of the file, and fNcorr
+  /// updates are done before the first sample. No thermalization is needed in either case. The
+  /// new configurations are meant to be appended to the same file. \see BackgroundWriter
+  /// \param filename binary ensemble file written with the same settings (apart from Ncf)
+  void Resume(std::string filename);
+
+  /// Place the memory
+  ///
+  /// Copy fPath and the configurations in fResult into new buffers first touched by the calling
+  /// thread, so that their pages are placed on the NUMA node where the thread runs.
+  /// \see LatticeMemory::PinCurrentThread
+  void PlaceMemory();
+
+  /// Print on standard output where the memory of fPath and fResult actually landed
+  /// \param label name of the instance in the report
+  void PrintMemoryReport(const std::string& label) const;
+
   /// Clear the result
   ///
-  /// Bring the result vector fResult to its default value
+  /// Bring the configurations in fResult to their default value
   void ClearResult();
 
   /// Update the current fPath configuration
@@ -195,12 +444,144 @@ class Metropolis
   /// Spatial smearing
   ///
   /// Perform Ntimes a spatial smearing using a discretized version of the
-  /// gauge-covariant derivative on the set of Montecarlo configurations in fResult.
+  /// gauge-covariant derivative on the set of Montecarlo configurations. The smearing is recorded
+  /// and applied to a copy of each configuration when it is measured, so that fResult keeps the
+  /// configurations as read and those whose values all come from the measurement cache are not
+  /// smeared.
   /// \param Ntimes number of consecutive spatial smearings to apply on the lattice
   /// \param smearing_par value of the smearing parameter
   /// \see Metropolis::GaugeDerivative
   void SpatialSmearing(int Ntimes, double smearing_par);
 
+  /// Smear a configuration
+  ///
+  /// Perform Ntimes a spatial smearing of the configuration U, with the settings of this instance.
+  /// \param U configuration to be smeared
+  /// \param Ntimes number of consecutive spatial smearings
+  /// \param smearing_par value of the smearing parameter
+  void SmearConfiguration(Path& U, int Ntimes, double smearing_par) const;
+
+  /// Use the measurement cache
+  ///
+  /// Keep the per-configuration results of the analyses in the side-car of the input file, and
+  /// reuse the results already stored there: the link loops are skipped for the configurations
+  /// (and smearings) analysed by a previous run. Available for an instance built from a file.
+  /// \see MeasurementCache, MeasureEach
+  void UseMeasurementCache();
+
+  /// Set the threads of the analyses
+  ///
+  /// Run the smearings and the analyses on a pool of threads. When there are at least as many
+  /// configurations to measure as threads, each thread measures whole configurations; otherwise
+  /// the configurations are measured one at a time, each one split into slabs among the threads.
+  /// In both cases the sums over the lattice are accumulated slab by slab and combined in a fixed
+  /// order, so that the results do not depend on the number of threads.
+  /// \param nthreads number of threads (0 = the available hardware threads, 1 = serial)
+  /// \see ForEachSlab, SumOverSites, ThreadPool
+  void SetThreads(int nthreads);
+
+  /// Set the loop shapes
+  ///
+  /// Set the closed paths of links whose expectation values are computed by the analysis of type
+  /// Type::LoopShapes, as direction strings such as "+0+0+1-0-0-1" (the 2x1 rectangle in the plane
+  /// 0-1). \see LoopShapes
+  /// \param shapes direction strings of the loops: an error is raised if one of them is not a
+  /// closed path
+  void SetLoopShapes(const std::vector<std::string>& shapes);
+
+  /// Set the off-axis vectors
+  ///
+  /// Set the base vectors of the spatial sides of the loops computed by the analysis of type
+  /// Type::OffAxisWilsonLoops, e.g. {1, 1, 0} for the planar diagonal and {1, 1, 1} for the
+  /// space diagonal. The loops R x T are measured with the spatial sides R e, for every vector e
+  /// equivalent to a base vector under the permutations of the axes and the reflections, and for
+  /// R = 1, 2, .. as long as no component of R e exceeds half the lattice. The spatial paths are
+  /// averaged over the orderings of their steps. \see OffAxisLines
+  /// \param vectors base vectors, with 3 non-negative components, not all zero: {1, 0, 0} gives
+  /// the on-axis loops of Type::QuarkPotential
+  void SetOffAxisVectors(const std::vector<std::vector<int>>& vectors);
+
+  /// Set the symmetrization
+  ///
+  /// Average every observable, on each configuration, over the frames of the configuration
+  /// equivalent under the hypercubic group, i.e. its images under the permutations of the axes
+  /// and the reflections which preserve the lattice dimensions: on a lattice with N^4 sites, each
+  /// of the 4 directions is taken as the time direction in turn, while on a N^3 x M lattice only
+  /// the direction 3 can be. The averages are the per-configuration values of the analyses, so
+  /// their errors take the correlations among the frames into account. The smearings act on the
+  /// spatial directions of each frame, so they are applied once per time direction.
+  /// \see AxisTransformation
+  /// \param symmetrization Symmetrization::TimeAxes takes each equivalent direction as the time
+  /// direction in turn, which is enough for the RxT, off-axis and Polyakov loops and for the
+  /// plaquettes, as these analyses already average over the spatial axes and the reflections;
+  /// Symmetrization::Hypercubic also applies all the spatial permutations and the reflections to
+  /// each frame (up to 384 frames), for observables such as the loops of Type::LoopShapes
+  /// and Type::Custom.
+  void SetSymmetrization(Symmetrization symmetrization);
+
+  /// Set the resampling
+  ///
+  /// Set the method for the errors of the analyses. With Resampling::None, the errors of the mean
+  /// values are the standard deviations of the values on the configurations, and those of the
+  /// derived quantities, such as the ratios W(r,t)/W(r,t+a) of the Wilson loops and the
+  /// potentials, are propagated as if the mean values were uncorrelated. With
+  /// Resampling::Jackknife and Resampling::Bootstrap, all the errors are obtained by resampling
+  /// the bins of consecutive configurations, which accounts for the correlations among the
+  /// observables measured on the same configurations and, with bins longer than the
+  /// autocorrelation time, for the correlations along the Markov chain. The values of the
+  /// measurements are not recomputed: they are read from the measurement cache, if enabled.
+  /// \see Statistics::Jackknife, Statistics::Bootstrap
+  /// \param resampling method for the errors
+  /// \param bin_size number of consecutive configurations in each bin
+  /// \param nresamples number of resamples of the bootstrap
+  /// \param seed seed of the resamples of the bootstrap: the errors do not depend on the number of
+  /// threads
+  void SetResampling(Resampling resampling,
+                     int bin_size = 1,
+                     int nresamples = 1000,
+                     std::uint64_t seed = 1);
+
+  /// For each slab
+  ///
+  /// Call slab on every slab of the lattice, i.e. every set of sites with given x_0 and x_1, on the
+  /// threads of the analyses: each call must only write data of its own slab.
+  /// \param slab function called with the coordinates x_0 and x_1 of the slab
+  void ForEachSlab(const std::function<void(int, int)>& slab) const;
+
+  /// Sum over the lattice sites
+  ///
+  /// Add to sum the values of a function summed over all the lattice sites. Each slab of the
+  /// lattice is summed in its own accumulator, on the threads of the analyses, and the
+  /// accumulators are then added to sum in the order of the slabs. \see ForEachSlab
+  /// \param site function called with each site x and the accumulator of its slab, to which the
+  /// values at x are to be added
+  /// \param sum values to which the sums are added
+  void SumOverSites(const std::function<void(const my4Vector&, std::vector<double>&)>& site,
+                    std::vector<double>& sum) const;
+
+  /// Sum a field expression over the lattice sites
+  ///
+  /// Evaluate a field expression, such as real(trace(U[mu] * shift(U[nu], mu) * ..)), at every
+  /// lattice site in a single loop shared among the threads of the analyses, and return the sum
+  /// of its values. Each slab is summed in its own accumulator and the accumulators are added in
+  /// the order of the slabs, as in SumOverSites. \see LatticeField
+  /// \param e field expression with real or complex values, on configurations with the lattice
+  /// dimensions of the instance
+  /// \return sum of the values of e over the lattice
+  template <class E>
+  typename E::Value SumField(const LatticeField::Field<E>& e) const;
+
+  /// Assign a field expression to the links of a configuration
+  ///
+  /// Evaluate a matrix field expression at every lattice site in a single loop shared among the
+  /// threads of the analyses, and store its values in the links of a direction of U. An error is
+  /// raised if the expression reads the links of U. \see LatticeField
+  /// \param U path configuration, with the lattice dimensions of the instance
+  /// \param mu direction of the links of U that are written
+  /// \param e field expression with 3x3 matrix values
+  template <class E>
+  void AssignField(Path& U, int mu, const LatticeField::Field<E>& e) const;
+
   /// Compute the discretized gauge derivative
   ///
   /// Compute the discretized gauge-covariant derivative summed over all directions on the i-th
@@ -209,10 +590,68 @@ class Metropolis
   /// configuration
   Path GaugeDerivative(int i) const;
 
+  /// Compute the discretized gauge derivative
+  ///
+  /// Compute the discretized gauge-covariant derivative summed over all directions on the
+  /// configuration U. \param U lattice configuration the derivation is applied on \return object
+  /// of type Path containing the gauge derivative on the lattice configuration
+  Path GaugeDerivative(const Path& U) const;
+
+  /// For each configuration
+  ///
+  /// Call measure on every configuration of the ensemble: the configurations come from fResult
+  /// or, in streaming mode, are read (and smeared, without symmetrization) from the input file,
+  /// one at a time or one per thread, while the following ones are loaded in the background. All the analyses are built on
+  /// this method, so they run in bounded memory in streaming mode. \see SetThreads
+  /// \param measure function called with the index of the configuration and the configuration:
+  /// with several threads, it may be called concurrently on different configurations
+  /// \param directions directions of the links used by measure: in streaming mode, only these
+  /// are read from a file split by direction, and the other links are left as the identity (all
+  /// the directions are read if a smearing or a symmetrization is applied) \see EnsembleLayout
+  /// \param needed flag of the configurations to be measured (empty = all): the others are
+  /// neither smeared nor passed to measure
+  void ForEachConfiguration(const std::function<void(int, const Path&)>& measure,
+                            const std::vector<int>& directions = {0, 1, 2, 3},
+                            const std::vector<char>& needed = {}) const;
+
+  /// Measure each configuration
+  ///
+  /// Measure nvalues quantities on every configuration of the ensemble, and return them
+  /// configuration by configuration. If the measurement cache is enabled, the values already
+  /// stored for the same observable and smearings are read from it, only the other configurations
+  /// are measured, and their values are added to the cache. \see UseMeasurementCache
+  /// \param observable name of the observable: it must change whenever measure does
+  /// \param nvalues number of values measured on each configuration
+  /// \param measure function called with the index of the configuration, the configuration and
+  /// the values to be filled, initially zero
+  /// \param directions directions of the links used by measure \see ForEachConfiguration
+  /// \return values measured on each configuration, in order
+  std::vector<std::vector<double>> MeasureEach(
+      const std::string& observable,
+      int nvalues,
+      const std::function<void(int, const Path&, std::vector<double>&)>& measure,
+      const std::vector<int>& directions = {0, 1, 2, 3}) const;
+
+  /// Measure several observables in one traversal
+  ///
+  /// Measure every observable on every configuration of the ensemble, reading and smearing each
+  /// configuration once and building its Wilson lines once, with the longest lines required by
+  /// the observables, and its plaquette field once, if some observable uses it: the plaquettes
+  /// are computed from the links after the smearing, and a new field is built for every
+  /// configuration, so that no observable ever reads stale plaquettes. As in MeasureEach, the values stored in the measurement cache are read from
+  /// it, and only the configurations missing some observable are read and measured.
+  /// \param measurements observables to be measured
+  /// \return values of each observable on each configuration, in order
+  std::vector<std::vector<std::vector<double>>> MeasureAll(
+      const std::vector<Measurement>& measurements) const;
+
   /// Run the Metropolis algorithm
   ///
   /// Perform a complete run of the Metropolis algorithm and collect the set of configurations in
-  /// the fResult vector
+  /// the slots of fResult, allocated at the start of the run, or stream them to the output set
+  /// with SetOutput. If a stopping rule is set, fNcf is updated to the number of configurations
+  /// actually sampled.
+  /// \see SetStoppingRule
   void RunMetropolis();
 
   /// Randomize the SU3 matrices
@@ -220,6 +659,23 @@ class Metropolis
   /// Fill the fSetOfSU3 set with a set of SU3 random matrices
   void RandomizeSU3();
 
+  /// Total action
+  ///
+  /// Evaluate the action of the whole current configuration fPath, summing each plaquette (and,
+  /// for the improved action, each rectangle) exactly once. \see \ref intro
+  /// \return total action S of fPath
+  double TotalAction() const;
+
+  /// Evaluate a Wilson loop on a generic configuration
+  ///
+  /// Compute a N_mu X N_nu Wilson loop in the plane mu - nu at position x using the
+  /// configuration U. \param N_mu length of the loop in the mu direction in lattice units
+  /// (integer) \param N_nu length of the loop in the nu direction in lattice units (integer) \param
+  /// mu direction of one of the sides of the loop \param nu direction of one of the sides of the
+  /// loop \param x position of one of the corners of the loop \param U path configuration on which
+  /// the loop is evaluated
+  double WilsonLoop(int N_mu, int N_nu, int mu, int nu, const my4Vector& x, const Path& U) const;
+
   /// Evaluate a Wilson loop on a Metropolis configuration
   ///
   /// Compute a N_mu X N_nu Wilson loop in the plane mu - nu  at position x using the j-th
@@ -257,6 +713,58 @@ class Metropolis
   /// Compute the statistical analysis of a predefined type in the enum class Type
   /// \param mytype type of statistical analysis, as defined in the enum class Type
   void ComputeStatistics(Type mytype) const;
+
+  /// Compute statistics of several predefined types
+  ///
+  /// Compute the statistical analyses of several predefined types in a single traversal of the
+  /// ensemble, then print the results of each one. \see MeasureAll
+  /// \param mytypes types of statistical analysis, as defined in the enum class Type
+  void ComputeStatistics(const std::vector<Type>& mytypes) const;
 };
 
+/************************ Template Methods ***************************/
+
+// Sum each slab in its own accumulator, then add the accumulators in slab order
+template <class E>
+typename E::Value Metropolis::SumField(const LatticeField::Field<E>& e) const
+{
+  typedef typename E::Value Value;
+  static_assert(!std::is_same<Value, cx_dmat>::value,
+                "only a field expression with numerical values can be summed");
+  std::vector<int> n = fPath.GetNCells();
+  e.Self().Check(n, nullptr);
+  std::vector<Value> slab_sums(n[0] * n[1], Value(0.));
+  ForEachSlab([&](int i0, int i1) {
+    Value slab_sum = 0.;
+    for (int i2 = 0; i2 < n[2]; i2++) {
+      for (int i3 = 0; i3 < n[3]; i3++) slab_sum += e.Self()(LatticeField::Site(i0, i1, i2, i3, n));
+    }
+    slab_sums[i0 * n[1] + i1] = slab_sum;
+  });
+  Value sum = 0.;
+  for (const Value& slab_sum : slab_sums) sum += slab_sum;
+  return sum;
+}
+
+// Store the value of the expression at each site in the link of that site
+template <class E>
+void Metropolis::AssignField(Path& U, int mu, const LatticeField::Field<E>& e) const
+{
+  static_assert(std::is_same<typename E::Value, cx_dmat>::value,
+                "only a field expression with matrix values can be assigned to the links");
+  std::vector<int> n = fPath.GetNCells();
+  if (U.GetNCells() != n || mu < 0 || mu >= 4) throw 1;
+  e.Self().Check(n, U.GetData());
+  std::complex<double>* data = U.GetData();
+  ForEachSlab([&](int i0, int i1) {
+    for (int i2 = 0; i2 < n[2]; i2++) {
+      for (int i3 = 0; i3 < n[3]; i3++) {
+        const LatticeField::Site site(i0, i1, i2, i3, n);
+        cx_dmat link(data + (site.Index() * 4 + mu) * 9, 3, 3, false, true);
+        link = e.Self()(site);
+      }
+    }
+  });
+}
+
 #endif
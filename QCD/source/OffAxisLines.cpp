@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <armadillo>
+#include <complex>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "LatticeMemory.h"
+#include "my4Vector.h"
+#include "OffAxisLines.h"
+#include "Path.h"
+using namespace arma;
+
+/************************ Constructor ***************************/
+
+// Constructor: list the orderings of the steps of each vector, the paths are computed later
+OffAxisLines::OffAxisLines(std::vector<int> ncells,
+                           std::vector<std::vector<int>> vectors,
+                           int max_length)
+    : fNCells(ncells), fVectors(vectors), fMaxLength(max_length)
+{
+  if (ncells.size() != 4 || max_length < 1) throw 1;
+  for (const std::vector<int>& e : vectors) {
+    if (e.size() != 3) throw 1;
+    std::vector<int> steps;
+    for (int mu = 0; mu < 3; mu++) {
+      for (int k = 0; k < std::abs(e[mu]); k++) steps.push_back(e[mu] > 0 ? mu + 1 : -(mu + 1));
+    }
+    if (steps.empty()) throw 1;
+    std::sort(steps.begin(), steps.end());
+    std::vector<std::vector<int>> orders;
+    do
+      orders.push_back(steps);
+    while (std::next_permutation(steps.begin(), steps.end()));
+    fOrders.push_back(orders);
+  }
+  fBlock = (std::size_t)ncells[0] * ncells[1] * ncells[2] * ncells[3] * max_length * 9;
+  if (!vectors.empty()) fLines = LinkBuffer(fBlock * vectors.size());
+}
+
+/************************ Private Methods ***************************/
+
+// Offset of the path of a given vector and length starting at x
+std::size_t OffAxisLines::Offset(const my4Vector& position, int v, int length) const
+{
+  if (position.GetNCells() != fNCells) throw 1;
+  if (v < 0 || v >= (int)fVectors.size() || length < 1 || length > fMaxLength) throw 1;
+  std::size_t site =
+      ((std::size_t)(position[0] * fNCells[1] + position[1]) * fNCells[2] + position[2]) *
+          fNCells[3] +
+      position[3];
+  return fBlock * v + (site * fMaxLength + length - 1) * 9;
+}
+
+my4Vector OffAxisLines::Shift(const my4Vector& x, int v, int n) const
+{
+  const std::vector<int>& e = fVectors[v];
+  return x.Offset(n * e[0], 0).Offset(n * e[1], 1).Offset(n * e[2], 2);
+}
+
+/************************ Public Methods ***************************/
+
+// Permute the axes and flip the signs of the non-zero components, keeping the vectors whose first
+// non-zero component is positive
+std::vector<std::vector<int>> OffAxisLines::Variants(const std::vector<int>& base)
+{
+  if (base.size() != 3) throw 1;
+  std::vector<int> permutation = base;
+  std::sort(permutation.begin(), permutation.end());
+  std::vector<std::vector<int>> variants;
+  do {
+    for (int signs = 0; signs < 8; signs++) {
+      std::vector<int> e = permutation;
+      for (int mu = 0; mu < 3; mu++)
+        if (signs & (1 << mu)) e[mu] = -e[mu];
+      const auto first = std::find_if(e.begin(), e.end(), [](int c) { return c != 0; });
+      if (first == e.end() || *first < 0) continue;
+      if (std::find(variants.begin(), variants.end(), e) == variants.end()) variants.push_back(e);
+    }
+  } while (std::next_permutation(permutation.begin(), permutation.end()));
+  return variants;
+}
+
+// S_e(x): average over the orderings of the products of the links along the steps
+void OffAxisLines::ComputeUnits(const Path& U, int i0, int i1)
+{
+  if (U.GetNCells() != fNCells) {
+    std::cout << "ERROR: the off-axis paths and the configuration have different dimensions.\n";
+    throw 1;
+  }
+  std::complex<double>* data = fLines.GetData();
+  for (int i2 = 0; i2 < fNCells[2]; i2++) {
+    for (int i3 = 0; i3 < fNCells[3]; i3++) {
+      my4Vector x({i0, i1, i2, i3}, fNCells);
+      for (std::size_t v = 0; v < fVectors.size(); v++) {
+        cx_dmat unit(data + Offset(x, v, 1), 3, 3, false, true);
+        unit.zeros();
+        for (const std::vector<int>& order : fOrders[v]) {
+          cx_dmat product(3, 3, fill::eye);
+          my4Vector y = x;
+          for (int step : order) {
+            const int mu = std::abs(step) - 1;
+            if (step > 0) {
+              product = product * U(y, mu);
+              y = y.Offset(1, mu);
+            } else {
+              y = y.Offset(-1, mu);
+              product = product * U(y, mu).t();
+            }
+          }
+          unit += product;
+        }
+        unit /= (double)fOrders[v].size();
+      }
+    }
+  }
+}
+
+// Extend the path of each site by one unit at a time: L_e(x, n) = L_e(x, n - 1) S_e(x + (n - 1) e)
+void OffAxisLines::ComputeLines(int i0, int i1)
+{
+  std::complex<double>* data = fLines.GetData();
+  for (int i2 = 0; i2 < fNCells[2]; i2++) {
+    for (int i3 = 0; i3 < fNCells[3]; i3++) {
+      my4Vector x({i0, i1, i2, i3}, fNCells);
+      for (std::size_t v = 0; v < fVectors.size(); v++) {
+        for (int length = 2; length <= fMaxLength; length++) {
+          const cx_dmat previous(data + Offset(x, v, length - 1), 3, 3, false, true);
+          const cx_dmat unit(data + Offset(Shift(x, v, length - 1), v, 1), 3, 3, false, true);
+          cx_dmat next(data + Offset(x, v, length), 3, 3, false, true);
+          next = previous * unit;
+        }
+      }
+    }
+  }
+}
+
+// Access to a path: the matrix aliases the memory of the instance
+const cx_dmat OffAxisLines::operator()(const my4Vector& position, int v, int length) const
+{
+  return cx_dmat(const_cast<std::complex<double>*>(fLines.GetData()) + Offset(position, v, length),
+                 3, 3, false, true);
+}
+
+my4Vector OffAxisLines::End(const my4Vector& x, int v, int length) const
+{
+  return Shift(x, v, length);
+}
+
+int OffAxisLines::GetNVectors() const
+{
+  return fVectors.size();
+}
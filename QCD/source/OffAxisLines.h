@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////
+/// \file OffAxisLines.h
+/// \brief Header file for the definition of the class OffAxisLines
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class OffAxisLines. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef OFFAXISLINES_H
+#define OFFAXISLINES_H
+
+#include <armadillo>
+#include <cstddef>
+#include <vector>
+#include "LatticeMemory.h"
+#include "my4Vector.h"
+#include "Path.h"
+using namespace arma;
+
+/// OffAxisLines class
+///
+/// This class holds the spatial paths of links along lattice vectors off the axes, e.g. the planar
+/// diagonal (1, 1, 0) or the space diagonal (1, 1, 1), for every site x and every multiple n of
+/// the vector up to a maximum length. The link of a vector e at x, S_e(x), is the average of the
+/// products of links along all the distinct orderings of the elementary steps of e (2 orderings
+/// for (1, 1, 0), 6 for (1, 1, 1), 3 for (2, 1, 0)), so that no staircase is preferred: the path
+/// of length n is then L_e(x, n) = S_e(x) S_e(x + e) .. S_e(x + (n - 1) e). Combined with the
+/// temporal lines of WilsonLines, the paths give the Wilson loops at the distances n |e|.
+/// \see Metropolis::MeasureAll
+/// The paths are built in two passes over the lattice, OffAxisLines::ComputeUnits and then
+/// OffAxisLines::ComputeLines, each of which may be split in slabs. They are stored in a single
+/// contiguous LinkBuffer, one block per vector: in each block the sites follow the lexicographic
+/// order of Path and the lengths are contiguous for each site.
+class OffAxisLines
+{
+ private:
+  LinkBuffer fLines;                        ///< Paths as a contiguous buffer of 3x3 matrices
+  std::vector<int> fNCells;                 ///< Lattice dimensions in the 4 dimensions
+  std::vector<std::vector<int>> fVectors;   ///< Spatial vector of each path
+  std::vector<std::vector<std::vector<int>>>
+      fOrders;                              ///< Orderings of the steps of each vector, +(mu + 1)
+                                            ///< forward and -(mu + 1) backward
+  int fMaxLength;                           ///< Maximum length of the paths
+  std::size_t fBlock;                       ///< Size of the block of each vector in fLines
+
+  /// Offset
+  ///
+  /// \param x position 4-vector of the first end of the path
+  /// \param v index of the vector of the path
+  /// \param length length of the path, in units of the vector
+  /// \return offset of the first element of the path in fLines
+  std::size_t Offset(const my4Vector& x, int v, int length) const;
+
+  /// \param x position 4-vector \param v index of a vector \param n multiple of the vector
+  /// \return position 4-vector x + n e_v
+  my4Vector Shift(const my4Vector& x, int v, int n) const;
+
+ public:
+  OffAxisLines() = delete;
+
+  /// Constructor
+  ///
+  /// Allocate the paths of a lattice, which are computed by OffAxisLines::ComputeUnits and
+  /// OffAxisLines::ComputeLines.
+  /// \param ncells vector containing the lattice dimensions in the 4 dimensions
+  /// \param vectors spatial vectors of the paths, with 3 components each in the directions 0, 1, 2
+  /// \param max_length maximum length of the paths, in units of their vector
+  OffAxisLines(std::vector<int> ncells, std::vector<std::vector<int>> vectors, int max_length);
+
+  /// Equivalent vectors
+  ///
+  /// \param base spatial vector with 3 non-negative components
+  /// \return the vectors obtained from base by the permutations of the axes and the reflections,
+  /// one for each pair e, -e, since a Wilson loop and its reflection have the same value
+  static std::vector<std::vector<int>> Variants(const std::vector<int>& base);
+
+  /// Compute the units on a slab
+  ///
+  /// Compute the averaged links S_e(x) of every vector at the sites with given x_0 and x_1.
+  /// \param U path configuration, with the lattice dimensions of the instance
+  /// \param i0 coordinate x_0 of the slab
+  /// \param i1 coordinate x_1 of the slab
+  void ComputeUnits(const Path& U, int i0, int i1);
+
+  /// Compute the paths on a slab
+  ///
+  /// Compute the paths of every vector and length at the sites with given x_0 and x_1, from the
+  /// units: OffAxisLines::ComputeUnits must have been called on every slab before.
+  /// \param i0 coordinate x_0 of the slab
+  /// \param i1 coordinate x_1 of the slab
+  void ComputeLines(int i0, int i1);
+
+  /// () overloading
+  ///
+  /// \param x position 4-vector of the first end of the path
+  /// \param v index of the vector of the path
+  /// \param length length of the path, between 1 and the maximum length
+  /// \return 3x3 matrix of the path, which aliases the memory of the instance
+  const cx_dmat operator()(const my4Vector& x, int v, int length) const;
+
+  /// \param x position 4-vector \param v index of a vector \param length length of the path
+  /// \return position 4-vector of the second end of the path, x + length e_v
+  my4Vector End(const my4Vector& x, int v, int length) const;
+
+  /// \return number of vectors
+  int GetNVectors() const;
+};
+
+#endif
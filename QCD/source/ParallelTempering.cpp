@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "BackgroundWriter.h"
+#include "LatticeMemory.h"
+#include "Metropolis.h"
+#include "ParallelTempering.h"
+
+/************************ Private Methods ***************************/
+
+// Coupling multiplying the action of the m-th member
+double ParallelTempering::Coupling(int m) const
+{
+  return fMembers[m]->fImproved ? fMembers[m]->fBetaTilde : fMembers[m]->fBeta;
+}
+
+// Wait for each step, run it and report its end, until the stop
+void ParallelTempering::Work(int m)
+{
+  LatticeMemory::PinCurrentThread(m);
+  std::uint64_t step = 0;
+  std::unique_lock<std::mutex> lock(fMutex);
+  while (true) {
+    fStart.wait(lock, [this, step]() { return fStop || fStep != step; });
+    if (fStop) return;
+    step = fStep;
+    lock.unlock();
+    RunStep(m);
+    lock.lock();
+    if (--fPending == 0) fDone.notify_one();
+  }
+}
+
+// The workers only touch their own member: the actions and the acceptance ratios are read after
+// the step
+void ParallelTempering::RunStep(int m)
+{
+  if (fPlacing) {
+    fMembers[m]->PlaceMemory();
+    return;
+  }
+  fAcceptance[m] = fMembers[m]->UpdateCurrentPath();
+  fActions[m] = fMembers[m]->TotalAction() / Coupling(m);
+}
+
+// Publish the step to the workers, take part in it and wait for the others
+void ParallelTempering::Step()
+{
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStep++;
+    fPending = fWorkers.size();
+  }
+  fStart.notify_all();
+  RunStep(0);
+  std::unique_lock<std::mutex> lock(fMutex);
+  fDone.wait(lock, [this]() { return fPending == 0; });
+}
+
+// Stop the workers once the current step is over
+void ParallelTempering::StopWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStop = true;
+  }
+  fStart.notify_all();
+  for (std::thread& worker : fWorkers) worker.join();
+  fWorkers.clear();
+}
+
+// First touch of the memory of each member from its own worker
+void ParallelTempering::PlaceAll()
+{
+  fPlacing = true;
+  Step();
+  fPlacing = false;
+}
+
+// Update each member on its own worker
+double ParallelTempering::UpdateAll()
+{
+  Step();
+  return fAcceptance[fChain[0]];
+}
+
+// Propose the swaps between neighbouring replicas (k, k+1) with k of the given parity: the
+// configurations stay with their members, which exchange their couplings instead
+void ParallelTempering::ProposeSwaps(int parity)
+{
+  std::uniform_real_distribution<> uni_01(0.0, 1.0);
+  for (unsigned int k = parity; k + 1 < fChain.size(); k += 2) {
+    const int m = fChain[k], n = fChain[k + 1];
+    double exponent = (Coupling(m) - Coupling(n)) * (fActions[m] - fActions[n]);
+    fSwapProposed[k]++;
+    if ((exponent > 0) || (std::exp(exponent) > uni_01(fGenerator))) {
+      std::swap(fMembers[m]->fBeta, fMembers[n]->fBeta);
+      std::swap(fMembers[m]->fBetaTilde, fMembers[n]->fBetaTilde);
+      std::swap(fChain[k], fChain[k + 1]);
+      fSwapAccepted[k]++;
+    }
+  }
+}
+
+/************************ Public Methods ***************************/
+
+// Constructor: the replicas are copies of the target at lower beta values
+ParallelTempering::ParallelTempering(Metropolis& target, int Nreplicas, double beta_step)
+    : fTarget(target)
+    , fActions(Nreplicas, 0.)
+    , fAcceptance(Nreplicas, 0.)
+    , fSwapProposed(Nreplicas, 0)
+    , fSwapAccepted(Nreplicas, 0)
+    , fGenerator(std::random_device()())
+    , fStep(0)
+    , fPending(0)
+    , fPlacing(false)
+    , fStop(false)
+{
+  if (Nreplicas < 1) throw 1;
+  for (int k = 1; k < Nreplicas; k++) {
+    double beta_k = target.fBeta - k * beta_step;
+    if (beta_k <= 0.) {
+      std::cout << "ERROR: non-positive beta in the parallel tempering replicas.\n";
+      throw 1;
+    }
+    fReplicas.push_back(target);
+    fReplicas.back().fBetaTilde = target.fBetaTilde * beta_k / target.fBeta;
+    fReplicas.back().fBeta = beta_k;
+    fReplicas.back().fResult = Ensemble();  // only the target replica stores the ensemble
+  }
+  fMembers.push_back(&fTarget);
+  for (auto& replica : fReplicas) fMembers.push_back(&replica);
+  for (int m = 0; m < Nreplicas; m++) fChain.push_back(m);
+}
+
+// Destructor
+ParallelTempering::~ParallelTempering()
+{
+  StopWorkers();
+}
+
+// Run the replica-exchange algorithm: same structure as Metropolis::RunMetropolis, with every
+// single update replaced by a parallel update of all the replicas followed by the swap proposals
+void ParallelTempering::Run()
+{
+  LatticeMemory::PinCurrentThread(0);
+  fStop = false;
+  for (unsigned int m = 1; m < fMembers.size(); m++)
+    fWorkers.emplace_back(&ParallelTempering::Work, this, m);
+  PlaceAll();
+  fTarget.AllocateResult();  // from the calling thread, which updates the target
+  std::cout << "Randomization of the SU3 matrices...\n";
+  for (auto member : fMembers) member->RandomizeSU3();
+  std::cout << "Parallel tempering is running with " << fChain.size() << " replicas, beta = ";
+  for (int m : fChain) std::cout << fMembers[m]->fBeta << " ";
+  std::cout << "\nGrid thermalization...\nProgress %: " << std::flush;
+  const int Ncorr = fTarget.fNcorr;
+  const int Ncf = fTarget.fNcf;
+  double avg = 0.0;
+  int counter = 0;
+  int step = 0;
+
+  // thermalize all the replicas: after Metropolis::Resume, the target starts from the resumed path,
+  // but the other replicas still need to reach their own beta
+  for (int i = 0; i < 10 * Ncorr; i++) {
+    fTarget.PrintStatus(i, 10 * Ncorr);
+    UpdateAll();
+    ProposeSwaps(step++ % 2);
+  }
+  std::cout << "Generating configurations...\nProgress %: " << std::flush;
+  fTarget.fTargetSeries.assign(fTarget.fTargetError > 0. ? fTarget.fTargetLoops.size() : 0,
+                               std::vector<double>());
+  fTarget.fStartTime = std::chrono::steady_clock::now();
+  int sampled = 0;
+  for (int i = 0; i < Ncf; i++) {
+    fTarget.PrintStatus(i, Ncf);
+    const Path& path = fMembers[fChain[0]]->fPath;  // current path at the target beta
+    fTarget.StoreConfiguration(i, path);
+    sampled++;
+    if (fTarget.CheckStopping(sampled, path) && sampled < Ncf) break;
+    for (int j = 0; j < Ncorr; j++) {
+      avg += UpdateAll();
+      ProposeSwaps(step++ % 2);
+      counter++;
+    }
+  }
+  StopWorkers();
+  // Give the target beta, with its configuration, back to the target instance
+  Metropolis& holder = *fMembers[fChain[0]];
+  if (&holder != &fTarget) {
+    std::swap(holder.fPath, fTarget.fPath);
+    std::swap(holder.fBeta, fTarget.fBeta);
+    std::swap(holder.fBetaTilde, fTarget.fBetaTilde);
+    std::swap(fChain[0], *std::find(fChain.begin(), fChain.end(), 0));
+  }
+  if (sampled < Ncf) std::cout << std::endl;
+  if (fTarget.fOutput != nullptr && sampled == Ncf) fTarget.fOutput->Checkpoint(fTarget.fPath);
+  fTarget.fNcf = sampled;
+
+  std::cout << "Parallel tempering has finished. The avg acceptance level at the target beta is: "
+            << (counter > 0 ? avg / counter : 0.) << std::endl;
+  if (!fTarget.fStopReason.empty())
+    std::cout << "Generation stopped after " << sampled << " configurations: "
+              << fTarget.fStopReason << std::endl;
+  fTarget.PrintTargetEstimates();
+  PrintSwapRates();
+}
+
+// Print the swap acceptance ratios
+void ParallelTempering::PrintSwapRates() const
+{
+  std::cout << "Swap acceptance ratios between neighbouring replicas:\n";
+  for (unsigned int k = 0; k + 1 < fChain.size(); k++) {
+    std::cout << "  beta " << fMembers[fChain[k]]->fBeta << " <-> "
+              << fMembers[fChain[k + 1]]->fBeta << " : "
+              << (fSwapProposed[k] > 0 ? (double)fSwapAccepted[k] / fSwapProposed[k] : 0.)
+              << std::endl;
+  }
+}
+
+// Print the placement of the memory of each replica
+void ParallelTempering::PrintMemoryReport() const
+{
+  for (unsigned int m = 0; m < fMembers.size(); m++)
+    fMembers[m]->PrintMemoryReport("Replica " + std::to_string(m));
+}
@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////
+/// \file ParallelTempering.h
+/// \brief Header file for the definition of the class ParallelTempering
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class ParallelTempering. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef PARALLELTEMPERING_H
+#define PARALLELTEMPERING_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Metropolis.h"
+
+/// ParallelTempering class
+///
+/// The instances of this class implement a replica-exchange (parallel tempering) version of
+/// Metropolis::RunMetropolis. A set of replicas of the target Metropolis instance is run at
+/// decreasing values of beta, each replica being updated with Metropolis::UpdateCurrentPath by its
+/// own worker thread, started once for the whole run. After each update, swaps of the
+/// configurations between neighbouring replicas are proposed and accepted with probability
+/// \f[P=\min\left(1, e^{(\beta_k-\beta_{k+1})(s_k-s_{k+1})}\right)\f]
+/// where \f$s_k=S_k/\beta_k\f$ is the total action of the k-th replica per unit coupling
+/// (\f$\tilde{\beta}\f$ takes the place of \f$\beta\f$ for the improved action). An accepted swap
+/// exchanges the couplings of the two replicas, while each configuration stays in the memory of
+/// its worker. The replica at the original beta provides the Montecarlo ensemble, which is
+/// stored by the target Metropolis instance.
+class ParallelTempering
+{
+ private:
+  Metropolis& fTarget;                ///< Target Metropolis instance, which collects the ensemble
+  std::vector<Metropolis> fReplicas;  ///< Additional replicas, initially at lower beta values
+  std::vector<Metropolis*> fMembers;  ///< Replicas in the order of their workers: fMembers[0] =
+                                      ///< &fTarget, updated by the calling thread
+  std::vector<int> fChain;            ///< Members ordered by decreasing beta: fChain[0] is the
+                                      ///< member at the target beta
+  std::vector<double> fActions;       ///< Total action per unit coupling of each member
+  std::vector<double> fAcceptance;    ///< Acceptance ratio of the last update of each member
+  std::vector<int> fSwapProposed;     ///< Number of proposed swaps for each neighbouring pair
+  std::vector<int> fSwapAccepted;     ///< Number of accepted swaps for each neighbouring pair
+  std::mt19937_64 fGenerator;         ///< Generator used in the swap acceptance test
+  std::vector<std::thread> fWorkers;  ///< Workers of the members 1, 2, ..
+  std::mutex fMutex;                  ///< Mutex protecting the fields below
+  std::condition_variable fStart;     ///< Signals a new step, or the stop, to the workers
+  std::condition_variable fDone;      ///< Signals the end of the step of a worker
+  std::uint64_t fStep;                ///< Number of steps started so far
+  int fPending;                       ///< Number of workers still busy with the current step
+  bool fPlacing;                      ///< True if the current step places the memory
+  bool fStop;                         ///< True when the workers have to exit
+
+  /// Coupling of a member
+  ///
+  /// \param m index of the member in fMembers
+  /// \return beta_tilde for the improved action, beta otherwise
+  double Coupling(int m) const;
+
+  /// Body of the workers
+  ///
+  /// The worker of the m-th member is pinned to the m-th CPU when the thread pinning is enabled,
+  /// then runs its share of each step until the stop. \see LatticeMemory::PinCurrentThread
+  /// \param m index of the member in fMembers
+  void Work(int m);
+
+  /// Share of a step of the m-th member: place its memory, or update it and evaluate its action
+  /// \param m index of the member in fMembers
+  void RunStep(int m);
+
+  /// Run a step on all the members, the target one on the calling thread, and wait for the end of
+  /// the step on every worker
+  void Step();
+
+  /// Stop and join the workers
+  void StopWorkers();
+
+  /// Place the memory of the members
+  ///
+  /// Run Metropolis::PlaceMemory on each member from the worker which will update it, so that
+  /// every member is stored on the NUMA node of its worker.
+  void PlaceAll();
+
+  /// Update all the members
+  ///
+  /// Run one Metropolis::UpdateCurrentPath on each member, each on its own worker, and evaluate
+  /// the total actions needed by the swap proposals.
+  /// \return acceptance ratio of the update at the target beta
+  double UpdateAll();
+
+  /// Propose swaps
+  ///
+  /// Propose the exchange of the configurations between the neighbouring replicas (k, k+1) of
+  /// fChain with k of the given parity, so that even and odd pairs alternate in subsequent calls.
+  /// An accepted swap exchanges the couplings of the two members and their places in fChain, so
+  /// that no link is copied.
+  /// \param parity parity (0 or 1) of the first replica of the pairs
+  void ProposeSwaps(int parity);
+
+ public:
+  ParallelTempering() = delete;
+
+  /// Constructor
+  ///
+  /// \param target Metropolis instance at the target beta, which will store the ensemble
+  /// \param Nreplicas total number of replicas, including the target one
+  /// \param beta_step difference between the beta values of neighbouring replicas: the k-th
+  /// replica runs at beta-k*beta_step, beta_tilde being rescaled by the same factor
+  ParallelTempering(Metropolis& target, int Nreplicas, double beta_step);
+
+  /// Destructor: stop the workers, if they are still running
+  ~ParallelTempering();
+
+  /// Run the parallel tempering
+  ///
+  /// Perform a complete run of the replica-exchange algorithm and collect the set of
+  /// configurations at the target beta in the fResult pool of the target Metropolis instance.
+  /// At the end, the target instance holds again the target beta and its last configuration.
+  /// \see Metropolis::RunMetropolis
+  void Run();
+
+  /// Print the swap acceptance ratio of each neighbouring pair on standard output
+  void PrintSwapRates() const;
+
+  /// Print on standard output where the memory of each replica actually landed
+  void PrintMemoryReport() const;
+};
+
+#endif
@@ -1,41 +1,54 @@
 #include <armadillo>
 #include <complex>
+#include <cstddef>
 #include <iostream>
 #include <string>
 #include <vector>
+#include "LatticeMemory.h"
 #include "my4Vector.h"
 #include "Path.h"
 using namespace arma;
 
+// Offset of the matrix at (x, mu) in the contiguous storage
+std::size_t Path::Offset(const my4Vector& position, int mu) const
+{
+  if (position.GetNCells() != fNCells) throw 1;
+  if (mu < 0 || mu >= 4) throw 1;
+  std::size_t site =
+      ((std::size_t)(position[0] * fNCells[1] + position[1]) * fNCells[2] + position[2]) *
+          fNCells[3] +
+      position[3];
+  return (site * 4 + mu) * 9;
+}
+
+// Fill every link with the identity
+void Path::FillIdentity()
+{
+  std::complex<double>* data = fLinks.GetData();
+  for (std::size_t link = 0; link < fLinks.GetSize() / 9; link++) {
+    for (int k = 0; k < 9; k++) data[9 * link + k] = (k % 4 == 0) ? 1. : 0.;
+  }
+}
+
 // Constructor
 Path::Path(std::vector<int> ncells) : fNCells(ncells)
 {
   if (ncells.size() != 4) throw 1;
-  cx_dmat Identity(3, 3, fill::eye);
-  std::vector<cx_dmat> lorentz;
-  std::vector<std::vector<cx_dmat>> z_space;
-  std::vector<std::vector<std::vector<cx_dmat>>> y_space;
-  std::vector<std::vector<std::vector<std::vector<cx_dmat>>>> x_space;
-  for (int mu = 0; mu < 4; mu++) lorentz.push_back(Identity);
-  for (int i3 = 0; i3 < ncells[3]; i3++) z_space.push_back(lorentz);
-  for (int i2 = 0; i2 < ncells[2]; i2++) y_space.push_back(z_space);
-  for (int i1 = 0; i1 < ncells[1]; i1++) x_space.push_back(y_space);
-  for (int i0 = 0; i0 < ncells[0]; i0++) fPath.push_back(x_space);
+  fLinks = LinkBuffer((std::size_t)ncells[0] * ncells[1] * ncells[2] * ncells[3] * 4 * 9);
+  FillIdentity();
+}
+
+// View constructor on external memory
+Path::Path(std::vector<int> ncells, std::complex<double>* data) : fNCells(ncells)
+{
+  if (ncells.size() != 4) throw 1;
+  fLinks = LinkBuffer(data, (std::size_t)ncells[0] * ncells[1] * ncells[2] * ncells[3] * 4 * 9);
 }
 
 // Default constructor
-Path::Path() : fNCells({1, 1, 1, 1})
+Path::Path() : fLinks(4 * 9), fNCells({1, 1, 1, 1})
 {
-  cx_dmat Identity(3, 3, fill::eye);
-  std::vector<cx_dmat> lorentz;
-  std::vector<std::vector<cx_dmat>> z_space;
-  std::vector<std::vector<std::vector<cx_dmat>>> y_space;
-  std::vector<std::vector<std::vector<std::vector<cx_dmat>>>> x_space;
-  lorentz.push_back(Identity);
-  z_space.push_back(lorentz);
-  y_space.push_back(z_space);
-  x_space.push_back(y_space);
-  fPath.push_back(x_space);
+  FillIdentity();
 }
 
 // Destructor
@@ -47,19 +60,9 @@ Path::~Path()
 void Path::Reshape(std::vector<int> ncells)
 {
   if (ncells.size() != 4) throw 1;
-  cx_dmat Identity(3, 3, fill::eye);
-  std::vector<std::vector<std::vector<std::vector<std::vector<cx_dmat>>>>> temporary;
-  std::vector<cx_dmat> lorentz;
-  std::vector<std::vector<cx_dmat>> z_space;
-  std::vector<std::vector<std::vector<cx_dmat>>> y_space;
-  std::vector<std::vector<std::vector<std::vector<cx_dmat>>>> x_space;
-  for (int mu = 0; mu < 4; mu++) lorentz.push_back(Identity);
-  for (int i3 = 0; i3 < ncells[3]; i3++) z_space.push_back(lorentz);
-  for (int i2 = 0; i2 < ncells[2]; i2++) y_space.push_back(z_space);
-  for (int i1 = 0; i1 < ncells[1]; i1++) x_space.push_back(y_space);
-  for (int i0 = 0; i0 < ncells[0]; i0++) temporary.push_back(x_space);
-  fPath = temporary;
+  fLinks = LinkBuffer((std::size_t)ncells[0] * ncells[1] * ncells[2] * ncells[3] * 4 * 9);
   fNCells = ncells;
+  FillIdentity();
 }
 
 // Get lattice dimensions
@@ -71,21 +74,31 @@ std::vector<int> Path::GetNCells() const
 // Access to a lattice element
 cx_dmat Path::operator()(const my4Vector& position, int mu) const
 {
-  bool condition = false;
-  for (int i = 0; i < 4; i++) condition = condition || (position.GetNCells()[i] != fNCells[i]);
-  if (condition) throw 1;
-  int n0 = position[0], n1 = position[1], n2 = position[2], n3 = position[3];
-  return fPath[n0][n1][n2][n3][mu];
+  return cx_dmat(fLinks.GetData() + Offset(position, mu), 3, 3);
 }
 
-// Access/Set lattice element
-cx_dmat& Path::Set(const my4Vector& position, int mu)
+// Access/Set lattice element: the returned matrix aliases the lattice memory
+cx_dmat Path::Set(const my4Vector& position, int mu)
 {
-  bool condition = false;
-  for (int i = 0; i < 4; i++) condition = condition || (position.GetNCells()[i] != fNCells[i]);
-  if (condition) throw 1;
-  int n0 = position[0], n1 = position[1], n2 = position[2], n3 = position[3];
-  return fPath[n0][n1][n2][n3][mu];
+  return cx_dmat(fLinks.GetData() + Offset(position, mu), 3, 3, false, true);
+}
+
+// Access to the contiguous storage
+std::complex<double>* Path::GetData()
+{
+  return fLinks.GetData();
+}
+const std::complex<double>* Path::GetData() const
+{
+  return fLinks.GetData();
+}
+std::size_t Path::GetSize() const
+{
+  return fLinks.GetSize();
+}
+const LinkBuffer& Path::GetBuffer() const
+{
+  return fLinks;
 }
 
 // Print path on screen: it prints the matrix determinant, too, as a check
@@ -97,10 +110,11 @@ void Path::Print() const
       for (int i2 = 0; i2 < fNCells[2]; i2++) {
         for (int i3 = 0; i3 < fNCells[3]; i3++) {
           for (int mu = 0; mu < 4; mu++) {
+            my4Vector x({i0, i1, i2, i3}, fNCells);
             std::cout << "***************\n";
             std::cout << "{" << i0 << ", " << i1 << ", " << i2 << ", " << i3 << ", " << mu << "}\n";
-            fPath[i0][i1][i2][i3][mu].print();
-            std::cout << det(fPath[i0][i1][i2][i3][mu]) << std::endl;
+            (*this)(x, mu).print();
+            std::cout << det((*this)(x, mu)) << std::endl;
             std::cout << endl;
           }
         }
@@ -108,4 +122,4 @@ void Path::Print() const
     }
   }
   std::cout << "#########################################################\n\n";
-}
\ No newline at end of file
+}
@@ -11,7 +11,9 @@
 
 #include <armadillo>
 #include <complex>
+#include <cstddef>
 #include <vector>
+#include "LatticeMemory.h"
 #include "my4Vector.h"
 using namespace arma;
 
@@ -22,13 +24,22 @@ using namespace arma;
 /// Periodic boundary conditions are built in thanks to the interface with my4Vector class.
 /// Access and set methods are implemented so as to simplify the notations in
 /// calculations of functions of the lattice sites.
+/// The link variables are stored in a single contiguous LinkBuffer: the sites follow the
+/// lexicographic order (i0 slowest, i3 fastest), the 4 polarizations are contiguous for each
+/// site and each 3x3 matrix is stored in the column-major order of Armadillo.
 class Path
 {
  private:
-  std::vector<std::vector<std::vector<std::vector<std::vector<cx_dmat>>>>>
-      fPath;  ///< Lattice configuration stored as a 5D vector of Armadillo 3x3 complex matrices
+  LinkBuffer fLinks;         ///< Lattice configuration stored as a contiguous buffer of 3x3 matrices
   std::vector<int> fNCells;  ///< Vector containing the lattice dimensions in the 4 dimensions
 
+  /// Offset
+  ///
+  /// \param x position 4-vector
+  /// \param mu polarization direction
+  /// \return offset of the first element of the matrix at (x, mu) in fLinks
+  std::size_t Offset(const my4Vector& x, int mu) const;
+
  public:
   /// Path constructor
   ///
@@ -36,11 +47,29 @@ class Path
   /// \param ncells vector containing the lattice dimensions in the 4 dimensions
   Path(std::vector<int> ncells);
 
+  /// Path view constructor
+  ///
+  /// Build a lattice of dimensions specified in ncells on top of external memory, which is
+  /// neither initialized nor owned: assignments to the view write on that memory, while copies of
+  /// the view are ordinary Path instances. \see Ensemble
+  /// \param ncells vector containing the lattice dimensions in the 4 dimensions
+  /// \param data external memory with room for 36 complex numbers per lattice site
+  Path(std::vector<int> ncells, std::complex<double>* data);
+
   /// Default Path constructor
   ///
   /// Initialize with a 3x3 identity matrix a lattice with a single site.
   Path();
 
+  /// Copy and move constructors
+  Path(const Path&) = default;
+  Path(Path&&) = default;
+
+  /// Copy and move assignments: copying between paths of equal dimensions reuses the memory of
+  /// the left hand side, so that no allocation occurs and the NUMA placement is preserved
+  Path& operator=(const Path&) = default;
+  Path& operator=(Path&&) = default;
+
   /// Destructor
   ~Path();
 
@@ -54,6 +83,9 @@ class Path
   /// \return fNCells
   std::vector<int> GetNCells() const;
 
+  /// Fill the lattice with 3x3 identity matrices
+  void FillIdentity();
+
   /// () overloading
   ///
   /// Overloading of the () operator to access to the complex matrix of a given position and
@@ -65,10 +97,22 @@ class Path
   ///
   /// Method to set/acces the complex matrix at a given position and polarization on the lattice. In
   /// order to use this method to set, its application should occur on the left of an assignment
-  /// operator, using the returned reference: this aims at improving the code appearence in complex
-  /// calculations. \param x position 4-vector \param mu polarization direction \return 3x3 matrix
-  /// in the given site and polarization of the lattice
-  cx_dmat& Set(const my4Vector& x, int mu);
+  /// operator, using the returned matrix, which aliases the memory of the lattice: this aims at
+  /// improving the code appearence in complex calculations. \param x position 4-vector \param mu
+  /// polarization direction \return 3x3 matrix in the given site and polarization of the lattice
+  cx_dmat Set(const my4Vector& x, int mu);
+
+  /// \return pointer to the contiguous storage of the link variables
+  std::complex<double>* GetData();
+
+  /// \return pointer to the contiguous storage of the link variables
+  const std::complex<double>* GetData() const;
+
+  /// \return number of complex elements in the storage, i.e. 36 per lattice site
+  std::size_t GetSize() const;
+
+  /// \return the buffer storing the link variables
+  const LinkBuffer& GetBuffer() const;
 
   /// Print
   ///
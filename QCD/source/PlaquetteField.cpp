@@ -0,0 +1,109 @@
+#include <armadillo>
+#include <complex>
+#include <cstddef>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "LatticeMemory.h"
+#include "my4Vector.h"
+#include "Path.h"
+#include "PlaquetteField.h"
+using namespace arma;
+
+/************************ Constructor ***************************/
+
+// Constructor: the plaquettes are computed later, by Compute
+PlaquetteField::PlaquetteField(std::vector<int> ncells, bool allocate)
+    : fNCells(ncells), fValid(false)
+{
+  if (ncells.size() != 4) throw 1;
+  if (allocate)
+    fPlaquettes = LinkBuffer((std::size_t)ncells[0] * ncells[1] * ncells[2] * ncells[3] * 6 * 9);
+}
+
+/************************ Private Methods ***************************/
+
+// Offset of the plaquette of the plane mu-nu at x: the planes of a site are contiguous
+std::size_t PlaquetteField::Offset(const my4Vector& position, int mu, int nu) const
+{
+  if (position.GetNCells() != fNCells) throw 1;
+  if (mu < 0 || nu >= 4 || mu >= nu) throw 1;
+  static const int planes[3][4] = {{-1, 0, 1, 2}, {-1, -1, 3, 4}, {-1, -1, -1, 5}};
+  std::size_t site =
+      ((std::size_t)(position[0] * fNCells[1] + position[1]) * fNCells[2] + position[2]) *
+          fNCells[3] +
+      position[3];
+  return (site * 6 + planes[mu][nu]) * 9;
+}
+
+/************************ Public Methods ***************************/
+
+// Compute the plaquettes slab by slab
+void PlaquetteField::Compute(const Path& U)
+{
+  for (int i0 = 0; i0 < fNCells[0]; i0++) {
+    for (int i1 = 0; i1 < fNCells[1]; i1++) Compute(U, i0, i1);
+  }
+  Validate();
+}
+
+// P_mu,nu(x) = U(x, mu) U(x + mu, nu) [U(x, nu) U(x + nu, mu)]^dagger
+void PlaquetteField::Compute(const Path& U, int i0, int i1)
+{
+  if (U.GetNCells() != fNCells) {
+    std::cout << "ERROR: the plaquette field and the configuration have different dimensions.\n";
+    throw 1;
+  }
+  if (fPlaquettes.GetSize() == 0) throw 1;
+  std::complex<double>* data = fPlaquettes.GetData();
+  for (int i2 = 0; i2 < fNCells[2]; i2++) {
+    for (int i3 = 0; i3 < fNCells[3]; i3++) {
+      my4Vector x({i0, i1, i2, i3}, fNCells);
+      for (int mu = 0; mu < 4; mu++) {
+        for (int nu = mu + 1; nu < 4; nu++) {
+          cx_dmat plaquette(data + Offset(x, mu, nu), 3, 3, false, true);
+          plaquette = U(x, mu) * U(x.Offset(1, mu), nu) * (U(x, nu) * U(x.Offset(1, nu), mu)).t();
+        }
+      }
+    }
+  }
+}
+
+void PlaquetteField::Validate()
+{
+  fValid = true;
+}
+
+void PlaquetteField::Invalidate()
+{
+  fValid = false;
+}
+
+bool PlaquetteField::IsValid() const
+{
+  return fValid;
+}
+
+// Access to a plaquette: the opposite orientation is the hermitian conjugate
+cx_dmat PlaquetteField::operator()(const my4Vector& position, int mu, int nu) const
+{
+  if (!fValid) {
+    std::cout << "ERROR: the plaquette field is not computed for the current links.\n";
+    throw 1;
+  }
+  if (mu > nu) return (*this)(position, nu, mu).t();
+  std::complex<double>* data = const_cast<std::complex<double>*>(fPlaquettes.GetData());
+  return cx_dmat(data + Offset(position, mu, nu), 3, 3, false, true);
+}
+
+// Re tr P_mu,nu(x) = Re tr P_nu,mu(x), read from the diagonal without copying the matrix
+double PlaquetteField::RealTrace(const my4Vector& position, int mu, int nu) const
+{
+  if (!fValid) {
+    std::cout << "ERROR: the plaquette field is not computed for the current links.\n";
+    throw 1;
+  }
+  if (mu > nu) std::swap(mu, nu);
+  const std::complex<double>* plaquette = fPlaquettes.GetData() + Offset(position, mu, nu);
+  return plaquette[0].real() + plaquette[4].real() + plaquette[8].real();
+}
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////
+/// \file PlaquetteField.h
+/// \brief Header file for the definition of the class PlaquetteField
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class PlaquetteField. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef PLAQUETTEFIELD_H
+#define PLAQUETTEFIELD_H
+
+#include <armadillo>
+#include <cstddef>
+#include <vector>
+#include "LatticeMemory.h"
+#include "my4Vector.h"
+#include "Path.h"
+using namespace arma;
+
+/// PlaquetteField class
+///
+/// This class holds the plaquettes P_mu,nu(x) = U(x, mu) U(x + mu, nu) U(x + nu, mu)^dagger
+/// U(x, nu)^dagger of every site x in the 6 planes mu < nu, computed once per configuration and
+/// shared by all the observables built on the plaquettes. \see Metropolis::MeasureAll
+/// The plaquettes are stored in a single contiguous LinkBuffer: the sites follow the lexicographic
+/// order of Path, the 6 planes of a site are contiguous, in the order 0-1, 0-2, 0-3, 1-2, 1-3,
+/// 2-3, and each 3x3 matrix is stored in the column-major order of Armadillo.
+/// The plaquettes are valid only for the links they were computed from: if the links change, e.g.
+/// by a smearing, they are invalid until PlaquetteField::Compute is called again.
+class PlaquetteField
+{
+ private:
+  LinkBuffer fPlaquettes;    ///< Plaquettes as a contiguous buffer of 3x3 matrices
+  std::vector<int> fNCells;  ///< Vector containing the lattice dimensions in 4 dimensions
+  bool fValid;               ///< True if the plaquettes are computed for the current links
+
+  /// Offset
+  ///
+  /// \param x position 4-vector of the site
+  /// \param mu first direction of the plane \param nu second direction of the plane, mu < nu
+  /// \return offset of the first element of the plaquette in fPlaquettes
+  std::size_t Offset(const my4Vector& x, int mu, int nu) const;
+
+ public:
+  PlaquetteField() = delete;
+
+  /// Constructor
+  ///
+  /// Allocate the plaquettes of a lattice, which are computed by PlaquetteField::Compute.
+  /// \param ncells vector containing the lattice dimensions in the 4 dimensions
+  /// \param allocate false to create an empty instance, for the measurements without plaquettes
+  PlaquetteField(std::vector<int> ncells, bool allocate = true);
+
+  /// Compute
+  ///
+  /// Compute the plaquettes of every site and plane.
+  /// \param U path configuration, with the lattice dimensions of the instance
+  void Compute(const Path& U);
+
+  /// Compute on a slab
+  ///
+  /// Compute the plaquettes of the sites with given x_0 and x_1 only, so that different slabs may
+  /// be computed concurrently: the instance is valid once every slab has been computed and
+  /// PlaquetteField::Validate has been called. \see Metropolis::ForEachSlab
+  /// \param U path configuration, with the lattice dimensions of the instance
+  /// \param i0 coordinate x_0 of the slab
+  /// \param i1 coordinate x_1 of the slab
+  void Compute(const Path& U, int i0, int i1);
+
+  /// Mark the plaquettes as computed for the current links
+  void Validate();
+
+  /// Mark the plaquettes as invalid, e.g. because the links they were computed from are modified
+  void Invalidate();
+
+  /// \return fValid
+  bool IsValid() const;
+
+  /// () overloading
+  ///
+  /// \param x position 4-vector of the site
+  /// \param mu first direction \param nu second direction, different from mu
+  /// \return 3x3 matrix of the plaquette P_mu,nu(x); for mu > nu, it is the plaquette of the
+  /// opposite orientation, P_nu,mu(x)^dagger. An error is raised if the plaquettes are not valid
+  cx_dmat operator()(const my4Vector& x, int mu, int nu) const;
+
+  /// Real trace
+  ///
+  /// \param x position 4-vector of the site
+  /// \param mu first direction \param nu second direction, different from mu
+  /// \return Re tr P_mu,nu(x), which does not depend on the orientation
+  double RealTrace(const my4Vector& x, int mu, int nu) const;
+};
+
+#endif
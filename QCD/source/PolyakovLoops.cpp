@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <armadillo>
+#include <complex>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include "my4Vector.h"
+#include "Path.h"
+#include "PolyakovLoops.h"
+using namespace arma;
+
+/************************ Constructor ***************************/
+
+// Constructor: the distance of a separation is that of the shortest periodic image
+PolyakovLoops::PolyakovLoops(std::vector<int> ncells) : fNCells(ncells)
+{
+  if (ncells.size() != 4) throw 1;
+  std::vector<int> distances2;
+  for (int r0 = 0; r0 < ncells[0]; r0++) {
+    for (int r1 = 0; r1 < ncells[1]; r1++) {
+      for (int r2 = 0; r2 < ncells[2]; r2++) {
+        const int d0 = std::min(r0, ncells[0] - r0);
+        const int d1 = std::min(r1, ncells[1] - r1);
+        const int d2 = std::min(r2, ncells[2] - r2);
+        distances2.push_back(d0 * d0 + d1 * d1 + d2 * d2);
+      }
+    }
+  }
+  fDistances2 = distances2;
+  std::sort(fDistances2.begin(), fDistances2.end());
+  fDistances2.erase(std::unique(fDistances2.begin(), fDistances2.end()), fDistances2.end());
+  fMultiplicity.assign(fDistances2.size(), 0);
+  for (int distance2 : distances2) {
+    const int k = std::lower_bound(fDistances2.begin(), fDistances2.end(), distance2) -
+                  fDistances2.begin();
+    fClasses.push_back(k);
+    fMultiplicity[k]++;
+  }
+}
+
+/************************ Public Methods ***************************/
+
+int PolyakovLoops::GetNSites() const
+{
+  return fNCells[0] * fNCells[1] * fNCells[2];
+}
+
+int PolyakovLoops::GetNClasses() const
+{
+  return fDistances2.size();
+}
+
+std::vector<int> PolyakovLoops::GetDistances2() const
+{
+  return fDistances2;
+}
+
+std::vector<int> PolyakovLoops::GetMultiplicity() const
+{
+  return fMultiplicity;
+}
+
+// Multiply the temporal links of each spatial site of the slab
+void PolyakovLoops::Compute(const Path& U,
+                            int i0,
+                            int i1,
+                            std::vector<std::complex<double>>& loops) const
+{
+  if (U.GetNCells() != fNCells) {
+    std::cout << "ERROR: the Polyakov loops and the configuration have different dimensions.\n";
+    throw 1;
+  }
+  for (int i2 = 0; i2 < fNCells[2]; i2++) {
+    my4Vector x({i0, i1, i2, 0}, fNCells);
+    cx_dmat line = U(x, 3);
+    for (int t = 1; t < fNCells[3]; t++) line = line * U(x.Offset(t, 3), 3);
+    loops[(i0 * fNCells[1] + i1) * fNCells[2] + i2] = trace(line) / 3.;
+  }
+}
+
+// With L~(k) = sum_x L(x) exp(-i k x), the inverse transform of |L~(k)|^2, normalized by the
+// number of sites, is sum_x L(x + r) L(x)^*, whose real part is that of sum_x L(x) L(x + r)^*
+void PolyakovLoops::Correlators(const std::vector<std::complex<double>>& loops,
+                                std::vector<double>& sums) const
+{
+  if ((int)loops.size() != GetNSites() || (int)sums.size() != GetNClasses()) throw 1;
+  const std::vector<int> spatial = {fNCells[0], fNCells[1], fNCells[2]};
+  std::vector<std::complex<double>> power = loops;
+  FFT(power, spatial, false);
+  for (std::complex<double>& value : power) value = std::norm(value);
+  FFT(power, spatial, true);
+  for (std::size_t r = 0; r < power.size(); r++) sums[fClasses[r]] += power[r].real();
+}
+
+// Transform along each direction in turn, one line of the array at a time
+void PolyakovLoops::FFT(std::vector<std::complex<double>>& data,
+                        const std::vector<int>& ncells,
+                        bool inverse)
+{
+  if (ncells.size() != 3 || data.size() != (std::size_t)ncells[0] * ncells[1] * ncells[2])
+    throw 1;
+  const int strides[3] = {ncells[1] * ncells[2], ncells[2], 1};
+  for (int d = 0; d < 3; d++) {
+    if (ncells[d] == 1) continue;
+    cx_vec line(ncells[d]);
+    for (std::size_t start = 0; start < data.size(); start++) {
+      // The lines start at the sites with coordinate 0 in the direction d
+      if ((start / strides[d]) % ncells[d] != 0) continue;
+      for (int k = 0; k < ncells[d]; k++) line(k) = data[start + (std::size_t)k * strides[d]];
+      cx_vec transform = inverse ? cx_vec(ifft(line)) : cx_vec(fft(line));
+      for (int k = 0; k < ncells[d]; k++) data[start + (std::size_t)k * strides[d]] = transform(k);
+    }
+  }
+}
@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////
+/// \file PolyakovLoops.h
+/// \brief Header file for the definition of the class PolyakovLoops
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class PolyakovLoops. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef POLYAKOVLOOPS_H
+#define POLYAKOVLOOPS_H
+
+#include <complex>
+#include <vector>
+#include "Path.h"
+
+/// PolyakovLoops class
+///
+/// Temporal Polyakov loops L(x) = tr [U(x, 3) U(x + 3, 3) .. U(x + (N_3 - 1) 3, 3)] / 3 at every
+/// spatial site x, and their two-point correlators C(r) = < L(x) L(x + r)^* >.
+/// The correlators of all the spatial separations r are computed at once with fast Fourier
+/// transforms over the spatial volume V: C(r) is the inverse transform of |L~(k)|^2 / V, where
+/// L~ is the transform of L, so that the cost is O(V log V) instead of O(V^2) for the explicit
+/// pairs of sites. The separations are then grouped in classes of equal distance |r|, measured
+/// with the shortest periodic image of each component: the on-axis distances and the off-axis
+/// ones (sqrt(2), sqrt(3), ..) are all obtained from the same transforms.
+class PolyakovLoops
+{
+ private:
+  std::vector<int> fNCells;        ///< Vector containing the lattice dimensions in 4 dimensions
+  std::vector<int> fClasses;       ///< Class of each spatial separation, in lexicographic order
+  std::vector<int> fDistances2;    ///< Squared distance |r|^2 of each class, in increasing order
+  std::vector<int> fMultiplicity;  ///< Number of separations in each class
+
+ public:
+  PolyakovLoops() = delete;
+
+  /// Constructor
+  ///
+  /// Group the spatial separations of a lattice in classes of equal distance.
+  /// \param ncells vector containing the lattice dimensions in the 4 dimensions
+  PolyakovLoops(std::vector<int> ncells);
+
+  /// \return number of spatial sites, i.e. of Polyakov loops per configuration
+  int GetNSites() const;
+
+  /// \return number of classes of separations
+  int GetNClasses() const;
+
+  /// \return fDistances2
+  std::vector<int> GetDistances2() const;
+
+  /// \return fMultiplicity
+  std::vector<int> GetMultiplicity() const;
+
+  /// Compute on a slab
+  ///
+  /// Compute the Polyakov loops of the spatial sites with given x_0 and x_1, so that different
+  /// slabs may be computed concurrently. \see Metropolis::ForEachSlab
+  /// \param U path configuration, with the lattice dimensions of the instance
+  /// \param i0 coordinate x_0 of the slab
+  /// \param i1 coordinate x_1 of the slab
+  /// \param loops Polyakov loops of the spatial sites, in lexicographic order
+  void Compute(const Path& U, int i0, int i1, std::vector<std::complex<double>>& loops) const;
+
+  /// Correlators
+  ///
+  /// Add to sums the sum over the sites x and over the separations r of each class of
+  /// Re L(x) L(x + r)^*, computed with fast Fourier transforms.
+  /// \param loops Polyakov loops of the spatial sites, in lexicographic order
+  /// \param sums sums of the correlators of each class
+  void Correlators(const std::vector<std::complex<double>>& loops, std::vector<double>& sums) const;
+
+  /// Fast Fourier transform in 3 dimensions
+  ///
+  /// Transform an array in place, one direction at a time.
+  /// \param data values on the sites of a 3-dimensional lattice, in lexicographic order
+  /// \param ncells dimensions of the lattice
+  /// \param inverse true for the inverse transform, normalized by the number of sites
+  static void FFT(std::vector<std::complex<double>>& data,
+                  const std::vector<int>& ncells,
+                  bool inverse);
+};
+
+#endif
@@ -5,19 +5,27 @@
 ///  In the main function, the physical parameters are set and the
 ///  path integration is performed using the Metropolis algorithm,
 ///  as implemented in the Metropolis class.
-///  Then, the ensemble of configurations is printed on file.
+///  The configurations are written on file as soon as they are sampled,
+///  by a background thread.
 ///  Follow the comments in the source code of the Metropolis class for
 ///  a more detailed description.
 ///
 ////////////////////////////////////////////////////////////////////
 #include <armadillo>
 #include <chrono>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
+#include "BackgroundWriter.h"
+#include "EnsembleFile.h"
+#include "EnsembleStore.h"
+#include "LatticeMemory.h"
 #include "my4Vector.h"
 #include "Path.h"
 #include "Metropolis.h"
+#include "ParallelTempering.h"
 #include "../SETTINGS_EXP.h"
 using namespace arma;
 
@@ -29,16 +37,70 @@ int main()
   try {
     auto start = std::chrono::steady_clock::now();
 
+    // Set the memory policy before any lattice is allocated
+    LatticeMemory::SetHugePages(huge_pages);
+    LatticeMemory::SetThreadPinning(pin_threads);
+    LatticeMemory::PinCurrentThread(0);
+
     // Define the parameter container for the Metropolis constructor
     std::vector<int> int_params = {NofSU3, Ncorr, inner, Ncf};
     std::vector<double> double_params = {a, beta, beta_tilde, u0, epsilon};
+    if ((resume || use_store) && output_mode != 'B' && output_mode != 'C') {
+      std::cout << "ERROR: only the 'B' and 'C' output formats can be resumed or stored.\n";
+      throw 1;
+    }
+    // Continue the chain of an existing output file, if required and if the file exists
+    std::string output_filename = filename;
+    bool append = resume && std::ifstream(filename).good();
+    // With the ensemble store, the output file is the one of these settings in the store: the
+    // generation is skipped if it holds Ncf configurations already, otherwise it is continued
+    // up to Ncf configurations
+    if (use_store) {
+      EnsembleStore store(store_directory);
+      const EnsembleSettings settings = {NCells, int_params, double_params, improved};
+      output_filename = store.GetFilename(settings);
+      const int stored = store.GetNConfigs(settings);
+      if (stored >= Ncf) {
+        std::cout << "The ensemble store holds " << stored
+                  << " configurations with these settings already: " << output_filename << "\n";
+        return 0;
+      }
+      int_params[3] = Ncf - stored;
+      append = stored > 0;
+      if (!append) store.Add(settings);
+      std::cout << "Output file in the ensemble store: " << output_filename << "\n";
+    }
 
     // Initialize the Metropolis instance
     Metropolis latticeQCD(NCells, int_params, double_params, improved);
-    // Run the Metropolis algorithm to generate physical configurations
-    latticeQCD.RunMetropolis();
-    // Print the settings and the path configurations on file
-    latticeQCD.PrintAllOnFile(filename);
+    latticeQCD.SetSweepTiles(tiles);
+    latticeQCD.SetStoppingRule(target_error, target_loops, min_Ncf, time_budget);
+    if (append) latticeQCD.Resume(output_filename);
+    // Stream the sampled configurations to the output file from a background thread, so that the
+    // ensemble is never held in memory (the verbose format is printed at the end instead)
+    std::unique_ptr<BackgroundWriter> output;
+    if (output_mode != 'V') {
+      output = std::make_unique<BackgroundWriter>(output_filename, output_mode,
+                                                  latticeQCD.GetSettings(), output_layout, append);
+      latticeQCD.SetOutput(output.get());
+    }
+    // Run the Metropolis algorithm to generate physical configurations, either as a single chain
+    // or with replica exchange among Nreplicas chains at different beta values
+    if (Nreplicas > 1) {
+      ParallelTempering tempering(latticeQCD, Nreplicas, beta_step);
+      tempering.Run();
+      if (memory_report) tempering.PrintMemoryReport();
+    } else {
+      latticeQCD.RunMetropolis();
+      if (memory_report) latticeQCD.PrintMemoryReport("Metropolis");
+    }
+    // Complete the output file, or print the settings and the path configurations on file
+    if (output) {
+      std::cout << "Completing the output file..\n" << std::flush;
+      output->Close();
+    } else {
+      latticeQCD.PrintAllOnFile(filename, output_mode);
+    }
 
     // Print the execution time
     auto end = std::chrono::steady_clock::now();
@@ -88,11 +150,105 @@ int main()
 /// adopted for its performances, in particular for its optimisation of the matrix operations and
 /// the reduction of temporaries.
 ///
+/// At finer lattice spacing, the experiment may be run with the class ParallelTempering, which
+/// evolves Nreplicas copies of the system at different beta values, one thread each, and
+/// periodically exchanges their configurations (see Nreplicas and beta_step in SETTINGS_EXP.h).
+/// Instead of sampling a fixed number of configurations, the generation may also stop as soon as
+/// the Wilson loops measured inline reach a target relative error, including their
+/// autocorrelation (see target_error and time_budget in SETTINGS_EXP.h).
+///
+/// The ensemble is saved by default in a binary format (class EnsembleWriter), with the raw
+/// doubles of the link variables and an index of the configurations: QCD_POST maps the file in
+/// memory instead of parsing it. Each configuration is handed to a background thread
+/// (class BackgroundWriter) as soon as it is sampled, so that writing overlaps with the generation
+/// and the ensemble is never held in memory. Likewise, QCD_POST may read the configurations one
+/// at a time (class EnsembleStream), loading the next one in the background while the current one
+/// is smeared and analysed (set streaming = true in SETTINGS_POST.h). The text format remains
+/// available as an export option, and QCD_POST recognizes the format of its input file
+/// automatically.
+/// Text files are formatted and parsed in parallel, one configuration line per thread, with
+/// the same characters and values as the stream formatting (classes TextEnsembleWriter and
+/// TextEnsembleReader).
+/// The binary format has a compressed variant (output_mode 'C'): the bytes of the doubles are
+/// regrouped by significance and compressed with zlib, in parallel, one block per configuration
+/// with its own checksum.
+/// With resume = true in SETTINGS_EXP.h, QCD_EXP continues the Markov chain of an existing binary
+/// output file, from the checkpoint stored at the end of the previous run (or from its last
+/// configuration), and appends the new configurations to it: QCD_POST then sees a single, growing
+/// ensemble. The header of the file is replaced only once the new data are on disk; the space
+/// left by the replaced indices and checkpoints is reclaimed by compacting the file, once it
+/// exceeds an eighth of it.
+/// The binary formats may also store each direction, or each direction and time slice, as a separate
+/// block (see output_layout in SETTINGS_EXP.h and the enum class EnsembleLayout), so that an
+/// analysis restricted to some link directions reads only the bytes it needs.
+/// With measurement_cache = true in SETTINGS_POST.h, the results of QCD_POST on each
+/// configuration are kept in a side-car of the ensemble file (class MeasurementCache), keyed by
+/// the content of the configuration, by the observable and by the smearings: a later analysis of
+/// the same configurations reads them back instead of computing the loops again, and only the
+/// configurations appended since then are measured. The custom function of CUSTOM_POST.h is
+/// never cached, since its name does not follow the changes of its code.
+/// Instead of naming the output file, the ensembles may be kept in a store addressed by their
+/// settings (class EnsembleStore, see use_store in SETTINGS_EXP.h): QCD_EXP skips the
+/// generation when the store already holds the requested ensemble, or continues it up to Ncf
+/// configurations, and QCD_POST may ask for an ensemble by its settings (see from_store in
+/// SETTINGS_POST.h).
+/// From Python, the module lattice_qcd.py opens the ensembles through the shared library
+/// libqcd.so (source/QCD_PY.cpp, built with BUILD_PY.sh): the configurations are NumPy arrays
+/// on the mapped file, without copies, the Wilson loops and the smearing of the C++ code run on
+/// them, and the measurement cache is read as NumPy arrays as well.
+/// The RxT Wilson loops of the quark-quark potential are assembled from straight Wilson lines
+/// (class WilsonLines), built once per configuration for every site and length, each one from
+/// the previous length with a single product: every loop then costs two products, instead of
+/// a walk along its four sides.
+/// The smearings and the analyses of QCD_POST run on a pool of threads (class ThreadPool, see
+/// Nthreads in SETTINGS_POST.h): each thread takes whole configurations, or, when there are
+/// fewer configurations than threads, slabs of one configuration. The sums over the lattice are
+/// accumulated slab by slab and combined in a fixed order, so that the results do not depend on
+/// the number of threads.
+/// Several analyses may be requested together (see my_types in SETTINGS_POST.h): they are
+/// evaluated in a single pass over the configurations, which are read and smeared once, and the
+/// Wilson lines of each configuration are built once for all of them (Metropolis::MeasureAll).
+/// Loops of any shape (chairs, parallelograms, non-planar loops) are given as direction strings,
+/// e.g. "+0+0+1-0-0-1" for the 2x1 rectangle (see loop_shapes in SETTINGS_POST.h and
+/// Type::LoopShapes): the class LoopShapes compiles them once into a tree of links, where the
+/// shapes starting with the same steps share the products of those steps.
+/// Functions of the links may also be written as field expressions (LatticeField.h), e.g.
+/// real(trace(U[mu] * shift(U[nu], mu) * adj(shift(U[mu], nu)) * adj(U[nu]))): the expression is
+/// evaluated in a single parallel loop over the sites by Metropolis::SumField or
+/// Metropolis::AssignField, without storing any intermediate field (see CUSTOM_POST.h).
+/// The plaquettes of the 6 planes at every site are computed once per configuration, after the
+/// smearing, into a PlaquetteField shared by all the analyses that use them (the plaquette of
+/// Type::PlaquetteRectangle, and the custom function if it asks for it).
+/// Type::PolyakovLoops computes the temporal Polyakov loops of every spatial site and their
+/// correlators at all the spatial separations, on- and off-axis, with fast Fourier transforms
+/// over the spatial volume (class PolyakovLoops); the correlators and the potential
+/// aV(r) = -ln C(r) / N_t are printed on file POLYAKOV_correlator_file.dat.
+/// Type::OffAxisWilsonLoops measures the RxT Wilson loops with spatial sides along off-axis
+/// vectors (see off_axis_vectors in SETTINGS_POST.h), e.g. the planar and space diagonals for
+/// r = sqrt(2), sqrt(3), 2 sqrt(2), ..: the spatial paths are averaged over the orderings of
+/// their steps and over the equivalent vectors (class OffAxisLines), and the potential
+/// estimates are printed, sorted by r, on file OFFAXIS_potential_plot_file.dat.
+/// With symmetrization (SETTINGS_POST.h), every observable is averaged on each configuration
+/// over its equivalent frames under the hypercubic group (class AxisTransformation): with
+/// Symmetrization::TimeAxes each direction with the extent of direction 3 is the time
+/// direction in turn (4 frames on a N^4 lattice, 1 on a N^3 x M one), with
+/// Symmetrization::Hypercubic the permutations of the spatial axes and the reflections are
+/// added (up to 384 frames). The smearings are applied to each choice of the time direction.
+/// With resampling = Resampling::Jackknife or Resampling::Bootstrap in SETTINGS_POST.h (the
+/// default Resampling::None keeps the usual errors), the errors of all the results, and of the
+/// ratios W(r,t)/W(r,t+a) and of the potentials derived from them, are computed by the jackknife or
+/// by the bootstrap on bins of bin_size consecutive configurations (Statistics::Jackknife,
+/// Statistics::Bootstrap), instead of being propagated as uncorrelated: the resamples are
+/// shared among the threads and the bootstrap depends only on resampling_seed. The values of
+/// the configurations come from the measurement cache, so the errors can be recomputed
+/// with other bins without measuring the configurations again.
+///
 /// The plot routines are given in two versions: plot_macro.cpp and plot_macro.py.
 ///
 /// \section reqs Requirements
-/// - To compute the results: g++ compiler and a working installation of the Armadillo library
-/// (download at https://arma.sourceforge.net/download.html)
+/// - To compute the results: Linux system, g++ compiler (C++17) and a working installation of the Armadillo library
+/// (download at https://arma.sourceforge.net/download.html) and of zlib
+/// - To use the ensembles from Python: a Python installation with NumPy
 /// - To plot the results: either ROOT (download at https://root.cern/install/) or a working Python
 /// installation.
 ///
@@ -115,6 +271,11 @@ int main()
 ///    $ ./executable_POST
 ///  - Check the output files
 ///
+///  Python access (optional):
+///  - Execute the script BUILD_PY.sh \n
+///    $ ./BUILD_PY.sh
+///  - Import the module lattice_qcd.py (see its documentation) from this directory
+///
 /// \section plot How to plot
 ///  - Using ROOT \n
 ///    $ root 'plot_macro.cpp(time, r_max)' \n
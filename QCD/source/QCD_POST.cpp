@@ -14,6 +14,9 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include "EnsembleFile.h"
+#include "EnsembleStore.h"
+#include "LatticeMemory.h"
 #include "my4Vector.h"
 #include "Path.h"
 #include "Metropolis.h"
@@ -28,13 +31,29 @@ int main()
 {
   try {
     auto start = std::chrono::steady_clock::now();
+    LatticeMemory::SetHugePages(huge_pages);
 
-    // Initialize the Metropolis instance by reading from file
-    Metropolis latticeQCD(filename);
+    // Find the input file, given either by name or by the settings of the stored ensemble
+    const std::string input =
+        from_store ? EnsembleStore(store_directory).Find(store_settings) : filename;
+    // Initialize the Metropolis instance by reading from file (only the settings, when streaming)
+    Metropolis latticeQCD(input, streaming);
+    // Share the smearings and the analysis among Nthreads threads
+    latticeQCD.SetThreads(Nthreads);
+    // Compile the loop shapes of Type::LoopShapes
+    latticeQCD.SetLoopShapes(loop_shapes);
+    // Set the base vectors of the spatial sides of Type::OffAxisWilsonLoops
+    latticeQCD.SetOffAxisVectors(off_axis_vectors);
+    // If required, reuse the results of previous analyses on the same configurations
+    if (measurement_cache) latticeQCD.UseMeasurementCache();
+    // If required, average the observables over the equivalent frames of each configuration
+    latticeQCD.SetSymmetrization(symmetrization);
+    // Compute the errors by resampling the bins of the configurations, if required
+    latticeQCD.SetResampling(resampling, bin_size, Nresamples, resampling_seed);
     // If required, apply the smearing operation
     if (smeared) latticeQCD.SpatialSmearing(Nsmearings, smear_par);
-    // Compute the statistics of the required type
-    latticeQCD.ComputeStatistics(my_type);
+    // Compute the statistics of the required types, in a single pass over the configurations
+    latticeQCD.ComputeStatistics(my_types);
 
     // Print the execution time
     auto end = std::chrono::steady_clock::now();
@@ -0,0 +1,218 @@
+////////////////////////////////////////////////////////////////////
+///  \file QCD_PY.cpp
+///  \brief Library to reach the ensembles and the analysis kernels from Python
+///
+///  The functions below, with C linkage, are built into the shared library libqcd.so and called
+///  from Python by the module lattice_qcd.py through ctypes. An ensemble file is opened as in
+///  QCD_POST: a raw binary file is mapped in memory, the other formats are read in memory, and
+///  Python receives the address of each configuration, which it wraps in a NumPy array without
+///  copying it. The kernels (Wilson loops and smearing) run on any configuration in the memory
+///  order of Path, including the NumPy arrays created in Python.
+///  No exception crosses the library boundary: the functions report errors through their return
+///  value, after the usual message on the standard output.
+///
+////////////////////////////////////////////////////////////////////
+#include <armadillo>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Ensemble.h"
+#include "EnsembleFile.h"
+#include "my4Vector.h"
+#include "Path.h"
+#include "Metropolis.h"
+
+using namespace arma;
+
+namespace
+{
+// Open ensemble: the Metropolis instance holds the settings used by the kernels
+struct OpenEnsemble {
+  Metropolis analysis;                 // instance built from the file, without the configurations
+  EnsembleSettings settings;           // settings of the file
+  Ensemble ensemble;                   // configurations, mapped or read in memory
+  std::vector<std::uint64_t> digests;  // digests of the configurations, computed on request
+
+  OpenEnsemble(const std::string& filename) : analysis(filename, true) {}
+};
+
+// Check the lengths and the directions of a Wilson loop, which Metropolis::WilsonLoop assumes
+bool ValidLoop(int N_mu, int N_nu, int mu, int nu)
+{
+  if (N_mu < 0 || N_nu < 0 || mu < 0 || mu > 3 || nu < 0 || nu > 3 || mu == nu) {
+    std::cout << "ERROR: invalid lengths or directions of the Wilson loop.\n";
+    return false;
+  }
+  return true;
+}
+}  // namespace
+
+extern "C" {
+
+/// Open an ensemble file
+/// \param filename name of the file, in the binary or in the text format
+/// \return handle of the ensemble, or nullptr in case of error
+void* qcd_open(const char* filename)
+{
+  try {
+    std::unique_ptr<OpenEnsemble> open = std::make_unique<OpenEnsemble>(filename);
+    if (EnsembleReader::IsEnsembleFile(filename)) {
+      EnsembleReader reader(filename);
+      open->settings = reader.GetSettings();
+      open->ensemble = reader.MapEnsemble();
+    } else {
+      TextEnsembleReader reader(filename);
+      open->settings = reader.GetSettings();
+      open->ensemble = Ensemble(open->settings.ncells, reader.GetNConfigs());
+      reader.ReadAll(open->ensemble);
+    }
+    return open.release();
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+/// Close an ensemble: the arrays on its configurations must not be used any more
+/// \param handle handle returned by qcd_open
+void qcd_close(void* handle)
+{
+  delete (OpenEnsemble*)handle;
+}
+
+/// Settings of an ensemble
+/// \param handle handle returned by qcd_open
+/// \param ncells destination of the 4 lattice dimensions
+/// \param integer_params destination of {NofSU3, Ncorr, inner, Ncf}
+/// \param floating_params destination of {a, beta, beta_tilde, u0, epsilon}
+/// \return 1 for the improved action, 0 for the standard one
+int qcd_settings(void* handle, int* ncells, int* integer_params, double* floating_params)
+{
+  const EnsembleSettings& settings = ((OpenEnsemble*)handle)->settings;
+  for (int k = 0; k < 4; k++) ncells[k] = settings.ncells[k];
+  for (int k = 0; k < 4; k++) integer_params[k] = settings.integer_params[k];
+  for (int k = 0; k < 5; k++) floating_params[k] = settings.floating_params[k];
+  return settings.improved;
+}
+
+/// Configuration of an ensemble
+/// \param handle handle returned by qcd_open
+/// \param i index of the configuration
+/// \return address of the links of the i-th configuration, in the memory order of Path: valid
+/// until qcd_close. The memory of a mapped file is private: modifications are not written back
+std::complex<double>* qcd_configuration(void* handle, int i)
+{
+  Ensemble& ensemble = ((OpenEnsemble*)handle)->ensemble;
+  if (i < 0 || i >= ensemble.GetNSlots()) return nullptr;
+  return ensemble[i].GetData();
+}
+
+/// Digests of the configurations, as used by the measurement cache \see MeasurementCache
+/// \param handle handle returned by qcd_open
+/// \param filename name of the ensemble file
+/// \return address of one digest per configuration, valid until qcd_close, or nullptr in case of
+/// error
+const std::uint64_t* qcd_digests(void* handle, const char* filename)
+{
+  OpenEnsemble* open = (OpenEnsemble*)handle;
+  try {
+    if (open->digests.empty()) {
+      if (EnsembleReader::IsEnsembleFile(filename))
+        open->digests = EnsembleReader(filename).Digests();
+      else
+        open->digests = TextEnsembleReader(filename).Digests();
+    }
+    return open->digests.data();
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+/// Wilson loop on a configuration
+/// \param handle handle returned by qcd_open: it provides the lattice dimensions
+/// \param links links of the configuration, in the memory order of Path
+/// \param N_mu length of the loop in the mu direction
+/// \param N_nu length of the loop in the nu direction
+/// \param mu direction of one of the sides of the loop
+/// \param nu direction of the other side of the loop
+/// \param x position {x_0, x_1, x_2, x_3} of one of the corners of the loop
+/// \return value of the loop, or NaN in case of error \see Metropolis::WilsonLoop
+double qcd_wilson_loop(void* handle,
+                       const std::complex<double>* links,
+                       int N_mu,
+                       int N_nu,
+                       int mu,
+                       int nu,
+                       const int* x)
+{
+  const OpenEnsemble* open = (const OpenEnsemble*)handle;
+  try {
+    if (!ValidLoop(N_mu, N_nu, mu, nu)) return std::nan("");
+    const std::vector<int>& n = open->settings.ncells;
+    const Path U(n, const_cast<std::complex<double>*>(links));
+    return open->analysis.WilsonLoop(N_mu, N_nu, mu, nu, my4Vector({x[0], x[1], x[2], x[3]}, n),
+                                     U);
+  } catch (...) {
+    return std::nan("");
+  }
+}
+
+/// Sum of the Wilson loops of a configuration over all the lattice sites
+/// \param handle handle returned by qcd_open: it provides the lattice dimensions
+/// \param links links of the configuration, in the memory order of Path
+/// \param N_mu length of the loops in the mu direction
+/// \param N_nu length of the loops in the nu direction
+/// \param mu direction of one of the sides of the loops
+/// \param nu direction of the other side of the loops
+/// \return sum of the loops, or NaN in case of error
+double qcd_loop_sum(void* handle,
+                    const std::complex<double>* links,
+                    int N_mu,
+                    int N_nu,
+                    int mu,
+                    int nu)
+{
+  const OpenEnsemble* open = (const OpenEnsemble*)handle;
+  try {
+    if (!ValidLoop(N_mu, N_nu, mu, nu)) return std::nan("");
+    const std::vector<int>& n = open->settings.ncells;
+    const Path U(n, const_cast<std::complex<double>*>(links));
+    double sum = 0.;
+    for (int i0 = 0; i0 < n[0]; i0++) {
+      for (int i1 = 0; i1 < n[1]; i1++) {
+        for (int i2 = 0; i2 < n[2]; i2++) {
+          for (int i3 = 0; i3 < n[3]; i3++) {
+            my4Vector x({i0, i1, i2, i3}, n);
+            sum += open->analysis.WilsonLoop(N_mu, N_nu, mu, nu, x, U);
+          }
+        }
+      }
+    }
+    return sum;
+  } catch (...) {
+    return std::nan("");
+  }
+}
+
+/// Spatial smearing of a configuration, in place
+/// \param handle handle returned by qcd_open: it provides the settings a and u0
+/// \param links links of the configuration, in the memory order of Path
+/// \param Ntimes number of consecutive smearings
+/// \param smearing_par value of the smearing parameter
+/// \return 0, or -1 in case of error \see Metropolis::SmearConfiguration
+int qcd_smear(void* handle, std::complex<double>* links, int Ntimes, double smearing_par)
+{
+  const OpenEnsemble* open = (const OpenEnsemble*)handle;
+  try {
+    Path U(open->settings.ncells, links);
+    open->analysis.SmearConfiguration(U, Ntimes, smearing_par);
+    return 0;
+  } catch (...) {
+    return -1;
+  }
+}
+
+}  // extern "C"
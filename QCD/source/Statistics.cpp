@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
+#include "Statistics.h"
+#include "ThreadPool.h"
+
+namespace
+{
+// Mean values of the observables over the samples
+std::vector<double> Means(const std::vector<std::vector<double>>& samples)
+{
+  std::vector<double> means(samples.empty() ? 0 : samples[0].size(), 0.);
+  for (const std::vector<double>& sample : samples) {
+    for (std::size_t k = 0; k < means.size(); k++) means[k] += sample[k];
+  }
+  for (double& mean : means) mean /= samples.size();
+  return means;
+}
+
+// Run the tasks on the pool, or serially without a pool
+void ForEach(ThreadPool* pool, int count, const std::function<void(int)>& task)
+{
+  if (pool) {
+    pool->Run(count, task);
+  } else {
+    for (int k = 0; k < count; k++) task(k);
+  }
+}
+
+// Index in [0, n) from a 64-bit random number r, as the high word of the 96-bit product r * n
+// (Lemire's method without the rejection, whose bias is below n / 2^64): the product is split at
+// bit 32 of r, so that no partial product overflows 64 bits
+std::size_t RandomIndex(std::uint64_t r, std::uint32_t n)
+{
+  const std::uint64_t high = (r >> 32) * n + (((r & 0xffffffffu) * n) >> 32);
+  return high >> 32;
+}
+
+// Value of the derived quantities on all the samples, and their spread over the values on the
+// resamples: the squared deviations are summed with weight
+std::vector<Estimate> Spread(const std::vector<std::vector<double>>& samples,
+                             const Statistics::Derived& f,
+                             const std::vector<std::vector<double>>& resampled,
+                             double weight)
+{
+  const std::vector<double> values = f(Means(samples));
+  std::vector<Estimate> estimates(values.size());
+  for (std::size_t k = 0; k < values.size(); k++) {
+    estimates[k].mean = values[k];
+    if (resampled.size() < 2) continue;
+    double mean = 0., square = 0.;
+    for (const std::vector<double>& value : resampled) mean += value[k];
+    mean /= resampled.size();
+    for (const std::vector<double>& value : resampled) square += std::pow(value[k] - mean, 2.0);
+    estimates[k].error = std::sqrt(weight * square);
+  }
+  return estimates;
+}
+}  // namespace
+
+// Mean value of the series
+double Statistics::Mean(const std::vector<double>& series)
+{
+  if (series.empty()) return 0.;
+  double sum = 0.;
+  for (double value : series) sum += value;
+  return sum / series.size();
+}
+
+// Error on the mean of a correlated series with automatic windowing of the autocorrelation sum
+Estimate Statistics::AutocorrelatedError(const std::vector<double>& series, double c)
+{
+  Estimate result;
+  const int N = series.size();
+  result.mean = Mean(series);
+  if (N < 2) return result;
+
+  // Autocovariance at lag t
+  auto gamma = [&](int t) {
+    double sum = 0.;
+    for (int i = 0; i + t < N; i++) sum += (series[i] - result.mean) * (series[i + t] - result.mean);
+    return sum / (N - t);
+  };
+  const double gamma0 = gamma(0);
+  if (gamma0 <= 0.) return result;  // constant series: no fluctuations, no error
+
+  double tau = 0.5;
+  int window = 0;
+  for (int t = 1; t < N / 2; t++) {
+    tau += gamma(t) / gamma0;
+    window = t;
+    if (t >= c * tau) break;
+  }
+  result.tau_int = std::max(tau, 0.5);
+  result.window = window;
+  result.error = std::sqrt(2. * result.tau_int * gamma0 / N);
+  return result;
+}
+
+// Average the samples in blocks of bin_size
+std::vector<std::vector<double>> Statistics::Bin(const std::vector<std::vector<double>>& samples,
+                                                 int bin_size)
+{
+  if (bin_size < 1) throw 1;
+  std::vector<std::vector<double>> bins;
+  for (std::size_t first = 0; first + bin_size <= samples.size(); first += bin_size) {
+    bins.push_back(Means(std::vector<std::vector<double>>(samples.begin() + first,
+                                                          samples.begin() + first + bin_size)));
+  }
+  return bins;
+}
+
+// The means without a bin are obtained from the sum of all the bins, by subtracting that bin
+std::vector<Estimate> Statistics::Jackknife(const std::vector<std::vector<double>>& samples,
+                                            const Derived& f,
+                                            int bin_size,
+                                            ThreadPool* pool)
+{
+  const std::vector<std::vector<double>> bins = Bin(samples, bin_size);
+  const int nbins = bins.size();
+  if (nbins < 2) return Spread(samples, f, {}, 0.);
+  std::vector<double> total = Means(bins);
+  for (double& value : total) value *= nbins;
+  std::vector<std::vector<double>> resampled(nbins);
+  ForEach(pool, nbins, [&](int j) {
+    std::vector<double> means = total;
+    for (std::size_t k = 0; k < means.size(); k++) means[k] = (means[k] - bins[j][k]) / (nbins - 1);
+    resampled[j] = f(means);
+  });
+  return Spread(samples, f, resampled, (nbins - 1.) / nbins);
+}
+
+// Draw the bins of each resample with a generator of its own. The output of std::mt19937_64 and
+// std::seed_seq is fixed by the standard, while the algorithm of std::uniform_int_distribution is
+// not: the index of a bin is the high word of the product of a 64-bit output by the number of
+// bins, so that the resamples are the same with any standard library
+std::vector<Estimate> Statistics::Bootstrap(const std::vector<std::vector<double>>& samples,
+                                            const Derived& f,
+                                            int nresamples,
+                                            std::uint64_t seed,
+                                            int bin_size,
+                                            ThreadPool* pool)
+{
+  const std::vector<std::vector<double>> bins = Bin(samples, bin_size);
+  const int nbins = bins.size();
+  if (nbins < 2 || nresamples < 2) return Spread(samples, f, {}, 0.);
+  std::vector<std::vector<double>> resampled(nresamples);
+  ForEach(pool, nresamples, [&](int b) {
+    std::seed_seq sequence = {(std::uint32_t)seed, (std::uint32_t)(seed >> 32), (std::uint32_t)b};
+    std::mt19937_64 generator(sequence);
+    std::vector<double> means(bins[0].size(), 0.);
+    for (int j = 0; j < nbins; j++) {
+      const std::vector<double>& bin = bins[RandomIndex(generator(), nbins)];
+      for (std::size_t k = 0; k < means.size(); k++) means[k] += bin[k];
+    }
+    for (double& mean : means) mean /= nbins;
+    resampled[b] = f(means);
+  });
+  return Spread(samples, f, resampled, 1. / (nresamples - 1.));
+}
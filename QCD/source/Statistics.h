@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////
+/// \file Statistics.h
+/// \brief Header file for the statistical analysis of Montecarlo time series
+///
+/// Header file containing the definition of the structure Estimate and of
+/// the functions which compute error estimates on a series of measurements
+/// taken along a Markov chain, directly or by resampling. Further comments
+/// may be found in the implementation file.
+////////////////////////////////////////////////////////////////////////
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class ThreadPool;
+
+/// Estimate structure
+///
+/// Result of the analysis of a Montecarlo time series: mean value, statistical error and the
+/// integrated autocorrelation time used to inflate the naive error.
+struct Estimate {
+  double mean = 0.;      ///< Mean value of the series
+  double error = 0.;     ///< Statistical error on the mean value
+  double tau_int = 0.5;  ///< Integrated autocorrelation time, in units of the measurement spacing
+                         ///< (0.5 for uncorrelated measurements)
+  int window = 0;        ///< Summation window selected for tau_int
+};
+
+/// Resampling enum class
+///
+/// Enum class which collects the methods for the errors of the quantities derived from the mean
+/// values of the measurements, such as the ratios of Wilson loops, the potentials or the
+/// parameters of a fit. \see Statistics::Jackknife, Statistics::Bootstrap
+enum class Resampling {
+  None,       ///< Errors of the mean values only, propagated as if they were uncorrelated
+  Jackknife,  ///< Jackknife on the bins of the measurements
+  Bootstrap   ///< Bootstrap on the bins of the measurements
+};
+
+/// Statistical analysis of Montecarlo time series
+namespace Statistics
+{
+/// Derived quantities: function of the mean values of the observables
+typedef std::function<std::vector<double>(const std::vector<double>&)> Derived;
+
+/// Mean value of a series
+/// \param series measurements
+/// \return arithmetic mean (0 for an empty series)
+double Mean(const std::vector<double>& series);
+
+/// Autocorrelated error
+///
+/// Estimate the error on the mean value of a series of correlated measurements,
+/// \f$\sigma^2 = 2\tau_{int}\Gamma(0)/N\f$. The integrated autocorrelation time is summed up to
+/// the smallest window W such that \f$W\geq c\,\tau_{int}(W)\f$ (automatic windowing of Madras
+/// and Sokal), which balances the bias of a short window against the noise of a long one.
+/// \param series measurements in Markov chain order
+/// \param c windowing constant (4 to 6 are the usual choices)
+/// \return mean, error, tau_int and window of the series
+Estimate AutocorrelatedError(const std::vector<double>& series, double c = 5.);
+
+/// Bin the samples
+///
+/// Average the samples of consecutive measurements in bins, which are nearly independent when
+/// they are much longer than the autocorrelation time of the observables.
+/// \param samples values of the observables on each measurement, in Markov chain order
+/// \param bin_size number of consecutive measurements in each bin: the last measurements, which
+/// do not fill a bin, are left out
+/// \return mean values of the observables in each bin
+std::vector<std::vector<double>> Bin(const std::vector<std::vector<double>>& samples,
+                                     int bin_size);
+
+/// Jackknife errors
+///
+/// Estimate the quantities derived from the mean values of the observables and their errors with
+/// the jackknife: f is evaluated on the means of the samples without each bin in turn, and the
+/// error is \f$\sigma^2 = \frac{N_b - 1}{N_b}\sum_j (f_j - \bar f)^2\f$ over the N_b bins.
+/// \param samples values of the observables on each measurement, in Markov chain order
+/// \param f function of the mean values of the observables, returning the derived quantities: it
+/// may be called concurrently on the threads of pool
+/// \param bin_size number of consecutive measurements in each bin \see Bin
+/// \param pool threads sharing the evaluations of f (nullptr = serial)
+/// \return for each derived quantity, its value on the means of all the samples and its error
+std::vector<Estimate> Jackknife(const std::vector<std::vector<double>>& samples,
+                                const Derived& f,
+                                int bin_size = 1,
+                                ThreadPool* pool = nullptr);
+
+/// Bootstrap errors
+///
+/// Estimate the quantities derived from the mean values of the observables and their errors with
+/// the bootstrap: f is evaluated on the means of nresamples resamples, each made of N_b bins
+/// drawn with replacement among the N_b bins, and the error is the standard deviation of the
+/// values of f. Each resample has its own random generator, seeded with seed and its index, so
+/// that the errors depend on the seed only, not on the number of threads or on the standard
+/// library.
+/// \param samples values of the observables on each measurement, in Markov chain order
+/// \param f function of the mean values of the observables, returning the derived quantities: it
+/// may be called concurrently on the threads of pool
+/// \param nresamples number of resamples
+/// \param seed seed of the resamples
+/// \param bin_size number of consecutive measurements in each bin \see Bin
+/// \param pool threads sharing the resamples (nullptr = serial)
+/// \return for each derived quantity, its value on the means of all the samples and its error
+std::vector<Estimate> Bootstrap(const std::vector<std::vector<double>>& samples,
+                                const Derived& f,
+                                int nresamples,
+                                std::uint64_t seed,
+                                int bin_size = 1,
+                                ThreadPool* pool = nullptr);
+}  // namespace Statistics
+
+#endif
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ThreadPool.h"
+
+namespace
+{
+thread_local bool tInsideTask = false;  // true while the thread executes a task of a pool
+}  // namespace
+
+/************************ Constructor and destructor ***************************/
+
+// Constructor: start nthreads - 1 workers, the calling thread being the last one
+ThreadPool::ThreadPool(int nthreads)
+    : fTask(nullptr), fCount(0), fNext(0), fRunning(0), fStop(false)
+{
+  if (nthreads <= 0) nthreads = std::max(1, (int)std::thread::hardware_concurrency());
+  for (int t = 1; t < nthreads; t++) fThreads.emplace_back(&ThreadPool::Loop, this);
+}
+
+// Destructor
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStop = true;
+  }
+  fWake.notify_all();
+  for (std::thread& thread : fThreads) thread.join();
+}
+
+/************************ Private Methods ***************************/
+
+// Take the tasks one at a time: the lock is released while a task runs
+void ThreadPool::Work(std::unique_lock<std::mutex>& lock)
+{
+  while (fTask && fNext < fCount) {
+    const std::function<void(int)>& task = *fTask;
+    const int k = fNext++;
+    fRunning++;
+    lock.unlock();
+    tInsideTask = true;
+    std::exception_ptr error;
+    try {
+      task(k);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    tInsideTask = false;
+    lock.lock();
+    if (error && !fError) fError = error;
+    fRunning--;
+  }
+  if (fRunning == 0) fDone.notify_all();
+}
+
+// Wait for a loop, work on it, and wait again until the pool is destroyed
+void ThreadPool::Loop()
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  while (true) {
+    fWake.wait(lock, [this]() { return fStop || (fTask && fNext < fCount); });
+    if (fStop) return;
+    Work(lock);
+  }
+}
+
+/************************ Public Methods ***************************/
+
+int ThreadPool::GetNThreads() const
+{
+  return fThreads.size() + 1;
+}
+
+// Publish the loop to the workers and take part in it
+void ThreadPool::Run(int count, const std::function<void(int)>& task)
+{
+  if (count <= 0) return;
+  if (tInsideTask || fThreads.empty() || count == 1) {
+    for (int k = 0; k < count; k++) task(k);
+    return;
+  }
+  std::lock_guard<std::mutex> run_lock(fRunMutex);
+  std::unique_lock<std::mutex> lock(fMutex);
+  fTask = &task;
+  fCount = count;
+  fNext = 0;
+  fError = nullptr;
+  fWake.notify_all();
+  Work(lock);
+  fDone.wait(lock, [this]() { return fNext >= fCount && fRunning == 0; });
+  fTask = nullptr;
+  std::exception_ptr error = fError;
+  fError = nullptr;
+  lock.unlock();
+  if (error) std::rethrow_exception(error);
+}
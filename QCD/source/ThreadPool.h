@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////
+/// \file ThreadPool.h
+/// \brief Header file for the definition of the class ThreadPool
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class ThreadPool. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// ThreadPool class
+///
+/// Set of worker threads, started once and kept waiting between the parallel loops of the
+/// analyses. ThreadPool::Run executes the tasks 0, .., count - 1 of a loop on the workers and on
+/// the calling thread, each task being taken by the first free thread. The tasks must not depend
+/// on the order in which they run: deterministic results are obtained by giving each task its own
+/// accumulator and by combining the accumulators in task order after the loop.
+/// A loop started from inside a task runs serially on the thread of that task, so that the
+/// parallel loops may be nested without oversubscribing the cores.
+class ThreadPool
+{
+ private:
+  std::vector<std::thread> fThreads;             ///< Worker threads
+  std::mutex fMutex;                             ///< Mutex protecting the fields below
+  std::condition_variable fWake;                 ///< Signals a new loop, or the stop, to the workers
+  std::condition_variable fDone;                 ///< Signals the end of a task to the caller of Run
+  const std::function<void(int)>* fTask;         ///< Task of the current loop (nullptr = idle)
+  int fCount;                                    ///< Number of tasks of the current loop
+  int fNext;                                     ///< Next task to be taken
+  int fRunning;                                  ///< Number of tasks being executed
+  std::exception_ptr fError;                     ///< First exception thrown by a task of the loop
+  bool fStop;                                    ///< True when the workers have to exit
+  std::mutex fRunMutex;                          ///< Serializes the loops started by different threads
+
+  /// Take and execute the tasks of the current loop until none is left
+  /// \param lock lock on fMutex, held on entry and on exit
+  void Work(std::unique_lock<std::mutex>& lock);
+
+  /// Body of the worker threads
+  void Loop();
+
+ public:
+  /// Constructor
+  ///
+  /// \param nthreads total number of threads running the loops, including the calling one
+  /// (0 = the available hardware threads)
+  ThreadPool(int nthreads = 0);
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// Destructor: stop and join the workers
+  ~ThreadPool();
+
+  /// \return total number of threads running the loops, including the calling one
+  int GetNThreads() const;
+
+  /// Run a parallel loop
+  ///
+  /// Execute task(0), .., task(count - 1) and return when all of them are over. If a task throws,
+  /// the remaining tasks still run and the first exception is thrown again by Run.
+  /// \param count number of tasks
+  /// \param task function called with the index of each task
+  void Run(int count, const std::function<void(int)>& task);
+};
+
+#endif
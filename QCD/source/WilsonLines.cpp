@@ -0,0 +1,99 @@
+#include <armadillo>
+#include <complex>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include "LatticeMemory.h"
+#include "my4Vector.h"
+#include "Path.h"
+#include "WilsonLines.h"
+using namespace arma;
+
+/************************ Constructor ***************************/
+
+// Constructor: the lines are computed later, by Compute
+WilsonLines::WilsonLines(std::vector<int> ncells, std::vector<int> max_lengths)
+    : fNCells(ncells), fMaxLengths(max_lengths)
+{
+  if (ncells.size() != 4 || max_lengths.size() != 4) throw 1;
+  const std::size_t volume = (std::size_t)ncells[0] * ncells[1] * ncells[2] * ncells[3];
+  std::size_t size = 0;
+  for (int mu = 0; mu < 4; mu++) {
+    if (max_lengths[mu] < 0) throw 1;
+    fBlocks.push_back(size);
+    size += volume * max_lengths[mu] * 9;
+  }
+  if (size > 0) fLines = LinkBuffer(size);
+}
+
+/************************ Private Methods ***************************/
+
+// Offset of the line of a given direction and length starting at x
+std::size_t WilsonLines::Offset(const my4Vector& position, int mu, int length) const
+{
+  if (position.GetNCells() != fNCells) throw 1;
+  if (mu < 0 || mu >= 4 || length < 1 || length > fMaxLengths[mu]) throw 1;
+  std::size_t site =
+      ((std::size_t)(position[0] * fNCells[1] + position[1]) * fNCells[2] + position[2]) *
+          fNCells[3] +
+      position[3];
+  return fBlocks[mu] + (site * fMaxLengths[mu] + length - 1) * 9;
+}
+
+/************************ Public Methods ***************************/
+
+// Compute the lines slab by slab
+void WilsonLines::Compute(const Path& U)
+{
+  for (int i0 = 0; i0 < fNCells[0]; i0++) {
+    for (int i1 = 0; i1 < fNCells[1]; i1++) Compute(U, i0, i1);
+  }
+}
+
+// Extend the line of each site by one link at a time: L(x, n) = L(x, n - 1) U(x + (n - 1) mu, mu)
+void WilsonLines::Compute(const Path& U, int i0, int i1)
+{
+  if (U.GetNCells() != fNCells) {
+    std::cout << "ERROR: the Wilson lines and the configuration have different dimensions.\n";
+    throw 1;
+  }
+  std::complex<double>* data = fLines.GetData();
+  for (int i2 = 0; i2 < fNCells[2]; i2++) {
+    for (int i3 = 0; i3 < fNCells[3]; i3++) {
+      my4Vector x({i0, i1, i2, i3}, fNCells);
+      for (int mu = 0; mu < 4; mu++) {
+        if (fMaxLengths[mu] == 0) continue;
+        std::complex<double>* line = data + Offset(x, mu, 1);
+        cx_dmat first(line, 3, 3, false, true);
+        first = U(x, mu);
+        for (int length = 2; length <= fMaxLengths[mu]; length++, line += 9) {
+          const cx_dmat previous(line, 3, 3, false, true);
+          cx_dmat next(line + 9, 3, 3, false, true);
+          next = previous * U(x.Offset(length - 1, mu), mu);
+        }
+      }
+    }
+  }
+}
+
+// Access to a line: the matrix aliases the memory of the instance
+const cx_dmat WilsonLines::operator()(const my4Vector& position, int mu, int length) const
+{
+  return cx_dmat(const_cast<std::complex<double>*>(fLines.GetData()) + Offset(position, mu, length),
+                 3, 3, false, true);
+}
+
+std::vector<int> WilsonLines::GetMaxLengths() const
+{
+  return fMaxLengths;
+}
+
+// tr(A B^dagger) = sum_ij A_ij conj(B_ij)
+double WilsonLines::RealTrace(const cx_dmat& A, const cx_dmat& B)
+{
+  const std::complex<double>* a = A.memptr();
+  const std::complex<double>* b = B.memptr();
+  double trace = 0.;
+  for (int k = 0; k < 9; k++) trace += a[k].real() * b[k].real() + a[k].imag() * b[k].imag();
+  return trace;
+}
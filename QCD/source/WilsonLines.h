@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////
+/// \file WilsonLines.h
+/// \brief Header file for the definition of the class WilsonLines
+///
+/// Header file containing the definitions of the attributes and members
+/// of the class WilsonLines. Further comments may be found in the
+/// implementation file of this class.
+////////////////////////////////////////////////////////////////////////
+#ifndef WILSONLINES_H
+#define WILSONLINES_H
+
+#include <armadillo>
+#include <cstddef>
+#include <vector>
+#include "LatticeMemory.h"
+#include "my4Vector.h"
+#include "Path.h"
+using namespace arma;
+
+/// WilsonLines class
+///
+/// This class holds the straight Wilson lines L_mu(x, n) = U(x, mu) U(x + mu, mu) ..
+/// U(x + (n - 1) mu, mu) for every site x, every direction mu and every length n up to a maximum
+/// length, which is set for each direction (0 = no lines in that direction). The lines are built
+/// once per configuration, each one from the previous length with a single matrix product, and
+/// are then combined into Wilson loops of any size without walking their sides again: the same
+/// lines serve all the analyses of a configuration. \see Metropolis::MeasureAll
+/// The lines are stored in a single contiguous LinkBuffer, one block per direction: in each block
+/// the sites follow the lexicographic order of Path, the lengths are contiguous for each site and
+/// each 3x3 matrix is stored in the column-major order of Armadillo.
+class WilsonLines
+{
+ private:
+  LinkBuffer fLines;                  ///< Lines as a contiguous buffer of 3x3 matrices
+  std::vector<int> fNCells;           ///< Vector containing the lattice dimensions in 4 dimensions
+  std::vector<int> fMaxLengths;       ///< Maximum length of the lines in each direction
+  std::vector<std::size_t> fBlocks;   ///< Offset of the block of each direction in fLines
+
+  /// Offset
+  ///
+  /// \param x position 4-vector of the first end of the line
+  /// \param mu direction of the line
+  /// \param length length of the line
+  /// \return offset of the first element of the line in fLines
+  std::size_t Offset(const my4Vector& x, int mu, int length) const;
+
+ public:
+  WilsonLines() = delete;
+
+  /// Constructor
+  ///
+  /// Allocate the lines of a lattice, which are computed by WilsonLines::Compute.
+  /// \param ncells vector containing the lattice dimensions in the 4 dimensions
+  /// \param max_lengths maximum length of the lines in each of the 4 directions
+  WilsonLines(std::vector<int> ncells, std::vector<int> max_lengths);
+
+  /// Compute
+  ///
+  /// Compute the lines of every site, direction and length.
+  /// \param U path configuration, with the lattice dimensions of the instance
+  void Compute(const Path& U);
+
+  /// Compute on a slab
+  ///
+  /// Compute the lines of every direction and length starting at the sites with given x_0 and
+  /// x_1 only, so that different slabs may be computed concurrently. \see Metropolis::ForEachSlab
+  /// \param U path configuration, with the lattice dimensions of the instance
+  /// \param i0 coordinate x_0 of the slab
+  /// \param i1 coordinate x_1 of the slab
+  void Compute(const Path& U, int i0, int i1);
+
+  /// () overloading
+  ///
+  /// \param x position 4-vector of the first end of the line
+  /// \param mu direction of the line
+  /// \param length length of the line, between 1 and the maximum length in the direction mu
+  /// \return 3x3 matrix of the line, which aliases the memory of the instance: it is valid until
+  /// the next WilsonLines::Compute
+  const cx_dmat operator()(const my4Vector& x, int mu, int length) const;
+
+  /// \return fMaxLengths
+  std::vector<int> GetMaxLengths() const;
+
+  /// Real trace of a product
+  ///
+  /// \param A 3x3 matrix
+  /// \param B 3x3 matrix
+  /// \return Re tr(A B^dagger), computed element by element without forming the product
+  static double RealTrace(const cx_dmat& A, const cx_dmat& B);
+};
+
+#endif